@@ -3,18 +3,69 @@ CONFIG += console c++17
 CONFIG -= app_bundle
 CONFIG -= qt
 
+# C++20 coroutine support (task_queue_coroutine.h) is opt-in:
+#   qmake CONFIG+=coroutines
+coroutines {
+    CONFIG -= c++17
+    CONFIG += c++2a
+    *-g++*: QMAKE_CXXFLAGS += -fcoroutines
+}
+
 SOURCES += \
+        block_pool.cpp \
+        delayed_task_queue.cpp \
         event.cpp \
         example.cpp \
+        latency_histogram.cpp \
+        parallel.cpp \
+        rcu.cpp \
+        simulated_clock.cpp \
+        task_graph.cpp \
         task_queue.cpp \
         task_queue_base.cpp \
+        task_queue_core.cpp \
+        task_queue_io.cpp \
         task_queue_manager.cpp \
-        task_queue_std.cpp
+        task_queue_pooled.cpp \
+        task_queue_simulated.cpp \
+        task_queue_std.cpp \
+        thread_placement.cpp \
+        thread_pool.cpp \
+        timing_wheel.cpp \
+        trace_log.cpp
 
 HEADERS += \
+    bit_ops.h \
+    block_pool.h \
+    delayed_task_handle.h \
+    delayed_task_queue.h \
     event.h \
+    fd_watch.h \
+    latency_histogram.h \
+    location.h \
+    mpsc_queue.h \
+    parallel.h \
     queued_task.h \
+    rcu.h \
+    repeating_task.h \
+    ring_buffer.h \
+    simulated_clock.h \
+    task.h \
+    task_graph.h \
+    task_priority.h \
     task_queue.h \
     task_queue_base.h \
+    task_queue_core.h \
+    task_queue_coroutine.h \
+    task_queue_io.h \
     task_queue_manager.h \
-    task_queue_std.h
+    task_queue_options.h \
+    task_queue_pooled.h \
+    task_queue_simulated.h \
+    task_queue_stats.h \
+    task_queue_std.h \
+    thread_placement.h \
+    thread_pool.h \
+    timing_wheel.h \
+    trace_log.h \
+    work_stealing_deque.h
@@ -0,0 +1,96 @@
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+CONFIG -= qt
+
+# C++20 coroutine support (task_queue_coroutine.h) is opt-in:
+#   qmake CONFIG+=coroutines
+coroutines {
+    CONFIG -= c++17
+    CONFIG += c++2a
+    *-g++*: QMAKE_CXXFLAGS += -fcoroutines
+}
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+        benchmarks/batch_post_benchmark.cpp \
+        benchmarks/benchmark_main.cpp \
+        benchmarks/coalesce_benchmark.cpp \
+        benchmarks/coroutine_hop_benchmark.cpp \
+        benchmarks/delayed_cancel_benchmark.cpp \
+        benchmarks/delayed_post_benchmark.cpp \
+        benchmarks/elastic_pool_benchmark.cpp \
+        benchmarks/idle_policy_benchmark.cpp \
+        benchmarks/io_hop_benchmark.cpp \
+        benchmarks/manager_lookup_benchmark.cpp \
+        benchmarks/metrics_overhead_benchmark.cpp \
+        benchmarks/parallel_for_benchmark.cpp \
+        benchmarks/pooled_queue_benchmark.cpp \
+        benchmarks/post_latency_benchmark.cpp \
+        benchmarks/post_throughput_benchmark.cpp \
+        benchmarks/priority_latency_benchmark.cpp \
+        benchmarks/queue_lifecycle_benchmark.cpp \
+        benchmarks/repeating_task_benchmark.cpp \
+        benchmarks/simulated_time_benchmark.cpp \
+        benchmarks/task_allocation_benchmark.cpp \
+        benchmarks/task_graph_benchmark.cpp \
+        benchmarks/timer_accuracy_benchmark.cpp \
+        benchmarks/trace_overhead_benchmark.cpp \
+        block_pool.cpp \
+        delayed_task_queue.cpp \
+        event.cpp \
+        latency_histogram.cpp \
+        parallel.cpp \
+        rcu.cpp \
+        simulated_clock.cpp \
+        task_graph.cpp \
+        task_queue.cpp \
+        task_queue_base.cpp \
+        task_queue_core.cpp \
+        task_queue_io.cpp \
+        task_queue_manager.cpp \
+        task_queue_pooled.cpp \
+        task_queue_simulated.cpp \
+        task_queue_std.cpp \
+        thread_placement.cpp \
+        thread_pool.cpp \
+        timing_wheel.cpp \
+        trace_log.cpp
+
+HEADERS += \
+    benchmarks/benchmark.h \
+    bit_ops.h \
+    block_pool.h \
+    delayed_task_handle.h \
+    delayed_task_queue.h \
+    event.h \
+    fd_watch.h \
+    latency_histogram.h \
+    location.h \
+    mpsc_queue.h \
+    parallel.h \
+    queued_task.h \
+    rcu.h \
+    repeating_task.h \
+    ring_buffer.h \
+    simulated_clock.h \
+    task.h \
+    task_graph.h \
+    task_priority.h \
+    task_queue.h \
+    task_queue_base.h \
+    task_queue_core.h \
+    task_queue_coroutine.h \
+    task_queue_io.h \
+    task_queue_manager.h \
+    task_queue_options.h \
+    task_queue_pooled.h \
+    task_queue_simulated.h \
+    task_queue_stats.h \
+    task_queue_std.h \
+    thread_placement.h \
+    thread_pool.h \
+    timing_wheel.h \
+    trace_log.h \
+    work_stealing_deque.h
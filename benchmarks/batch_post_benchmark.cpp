@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <atomic>
+#include <vector>
+#include "benchmark.h"
+#include "event.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kBatches = 2000;
+
+// Posts |kBatches| batches of |batchSize| empty tasks, either through
+// postTasks() or by looping over postTask(), and returns ns per task.
+double measure(int batchSize, bool batched, bool lockFree) {
+    vi::TaskQueueOptions options;
+    options.lock_free_submission_ = lockFree;
+    auto queue = vi::TaskQueue::create("batch_post", options);
+
+    std::atomic<int> remaining(kBatches * batchSize);
+    vi::Event done;
+    auto closure = [&remaining, &done]{
+        if (remaining.fetch_sub(1, std::memory_order_relaxed) == 1) {
+            done.set();
+        }
+    };
+
+    std::vector<vi::Task> batch;
+    auto start = std::chrono::steady_clock::now();
+    for (int b = 0; b < kBatches; ++b) {
+        if (batched) {
+            batch.reserve(batchSize);
+            for (int i = 0; i < batchSize; ++i) {
+                batch.push_back(queue->makeTask(closure));
+            }
+            queue->postTasks(std::move(batch));
+            batch.clear();
+        }
+        else {
+            for (int i = 0; i < batchSize; ++i) {
+                queue->postTask(closure);
+            }
+        }
+    }
+    double seconds = vi::bench::secondsSince(start);
+
+    done.wait(vi::Event::kForever);
+    return seconds * 1e9 / (kBatches * batchSize);
+}
+
+}
+
+VI_BENCHMARK(batch_post) {
+    printf("%-10s %-10s %15s %15s\n", "batch", "submission", "loop ns/task", "batch ns/task");
+    for (bool lockFree : {false, true}) {
+        for (int batchSize : {8, 64, 256, 1024}) {
+            const double loop = measure(batchSize, false, lockFree);
+            const double batch = measure(batchSize, true, lockFree);
+            printf("%-10d %-10s %15.1f %15.1f\n", batchSize, lockFree ? "lock-free" : "locked", loop, batch);
+            vi::bench::report()
+                .param("batch", batchSize)
+                .param("submission", lockFree ? "lock-free" : "locked")
+                .metric("loop_task", loop, "ns")
+                .metric("batch_task", batch, "ns");
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vi {
+namespace bench {
+
+using BenchmarkFunction = void (*)();
+
+struct Benchmark {
+    const char* name_;
+    BenchmarkFunction function_;
+};
+
+// All benchmarks registered with VI_BENCHMARK, in registration order.
+std::vector<Benchmark>& benchmarks();
+
+class BenchmarkRegistrar {
+public:
+    BenchmarkRegistrar(const char* name, BenchmarkFunction function) {
+        benchmarks().push_back(Benchmark{name, function});
+    }
+};
+
+// One row of machine-readable results: the parameters that identify the
+// measured case and the numbers measured for it. benchmark_main.cpp writes
+// all rows as JSON when run with --json, see there for the format.
+class Result {
+public:
+    Result& param(const char* name, const char* value);
+    Result& param(const char* name, const std::string& value) { return param(name, value.c_str()); }
+    Result& param(const char* name, int64_t value);
+
+    // |unit| is free text such as "ns", "us" or "1/s". Whether higher or lower
+    // is better follows from the unit: rates are per second, everything else
+    // is a cost.
+    Result& metric(const char* name, double value, const char* unit);
+
+    const std::string& benchmark() const { return benchmark_; }
+
+    // Rendered JSON members, in the order they were added.
+    const std::vector<std::pair<std::string, std::string>>& params() const { return params_; }
+    const std::vector<std::pair<std::string, std::string>>& metrics() const { return metrics_; }
+
+private:
+    friend Result& report();
+
+    std::string benchmark_;
+
+    std::vector<std::pair<std::string, std::string>> params_;
+
+    std::vector<std::pair<std::string, std::string>> metrics_;
+};
+
+// Starts a new result row for the benchmark that is running.
+Result& report();
+
+inline double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+}
+
+// Defines and registers a benchmark that benchmark_main.cpp can run by name.
+#define VI_BENCHMARK(name) \
+    static void name(); \
+    static vi::bench::BenchmarkRegistrar name##_registrar(#name, &name); \
+    static void name()
@@ -0,0 +1,194 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <deque>
+#include <thread>
+#include "benchmark.h"
+
+namespace vi {
+namespace bench {
+
+namespace {
+
+// Rows are appended while benchmarks run; a deque keeps the references
+// returned by report() valid.
+std::deque<Result>& results() {
+    static std::deque<Result> _results;
+    return _results;
+}
+
+const char* _running = "";
+
+std::string quote(const char* text) {
+    std::string quoted = "\"";
+    for (const char* c = text; *c; ++c) {
+        switch (*c) {
+        case '"': quoted += "\\\""; break;
+        case '\\': quoted += "\\\\"; break;
+        case '\n': quoted += "\\n"; break;
+        default:
+            if (static_cast<unsigned char>(*c) < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+                quoted += escaped;
+            }
+            else {
+                quoted += *c;
+            }
+        }
+    }
+    return quoted + "\"";
+}
+
+std::string number(double value) {
+    if (!isfinite(value)) {
+        return "null";
+    }
+    char text[32];
+    snprintf(text, sizeof(text), "%.6g", value);
+    return text;
+}
+
+void writeMembers(FILE* file, const std::vector<std::pair<std::string, std::string>>& members) {
+    fprintf(file, "{");
+    for (size_t i = 0; i < members.size(); ++i) {
+        fprintf(file, "%s%s: %s", i ? ", " : "", quote(members[i].first.c_str()).c_str(), members[i].second.c_str());
+    }
+    fprintf(file, "}");
+}
+
+// {
+//   "context": {"date": ..., "host": ..., "system": ..., "cpus": ...},
+//   "results": [
+//     {"benchmark": "post_throughput",
+//      "params": {"producers": 4, "submission": "lock-free"},
+//      "metrics": {"posts": {"value": 6.1e+06, "unit": "1/s"}}},
+//     ...
+//   ]
+// }
+void writeJson(FILE* file) {
+    char date[32] = {};
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    utsname system{};
+    uname(&system);
+
+    fprintf(file, "{\n  \"context\": {\"date\": %s, \"host\": %s, \"system\": %s, \"cpus\": %u},\n  \"results\": [",
+            quote(date).c_str(), quote(system.nodename).c_str(),
+            quote((std::string(system.sysname) + " " + system.release + " " + system.machine).c_str()).c_str(),
+            std::thread::hardware_concurrency());
+    bool first = true;
+    for (const auto& result : results()) {
+        fprintf(file, "%s\n    {\"benchmark\": %s, \"params\": ", first ? "" : ",", quote(result.benchmark().c_str()).c_str());
+        writeMembers(file, result.params());
+        fprintf(file, ", \"metrics\": ");
+        writeMembers(file, result.metrics());
+        fprintf(file, "}");
+        first = false;
+    }
+    fprintf(file, "\n  ]\n}\n");
+}
+
+}  // namespace
+
+std::vector<Benchmark>& benchmarks() {
+    static std::vector<Benchmark> _benchmarks;
+    return _benchmarks;
+}
+
+Result& Result::param(const char* name, const char* value) {
+    params_.emplace_back(name, quote(value));
+    return *this;
+}
+
+Result& Result::param(const char* name, int64_t value) {
+    params_.emplace_back(name, std::to_string(value));
+    return *this;
+}
+
+Result& Result::metric(const char* name, double value, const char* unit) {
+    metrics_.emplace_back(name, "{\"value\": " + number(value) + ", \"unit\": " + quote(unit) + "}");
+    return *this;
+}
+
+Result& report() {
+    results().emplace_back();
+    results().back().benchmark_ = _running;
+    return results().back();
+}
+
+}
+}
+
+// Usage: TaskQueueBenchmark [--json=<file>] [--list] [benchmark-name...]
+// Runs every registered benchmark when no name is given. Human readable
+// tables go to stdout. With --json the results are also written to <file>
+// for comparing releases; for --json=- the JSON document goes to stdout and
+// the tables to stderr.
+int main(int argc, char* argv[])
+{
+    const char* jsonPath = nullptr;
+    std::vector<const char*> names;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--json=", 7) == 0) {
+            jsonPath = argv[i] + 7;
+        }
+        else if (strcmp(argv[i], "--list") == 0) {
+            for (const auto& benchmark : vi::bench::benchmarks()) {
+                printf("%s\n", benchmark.name_);
+            }
+            return 0;
+        }
+        else {
+            names.push_back(argv[i]);
+        }
+    }
+
+    FILE* jsonFile = nullptr;
+    if (jsonPath) {
+        if (strcmp(jsonPath, "-") == 0) {
+            jsonFile = fdopen(dup(STDOUT_FILENO), "w");
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+        }
+        else {
+            jsonFile = fopen(jsonPath, "w");
+        }
+        if (!jsonFile) {
+            perror(jsonPath);
+            return 1;
+        }
+    }
+
+    int ran = 0;
+    for (const auto& benchmark : vi::bench::benchmarks()) {
+        bool selected = names.empty();
+        for (size_t i = 0; i < names.size() && !selected; ++i) {
+            selected = strcmp(names[i], benchmark.name_) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+        printf("== %s\n", benchmark.name_);
+        fflush(stdout);
+        vi::bench::_running = benchmark.name_;
+        benchmark.function_();
+        ++ran;
+    }
+
+    if (ran == 0) {
+        fprintf(stderr, "no matching benchmark, available:\n");
+        for (const auto& benchmark : vi::bench::benchmarks()) {
+            fprintf(stderr, "  %s\n", benchmark.name_);
+        }
+        return 1;
+    }
+
+    if (jsonFile) {
+        vi::bench::writeJson(jsonFile);
+        fclose(jsonFile);
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <array>
+#include <chrono>
+#include "benchmark.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kUpdates = 200000;
+
+// Refreshing takes about this long, longer than posting an update.
+const auto kRefreshTime = std::chrono::microseconds(2);
+
+struct Result {
+    double ns_per_update_;
+    uint64_t runs_;
+    uint64_t max_pending_;
+};
+
+void refresh(const std::array<char, 128>& state) {
+    const auto end = std::chrono::steady_clock::now() + kRefreshTime;
+    volatile char sink = state[0];
+    while (std::chrono::steady_clock::now() < end) {
+        sink = sink + 1;
+    }
+}
+
+// Posts |kUpdates| "refresh key" tasks spread over |keys| keys, each
+// carrying a snapshot of the state to show, as fast as possible and waits
+// until the queue caught up.
+Result measure(int keys, bool coalesced) {
+    vi::TaskQueueOptions options;
+    options.metrics_sample_interval_ = 0;
+    auto queue = vi::TaskQueue::create("coalesce", options);
+
+    std::array<char, 128> state{};
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kUpdates; ++i) {
+        state[0] = char(i);
+        auto update = [state]{ refresh(state); };
+        if (coalesced) {
+            queue->postCoalescedTask(uint64_t(i % keys), update);
+        }
+        else {
+            queue->postTask(update);
+        }
+    }
+    queue->invoke([]{});
+    const double seconds = vi::bench::secondsSince(start);
+
+    auto stats = queue->stats();
+    return Result{seconds * 1e9 / kUpdates, stats.run_ - 1, stats.max_pending_};
+}
+
+}
+
+VI_BENCHMARK(coalesce) {
+    printf("%-6s %-10s %15s %12s %12s\n", "keys", "post", "ns/update", "runs", "max pending");
+    for (int keys : {1, 16, 256}) {
+        for (bool coalesced : {false, true}) {
+            const Result result = measure(keys, coalesced);
+            printf("%-6d %-10s %15.1f %12llu %12llu\n", keys, coalesced ? "coalesced" : "postTask", result.ns_per_update_,
+                   (unsigned long long)result.runs_, (unsigned long long)result.max_pending_);
+            vi::bench::report()
+                .param("keys", keys)
+                .param("post", coalesced ? "coalesced" : "postTask")
+                .metric("update", result.ns_per_update_, "ns")
+                .metric("runs", double(result.runs_), "runs")
+                .metric("max_pending", double(result.max_pending_), "tasks");
+        }
+    }
+}
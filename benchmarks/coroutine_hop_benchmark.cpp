@@ -0,0 +1,76 @@
+#include "task_queue_coroutine.h"
+
+#if VI_TASK_QUEUE_COROUTINES
+
+#include <stdio.h>
+#include <string>
+#include "benchmark.h"
+#include "event.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kHops = 200000;
+
+// Carried along every hop, like the packet of a real pipeline.
+struct Payload {
+    std::string data_ = std::string(64, 'x');
+    int hops_ = 0;
+};
+
+void hopCallback(vi::TaskQueue* queues[2], Payload payload, vi::Event* done) {
+    if (++payload.hops_ == kHops) {
+        done->set();
+        return;
+    }
+    queues[payload.hops_ & 1]->postTask([queues, payload = std::move(payload), done]() mutable {
+        hopCallback(queues, std::move(payload), done);
+    });
+}
+
+vi::CoTask<> hopCoroutine(vi::TaskQueue* queues[2], vi::Event* done) {
+    Payload payload;
+    while (++payload.hops_ != kHops) {
+        co_await vi::resumeOn(queues[payload.hops_ & 1]);
+    }
+    done->set();
+}
+
+void measure(const char* kind, vi::TaskQueueType type, bool coroutine) {
+    vi::TaskQueueOptions options;
+    options.type_ = type;
+    auto first = vi::TaskQueue::create("coroutine_hop_1", options);
+    auto second = vi::TaskQueue::create("coroutine_hop_2", options);
+    vi::TaskQueue* queues[2] = {first.get(), second.get()};
+
+    vi::Event done;
+    auto start = std::chrono::steady_clock::now();
+    if (coroutine) {
+        first->postTask([&]{ hopCoroutine(queues, &done).start(); });
+    }
+    else {
+        first->postTask([&]{ hopCallback(queues, Payload(), &done); });
+    }
+    done.wait(vi::Event::kForever);
+    double seconds = vi::bench::secondsSince(start);
+
+    const char* backend = type == vi::TaskQueueType::kPooled ? "pooled" : "thread";
+    printf("%-8s %-12s %10d %12.1f\n", backend, kind, kHops, seconds * 1e9 / kHops);
+    vi::bench::report()
+        .param("backend", backend)
+        .param("chain", kind)
+        .param("hops", kHops)
+        .metric("hop", seconds * 1e9 / kHops, "ns");
+}
+
+}
+
+VI_BENCHMARK(coroutine_hop) {
+    printf("%-8s %-12s %10s %12s\n", "backend", "chain", "hops", "ns/hop");
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        measure("callbacks", type, false);
+        measure("coroutine", type, true);
+    }
+}
+
+#endif
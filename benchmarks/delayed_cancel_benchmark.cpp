@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <vector>
+#include "benchmark.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kTimeouts = 120000;
+
+// Number of timeouts that are pending at any time; the oldest one is
+// cancelled before the next is posted, like request timeouts that are
+// cancelled when the response arrives.
+const int kInFlight = 1000;
+
+struct CancelResult {
+    double post_ns_{};
+    double cancel_ns_{};
+};
+
+CancelResult measureCancels(vi::DelayedQueueType type) {
+    vi::TaskQueueOptions options;
+    options.delayed_queue_type_ = type;
+    auto queue = vi::TaskQueue::create("delayed_cancel", options);
+
+    std::vector<vi::DelayedTaskHandle> handles(kInFlight);
+    double postSeconds = 0;
+    double cancelSeconds = 0;
+    for (int i = 0; i < kTimeouts; ++i) {
+        auto& handle = handles[i % kInFlight];
+        auto start = std::chrono::steady_clock::now();
+        handle.cancel();
+        cancelSeconds += vi::bench::secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        // None of the timeouts fires.
+        handle = queue->postDelayedTask([]{}, 10000 + i % 60000);
+        postSeconds += vi::bench::secondsSince(start);
+    }
+
+    CancelResult result;
+    result.post_ns_ = postSeconds * 1e9 / kTimeouts;
+    result.cancel_ns_ = cancelSeconds * 1e9 / (kTimeouts - kInFlight);
+    return result;
+}
+
+}
+
+VI_BENCHMARK(delayed_cancel) {
+    printf("%-12s %12s %15s %15s\n", "backend", "in flight", "post ns", "cancel ns");
+    for (auto type : {vi::DelayedQueueType::kOrderedMap, vi::DelayedQueueType::kTimingWheel}) {
+        const char* backend = type == vi::DelayedQueueType::kOrderedMap ? "ordered-map" : "timing-wheel";
+        auto result = measureCancels(type);
+        printf("%-12s %12d %15.1f %15.1f\n", backend, kInFlight, result.post_ns_, result.cancel_ns_);
+        vi::bench::report()
+            .param("backend", backend)
+            .param("in_flight", kInFlight)
+            .metric("post", result.post_ns_, "ns")
+            .metric("cancel", result.cancel_ns_, "ns");
+    }
+}
@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include "benchmark.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kTimeoutsInFlight = 120000;
+
+// Keeps |kTimeoutsInFlight| delayed tasks pending in one queue and returns the
+// average cost of a postDelayedTask() call in nanoseconds.
+double measureDelayedPosts(vi::DelayedQueueType type) {
+    vi::TaskQueueOptions options;
+    options.delayed_queue_type_ = type;
+    auto queue = vi::TaskQueue::create("delayed_post", options);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kTimeoutsInFlight; ++i) {
+        // Spread the timeouts over 10-70 seconds, none of them fires.
+        queue->postDelayedTask([]{}, 10000 + i % 60000);
+    }
+    return vi::bench::secondsSince(start) * 1e9 / kTimeoutsInFlight;
+}
+
+}
+
+VI_BENCHMARK(delayed_post) {
+    printf("%-12s %12s %15s\n", "backend", "in flight", "ns/post");
+    for (auto type : {vi::DelayedQueueType::kOrderedMap, vi::DelayedQueueType::kTimingWheel}) {
+        const char* backend = type == vi::DelayedQueueType::kOrderedMap ? "ordered-map" : "timing-wheel";
+        const double ns = measureDelayedPosts(type);
+        printf("%-12s %12d %15.1f\n", backend, kTimeoutsInFlight, ns);
+        vi::bench::report()
+            .param("backend", backend)
+            .param("in_flight", kTimeoutsInFlight)
+            .metric("post", ns, "ns");
+    }
+}
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "benchmark.h"
+#include "event.h"
+#include "task_queue_manager.h"
+#include "thread_pool.h"
+
+namespace {
+
+const int kQueues = 8;
+
+const int kTasksPerQueue = 100;
+
+const int kBursts = 5;
+
+// Bursts of tasks that block briefly, like calls into a slow service, into
+// pooled queues, with quiet periods in between. Returns the mean time to
+// drain a burst.
+double bursts(vi::ThreadPool& pool, const char* prefix) {
+    vi::TaskQueueOptions options;
+    options.type_ = vi::TaskQueueType::kPooled;
+    options.thread_pool_ = &pool;
+    std::vector<std::string> names;
+    for (int q = 0; q < kQueues; ++q) {
+        names.push_back(prefix + std::to_string(q));
+    }
+    TQMgr->create(names, options);
+
+    double totalMs = 0;
+    for (int burst = 0; burst < kBursts; ++burst) {
+        std::atomic<int> remaining(kQueues * kTasksPerQueue);
+        vi::Event done;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kTasksPerQueue; ++i) {
+            for (const auto& name : names) {
+                TQ(name)->postTask([&]{
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                    if (remaining.fetch_sub(1) == 1) {
+                        done.set();
+                    }
+                });
+            }
+        }
+        done.wait(vi::Event::kForever);
+        totalMs += vi::bench::secondsSince(start) * 1e3;
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    }
+
+    TQMgr->destroy(names);
+    return totalMs / kBursts;
+}
+
+}
+
+VI_BENCHMARK(elastic_pool) {
+    vi::ThreadPoolScaling scaling;
+    scaling.min_threads_ = 2;
+    scaling.max_threads_ = kQueues;
+    scaling.idle_timeout_ = std::chrono::milliseconds(20);
+
+    struct Variant {
+        const char* name_;
+        double ms_;
+        vi::ThreadPoolStats stats_;
+    };
+    std::vector<Variant> variants;
+    {
+        vi::ThreadPool pool(scaling.min_threads_);
+        variants.push_back({"fixed min", bursts(pool, "bench_min_"), pool.stats()});
+    }
+    {
+        vi::ThreadPool pool(scaling.max_threads_);
+        variants.push_back({"fixed max", bursts(pool, "bench_max_"), pool.stats()});
+    }
+    {
+        vi::ThreadPool pool(scaling);
+        variants.push_back({"elastic", bursts(pool, "bench_elastic_"), pool.stats()});
+    }
+
+    printf("%-16s %12s %14s %8s %8s\n", "variant", "ms/burst", "idle threads", "peak", "grown");
+    for (const auto& variant : variants) {
+        printf("%-16s %12.2f %14zu %8zu %8llu\n", variant.name_, variant.ms_, variant.stats_.threads_,
+               variant.stats_.peak_threads_, (unsigned long long)variant.stats_.grown_);
+        vi::bench::report()
+            .param("variant", variant.name_)
+            .metric("burst", variant.ms_, "ms")
+            .metric("idle_threads", double(variant.stats_.threads_), "threads");
+    }
+}
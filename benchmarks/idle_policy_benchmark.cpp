@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include "benchmark.h"
+#include "event.h"
+#include "latency_histogram.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kSamples = 5000;
+
+int64_t nanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Result {
+    vi::HistogramSnapshot latency_;
+    vi::TaskQueueStats stats_;
+};
+
+// Measures the time from postTask() until the task starts to run on a queue
+// that went idle after every task, and how the queue spent its idle time.
+// Spinning only pays off when the poster and the queue have a core each.
+Result measure(vi::IdlePolicy policy) {
+    vi::TaskQueueOptions options;
+    options.idle_policy_ = policy;
+    auto queue = vi::TaskQueue::create("idle_policy", options);
+
+    vi::LatencyHistogram latency;
+    vi::Event done;
+    for (int i = 0; i < kSamples; ++i) {
+        const int64_t postedAt = nanoseconds();
+        queue->postTask([&latency, &done, postedAt]{
+            latency.record(nanoseconds() - postedAt);
+            done.set();
+        });
+        done.wait(vi::Event::kForever);
+    }
+    return Result{latency.snapshot(), queue->stats()};
+}
+
+const char* policyName(vi::IdlePolicy policy) {
+    switch (policy) {
+    case vi::IdlePolicy::kSpinThenPark: return "spin then park";
+    case vi::IdlePolicy::kBusyPoll: return "busy poll";
+    case vi::IdlePolicy::kBlock: break;
+    }
+    return "block";
+}
+
+}
+
+VI_BENCHMARK(idle_policy) {
+    printf("%-16s %10s %10s %10s %10s %10s %10s\n", "policy", "p50 us", "p99 us", "wakeups", "spin hits", "idle ms", "spin ms");
+    for (auto policy : {vi::IdlePolicy::kBlock, vi::IdlePolicy::kSpinThenPark, vi::IdlePolicy::kBusyPoll}) {
+        const Result result = measure(policy);
+        const vi::HistogramSnapshot& latency = result.latency_;
+        const vi::TaskQueueStats& stats = result.stats_;
+        printf("%-16s %10.1f %10.1f %10llu %10llu %10.1f %10.1f\n", policyName(policy),
+               latency.percentile(0.5) / 1e3, latency.percentile(0.99) / 1e3,
+               (unsigned long long)stats.wakeups_, (unsigned long long)stats.spin_hits_,
+               stats.idle_us_ / 1e3, stats.spin_us_ / 1e3);
+        vi::bench::report()
+            .param("policy", policyName(policy))
+            .metric("latency_p50", latency.percentile(0.5) / 1e3, "us")
+            .metric("latency_p99", latency.percentile(0.99) / 1e3, "us")
+            .metric("wakeups", double(stats.wakeups_), "wakeups")
+            .metric("spin_hits", double(stats.spin_hits_), "hits")
+            .metric("idle", stats.idle_us_ / 1e3, "ms")
+            .metric("spin", stats.spin_us_ / 1e3, "ms");
+    }
+}
@@ -0,0 +1,103 @@
+#if defined(__linux__)
+
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "benchmark.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kRoundTrips = 20000;
+
+void signal(int fd) {
+    const uint64_t one = 1;
+    ssize_t written = write(fd, &one, sizeof(one));
+    (void)written;
+}
+
+uint64_t consume(int fd) {
+    uint64_t value = 0;
+    ssize_t got = read(fd, &value, sizeof(value));
+    (void)got;
+    return value;
+}
+
+// Ping-pong through two eventfds: the benchmark thread signals |ping|, the
+// handler on the queue consumes it and signals |pong|, which the benchmark
+// thread blocks on. Returns the mean round trip in microseconds.
+//
+// With |direct| the kIO queue watches |ping| itself. Otherwise a separate
+// thread waits in epoll and posts the handler to a kDedicatedThread queue,
+// the arrangement the I/O queue replaces.
+double measure(bool direct) {
+    const int ping = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    const int pong = eventfd(0, EFD_CLOEXEC);
+
+    vi::TaskQueueOptions options;
+    options.type_ = direct ? vi::TaskQueueType::kIO : vi::TaskQueueType::kDedicatedThread;
+    auto queue = vi::TaskQueue::create("io_hop", options);
+
+    vi::FdWatchHandle watch;
+    std::thread poller;
+    std::atomic<bool> stop(false);
+    const int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (direct) {
+        watch = queue->watchFd(ping, vi::kFdReadable, [ping, pong]{
+            consume(ping);
+            signal(pong);
+        });
+    }
+    else {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, ping, &event);
+        poller = std::thread([&]{
+            epoll_event ready{};
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (epoll_wait(epollFd, &ready, 1, 10) != 1) {
+                    continue;
+                }
+                consume(ping);
+                queue->postTask([pong]{ signal(pong); });
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRoundTrips; ++i) {
+        signal(ping);
+        consume(pong);
+    }
+    const double seconds = vi::bench::secondsSince(start);
+
+    watch.stop();
+    stop = true;
+    if (poller.joinable()) {
+        poller.join();
+    }
+    queue.reset();
+    close(epollFd);
+    close(ping);
+    close(pong);
+    return seconds * 1e6 / kRoundTrips;
+}
+
+}
+
+VI_BENCHMARK(io_hop) {
+    printf("%-24s %15s\n", "path", "round trip us");
+    for (bool direct : {false, true}) {
+        const double roundTrip = measure(direct);
+        const char* path = direct ? "kIO watchFd" : "epoll thread + postTask";
+        printf("%-24s %15.2f\n", path, roundTrip);
+        vi::bench::report()
+            .param("path", path)
+            .metric("round_trip", roundTrip, "us");
+    }
+}
+
+#endif
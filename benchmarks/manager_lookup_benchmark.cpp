@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "benchmark.h"
+#include "task_queue_manager.h"
+
+namespace {
+
+const int kLookupsPerThread = 2000000;
+
+const int kQueues = 64;
+
+// Resolves queues by name or by handle from |threads| threads at once and
+// returns the aggregated lookups per second.
+double measureLookups(int threads, bool byHandle) {
+    std::vector<vi::TaskQueueManager::Handle> handles;
+    for (int i = 0; i < kQueues; ++i) {
+        handles.push_back(TQMgr->handle("lookup" + std::to_string(i)));
+    }
+
+    std::atomic<bool> go(false);
+    std::atomic<long> found(0);
+    std::vector<std::thread> lookers;
+    for (int t = 0; t < threads; ++t) {
+        lookers.emplace_back([&, t]{
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            long hits = 0;
+            for (int i = 0; i < kLookupsPerThread; ++i) {
+                const int index = (i + t) % kQueues;
+                if (byHandle) {
+                    hits += TQMgr->queue(handles[index]) != nullptr;
+                }
+                else {
+                    // Literal names as in TQ("worker1").
+                    hits += TQ(index & 1 ? "lookup1" : "lookup2") != nullptr;
+                }
+            }
+            found.fetch_add(hits, std::memory_order_relaxed);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& looker : lookers) {
+        looker.join();
+    }
+    double seconds = vi::bench::secondsSince(start);
+    if (found.load() != long(threads) * kLookupsPerThread) {
+        printf("lookup failed\n");
+    }
+    return threads * kLookupsPerThread / seconds;
+}
+
+}
+
+VI_BENCHMARK(manager_lookup) {
+    std::vector<std::string> names;
+    for (int i = 0; i < kQueues; ++i) {
+        names.push_back("lookup" + std::to_string(i));
+    }
+    vi::TaskQueueOptions options;
+    options.type_ = vi::TaskQueueType::kPooled;
+    TQMgr->create(names, options);
+
+    printf("%-10s %-10s %15s\n", "threads", "lookup", "lookups/s");
+    for (bool byHandle : {false, true}) {
+        for (int threads : {1, 2, 4, 8}) {
+            const double lookups = measureLookups(threads, byHandle);
+            printf("%-10d %-10s %15.0f\n", threads, byHandle ? "handle" : "name", lookups);
+            vi::bench::report()
+                .param("threads", threads)
+                .param("lookup", byHandle ? "handle" : "name")
+                .metric("lookups", lookups, "1/s");
+        }
+    }
+
+    TQMgr->destroy(names);
+}
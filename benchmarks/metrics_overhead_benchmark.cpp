@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <atomic>
+#include "benchmark.h"
+#include "event.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kPosts = 1000000;
+
+// Posts |kPosts| empty tasks from one thread and returns ns per task from the
+// first post until the last task ran.
+double measure(uint32_t sampleInterval) {
+    vi::TaskQueueOptions options;
+    options.metrics_sample_interval_ = sampleInterval;
+    auto queue = vi::TaskQueue::create("metrics_overhead", options);
+
+    std::atomic<int> remaining(kPosts);
+    vi::Event done;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kPosts; ++i) {
+        queue->postTask([&remaining, &done]{
+            if (remaining.fetch_sub(1, std::memory_order_relaxed) == 1) {
+                done.set();
+            }
+        });
+    }
+    done.wait(vi::Event::kForever);
+    return vi::bench::secondsSince(start) * 1e9 / kPosts;
+}
+
+}
+
+VI_BENCHMARK(metrics_overhead) {
+    printf("%-16s %15s\n", "sample interval", "ns/task");
+    for (uint32_t interval : {0u, 64u, 16u, 1u}) {
+        const double ns = measure(interval);
+        printf("%-16u %15.1f\n", interval, ns);
+        vi::bench::report()
+            .param("sample_interval", int64_t(interval))
+            .metric("task", ns, "ns");
+    }
+}
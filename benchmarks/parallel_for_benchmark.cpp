@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+#include "event.h"
+#include "parallel.h"
+#include "task_queue.h"
+#include "thread_pool.h"
+
+namespace {
+
+const int kWorkers = 4;
+
+const size_t kItems = 1 << 16;
+
+const int kRounds = 50;
+
+// Cost grows along the range, so equal static slices are unbalanced.
+uint64_t work(size_t i) {
+    uint64_t x = i;
+    for (size_t n = 0; n < 1 + i / 2048; ++n) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    return x;
+}
+
+std::atomic<uint64_t> _sink {0};
+
+// The pattern parallelFor() replaces: one slice per queue and a countdown
+// that sets an Event.
+void handSplit(const std::vector<vi::TaskQueue*>& queues) {
+    std::atomic<int> remaining(int(queues.size()));
+    vi::Event done;
+    const size_t slice = kItems / queues.size();
+    for (size_t q = 0; q < queues.size(); ++q) {
+        queues[q]->postTask([&, q]{
+            uint64_t sum = 0;
+            for (size_t i = q * slice; i < (q + 1) * slice; ++i) {
+                sum += work(i);
+            }
+            _sink += sum;
+            if (remaining.fetch_sub(1) == 1) {
+                done.set();
+            }
+        });
+    }
+    done.wait(vi::Event::kForever);
+}
+
+template <class Executor>
+void parallel(Executor executor) {
+    vi::parallelFor(executor, 0, kItems, 0, [](size_t begin, size_t end) {
+        uint64_t sum = 0;
+        for (size_t i = begin; i < end; ++i) {
+            sum += work(i);
+        }
+        _sink += sum;
+    });
+}
+
+template <class Run>
+double measure(Run run) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRounds; ++i) {
+        run();
+    }
+    return vi::bench::secondsSince(start) * 1e3 / kRounds;
+}
+
+}
+
+VI_BENCHMARK(parallel_for) {
+    std::vector<std::unique_ptr<vi::TaskQueue>> owned;
+    std::vector<vi::TaskQueue*> queues;
+    for (int i = 0; i < kWorkers; ++i) {
+        owned.push_back(vi::TaskQueue::create("worker" + std::to_string(i + 1)));
+        queues.push_back(owned.back().get());
+    }
+
+    struct Variant {
+        const char* name_;
+        double ms_;
+    };
+    const Variant variants[] = {
+        {"hand split + Event", measure([&]{ handSplit(queues); })},
+        {"parallelFor queues", measure([&]{ parallel(queues); })},
+        {"parallelFor pool", measure([&]{ parallel(vi::ThreadPool::shared()); })},
+    };
+    printf("%-24s %15s\n", "variant", "ms/round");
+    for (const auto& variant : variants) {
+        printf("%-24s %15.2f\n", variant.name_, variant.ms_);
+        vi::bench::report()
+            .param("variant", variant.name_)
+            .metric("round", variant.ms_, "ms");
+    }
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+#include "event.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kHops = 200000;
+
+struct RingResult {
+    double hops_per_second_{};
+    double setup_ms_{};
+};
+
+struct Ring {
+    std::vector<std::unique_ptr<vi::TaskQueue>> queues_;
+    std::atomic<int> remaining_{kHops};
+    vi::Event done_;
+
+    void hop(size_t index) {
+        if (remaining_.fetch_sub(1, std::memory_order_relaxed) == 1) {
+            done_.set();
+            return;
+        }
+        size_t next = (index + 1) % queues_.size();
+        queues_[next]->postTask([this, next]{ hop(next); });
+    }
+};
+
+// Passes a token around a ring of |queueCount| queues, each hop posting the
+// next one, and measures the hops per second together with the time it took
+// to create and delete the queues.
+RingResult measureRing(int queueCount, vi::TaskQueueType type) {
+    vi::TaskQueueOptions options;
+    options.type_ = type;
+
+    RingResult result;
+    auto setupStart = std::chrono::steady_clock::now();
+    Ring ring;
+    for (int i = 0; i < queueCount; ++i) {
+        ring.queues_.push_back(vi::TaskQueue::create("ring" + std::to_string(i), options));
+    }
+    result.setup_ms_ = vi::bench::secondsSince(setupStart) * 1e3;
+
+    auto start = std::chrono::steady_clock::now();
+    ring.queues_[0]->postTask([&ring]{ ring.hop(0); });
+    ring.done_.wait(vi::Event::kForever);
+    result.hops_per_second_ = kHops / vi::bench::secondsSince(start);
+
+    auto teardownStart = std::chrono::steady_clock::now();
+    ring.queues_.clear();
+    result.setup_ms_ += vi::bench::secondsSince(teardownStart) * 1e3;
+    return result;
+}
+
+}
+
+VI_BENCHMARK(pooled_queue) {
+    printf("%-10s %-10s %15s %15s\n", "queues", "type", "hops/s", "create+del ms");
+    for (int queueCount : {4, 64, 512}) {
+        for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+            auto result = measureRing(queueCount, type);
+            const char* queueType = type == vi::TaskQueueType::kPooled ? "pooled" : "thread";
+            printf("%-10d %-10s %15.0f %15.2f\n", queueCount, queueType, result.hops_per_second_, result.setup_ms_);
+            vi::bench::report()
+                .param("queues", queueCount)
+                .param("queue", queueType)
+                .metric("hops", result.hops_per_second_, "1/s")
+                .metric("setup", result.setup_ms_, "ms");
+        }
+    }
+}
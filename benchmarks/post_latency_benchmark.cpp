@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include "benchmark.h"
+#include "event.h"
+#include "latency_histogram.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kSamples = 20000;
+
+const int kBurst = 64;
+
+int64_t nanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Measures the time from postTask() until the task starts to run. With
+// |burst| 1 every task finds the queue idle, so the latency includes waking
+// it up; with larger bursts tasks also wait for the ones posted before them.
+// The histogram is only written by the queue's tasks, which never overlap.
+vi::HistogramSnapshot measureLatency(vi::TaskQueueType type, int burst) {
+    vi::TaskQueueOptions options;
+    options.type_ = type;
+    auto queue = vi::TaskQueue::create("post_latency", options);
+
+    vi::LatencyHistogram latency;
+    vi::Event done;
+    for (int i = 0; i < kSamples / burst; ++i) {
+        for (int n = 0; n < burst; ++n) {
+            const int64_t postedAt = nanoseconds();
+            const bool last = n == burst - 1;
+            queue->postTask([&latency, &done, postedAt, last]{
+                latency.record(nanoseconds() - postedAt);
+                if (last) {
+                    done.set();
+                }
+            });
+        }
+        done.wait(vi::Event::kForever);
+    }
+    return latency.snapshot();
+}
+
+}
+
+VI_BENCHMARK(post_latency) {
+    printf("%-8s %-8s %10s %10s %10s %10s %10s %10s\n", "queue", "burst", "mean us", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        const char* queueType = type == vi::TaskQueueType::kPooled ? "pooled" : "thread";
+        for (int burst : {1, kBurst}) {
+            auto latency = measureLatency(type, burst);
+            printf("%-8s %-8d %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", queueType, burst,
+                   latency.mean() / 1e3, latency.percentile(0.5) / 1e3, latency.percentile(0.9) / 1e3,
+                   latency.percentile(0.99) / 1e3, latency.percentile(0.999) / 1e3, latency.max_ns_ / 1e3);
+            vi::bench::report()
+                .param("queue", queueType)
+                .param("burst", burst)
+                .metric("latency_mean", latency.mean() / 1e3, "us")
+                .metric("latency_p50", latency.percentile(0.5) / 1e3, "us")
+                .metric("latency_p90", latency.percentile(0.9) / 1e3, "us")
+                .metric("latency_p99", latency.percentile(0.99) / 1e3, "us")
+                .metric("latency_p999", latency.percentile(0.999) / 1e3, "us")
+                .metric("latency_max", latency.max_ns_ / 1e3, "us");
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "benchmark.h"
+#include "event.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kPostsPerProducer = 200000;
+
+struct PostResult {
+    double posts_per_second_{};
+    // Voluntary and involuntary context switches of the process per post, a
+    // proxy for the wakeup syscalls the queue makes.
+    double context_switches_per_post_{};
+};
+
+long contextSwitches() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+// Posts |kPostsPerProducer| empty tasks from each of |producers| threads into a
+// single queue and measures the aggregated number of posts per second.
+PostResult measurePosts(int producers, const vi::TaskQueueOptions& options) {
+    auto queue = vi::TaskQueue::create("post_throughput", options);
+
+    std::atomic<int> remaining(producers * kPostsPerProducer);
+    std::atomic<bool> go(false);
+    vi::Event done;
+
+    std::vector<std::thread> threads;
+    for (int n = 0; n < producers; ++n) {
+        threads.emplace_back([&]{
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (int i = 0; i < kPostsPerProducer; ++i) {
+                queue->postTask([&remaining, &done]{
+                    if (remaining.fetch_sub(1, std::memory_order_relaxed) == 1) {
+                        done.set();
+                    }
+                });
+            }
+        });
+    }
+
+    const long switches = contextSwitches();
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = vi::bench::secondsSince(start);
+
+    done.wait(vi::Event::kForever);
+
+    PostResult result;
+    result.posts_per_second_ = producers * kPostsPerProducer / seconds;
+    result.context_switches_per_post_ = double(contextSwitches() - switches) / (producers * kPostsPerProducer);
+    return result;
+}
+
+}
+
+VI_BENCHMARK(post_throughput) {
+    printf("%-10s %-10s %-10s %15s %15s\n", "queue", "producers", "submission", "posts/s", "ctxsw/post");
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        const char* queueType = type == vi::TaskQueueType::kPooled ? "pooled" : "thread";
+        for (bool lockFree : {false, true}) {
+            for (int producers : {1, 2, 4, 8, 12, 16}) {
+                vi::TaskQueueOptions options;
+                options.type_ = type;
+                options.lock_free_submission_ = lockFree;
+                auto result = measurePosts(producers, options);
+                printf("%-10s %-10d %-10s %15.0f %15.4f\n", queueType, producers, lockFree ? "lock-free" : "locked",
+                       result.posts_per_second_, result.context_switches_per_post_);
+                vi::bench::report()
+                    .param("queue", queueType)
+                    .param("producers", producers)
+                    .param("submission", lockFree ? "lock-free" : "locked")
+                    .metric("posts", result.posts_per_second_, "1/s")
+                    .metric("context_switches", result.context_switches_per_post_, "1/post");
+            }
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include "benchmark.h"
+#include "event.h"
+#include "latency_histogram.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kBulkTasks = 200000;
+
+const int kControlTasks = 500;
+
+int64_t nanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void spin(int iterations) {
+    for (volatile int i = 0; i < iterations; i = i + 1) {
+    }
+}
+
+// A producer keeps the queue loaded with small bulk tasks while control tasks
+// of |priority| are posted next to them; returns the post-to-run latency of
+// the control tasks.
+vi::HistogramSnapshot measureControlLatency(vi::TaskQueueType type, vi::TaskPriority priority) {
+    vi::TaskQueueOptions options;
+    options.type_ = type;
+    auto queue = vi::TaskQueue::create("priority_latency", options);
+
+    std::atomic<bool> stop(false);
+    std::thread bulk([&]{
+        for (int i = 0; i < kBulkTasks && !stop.load(std::memory_order_relaxed); ++i) {
+            queue->postTask([]{ spin(200); });
+            if (i % 64 == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    vi::LatencyHistogram latency;
+    vi::Event ran;
+    for (int i = 0; i < kControlTasks; ++i) {
+        const int64_t postedAt = nanoseconds();
+        queue->postTask([&latency, &ran, postedAt]{
+            latency.record(nanoseconds() - postedAt);
+            ran.set();
+        }, priority);
+        ran.wait(vi::Event::kForever);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    stop.store(true);
+    bulk.join();
+    return latency.snapshot();
+}
+
+}
+
+VI_BENCHMARK(priority_latency) {
+    printf("%-8s %-10s %10s %10s %10s %10s\n", "queue", "priority", "p50 us", "p99 us", "p99.9 us", "max us");
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        const char* queueType = type == vi::TaskQueueType::kPooled ? "pooled" : "thread";
+        for (auto priority : {vi::TaskPriority::kNormal, vi::TaskPriority::kHigh}) {
+            const char* priorityName = priority == vi::TaskPriority::kHigh ? "high" : "normal";
+            auto latency = measureControlLatency(type, priority);
+            printf("%-8s %-10s %10.1f %10.1f %10.1f %10.1f\n", queueType, priorityName,
+                   latency.percentile(0.5) / 1e3, latency.percentile(0.99) / 1e3,
+                   latency.percentile(0.999) / 1e3, latency.max_ns_ / 1e3);
+            vi::bench::report()
+                .param("queue", queueType)
+                .param("priority", priorityName)
+                .metric("latency_p50", latency.percentile(0.5) / 1e3, "us")
+                .metric("latency_p99", latency.percentile(0.99) / 1e3, "us")
+                .metric("latency_p999", latency.percentile(0.999) / 1e3, "us")
+                .metric("latency_max", latency.max_ns_ / 1e3, "us");
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+#include "task_queue.h"
+#include "task_queue_manager.h"
+
+namespace {
+
+const int kQueues = 256;
+
+struct Lifecycle {
+    double create_us_{};
+    double destroy_us_{};
+};
+
+// Creates |kQueues| queues and deletes them again, reporting the average cost
+// of each step. The queues stay idle, so deleting measures the shutdown of
+// the queue itself rather than draining tasks.
+Lifecycle measureQueues(vi::TaskQueueType type) {
+    vi::TaskQueueOptions options;
+    options.type_ = type;
+
+    std::vector<std::unique_ptr<vi::TaskQueue>> queues;
+    queues.reserve(kQueues);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kQueues; ++i) {
+        queues.push_back(vi::TaskQueue::create("queue_lifecycle", options));
+    }
+    Lifecycle result;
+    result.create_us_ = vi::bench::secondsSince(start) * 1e6 / kQueues;
+
+    start = std::chrono::steady_clock::now();
+    queues.clear();
+    result.destroy_us_ = vi::bench::secondsSince(start) * 1e6 / kQueues;
+    return result;
+}
+
+// Same through TaskQueueManager, which adds registering the names and, on
+// destroy, waiting for readers of the queue table.
+Lifecycle measureManager(vi::TaskQueueType type) {
+    vi::TaskQueueOptions options;
+    options.type_ = type;
+
+    std::vector<std::string> names;
+    for (int i = 0; i < kQueues; ++i) {
+        names.push_back("lifecycle" + std::to_string(i));
+    }
+
+    Lifecycle result;
+    auto start = std::chrono::steady_clock::now();
+    TQMgr->create(names, options);
+    result.create_us_ = vi::bench::secondsSince(start) * 1e6 / kQueues;
+
+    start = std::chrono::steady_clock::now();
+    TQMgr->destroy(names);
+    result.destroy_us_ = vi::bench::secondsSince(start) * 1e6 / kQueues;
+    return result;
+}
+
+}
+
+VI_BENCHMARK(queue_lifecycle) {
+    printf("%-8s %-10s %15s %15s\n", "queue", "via", "create us", "destroy us");
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        const char* queueType = type == vi::TaskQueueType::kPooled ? "pooled" : "thread";
+        for (bool manager : {false, true}) {
+            auto result = manager ? measureManager(type) : measureQueues(type);
+            printf("%-8s %-10s %15.2f %15.2f\n", queueType, manager ? "manager" : "direct", result.create_us_, result.destroy_us_);
+            vi::bench::report()
+                .param("queue", queueType)
+                .param("via", manager ? "manager" : "direct")
+                .param("queues", kQueues)
+                .metric("create", result.create_us_, "us")
+                .metric("destroy", result.destroy_us_, "us");
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <functional>
+#include <thread>
+#include "benchmark.h"
+#include "event.h"
+#include "task_queue.h"
+#include "task_queue_base.h"
+
+namespace {
+
+const auto kPeriod = std::chrono::milliseconds(1);
+
+const int kRuns = 500;
+
+// Work done by every run, which a self-reposting timer adds to its period.
+const auto kWork = std::chrono::microseconds(200);
+
+void work() {
+    const auto until = std::chrono::steady_clock::now() + kWork;
+    while (std::chrono::steady_clock::now() < until) {
+    }
+}
+
+// How far behind its ideal schedule the last of |kRuns| runs was, in
+// microseconds.
+double measureDrift(bool native, vi::DelayedQueueType type) {
+    vi::TaskQueueOptions options;
+    options.delayed_queue_type_ = type;
+    auto queue = vi::TaskQueue::create("repeating_task", options);
+
+    int runs = 0;
+    vi::Event done;
+    std::chrono::steady_clock::time_point last;
+    const auto start = std::chrono::steady_clock::now();
+    if (native) {
+        auto handle = queue->postRepeatingTask([&]{
+            last = std::chrono::steady_clock::now();
+            work();
+            if (++runs == kRuns) {
+                done.set();
+            }
+        }, kPeriod);
+        done.wait(vi::Event::kForever);
+        handle.stop();
+    }
+    else {
+        std::function<void()> repost = [&]{
+            last = std::chrono::steady_clock::now();
+            work();
+            if (++runs == kRuns) {
+                done.set();
+                return;
+            }
+            queue->postDelayedTask([&repost]{ repost(); }, kPeriod);
+        };
+        queue->postDelayedTask([&repost]{ repost(); }, kPeriod);
+        done.wait(vi::Event::kForever);
+    }
+    return std::chrono::duration<double, std::micro>(last - (start + kPeriod * kRuns)).count();
+}
+
+}
+
+VI_BENCHMARK(repeating_task) {
+    printf("%-12s %-10s %10s %15s\n", "backend", "timer", "runs", "drift us");
+    for (auto type : {vi::DelayedQueueType::kOrderedMap, vi::DelayedQueueType::kTimingWheel}) {
+        const char* backend = type == vi::DelayedQueueType::kOrderedMap ? "ordered-map" : "timing-wheel";
+        for (bool native : {false, true}) {
+            const double drift = measureDrift(native, type);
+            printf("%-12s %-10s %10d %15.0f\n", backend, native ? "repeating" : "repost", kRuns, drift);
+            vi::bench::report()
+                .param("backend", backend)
+                .param("timer", native ? "repeating" : "repost")
+                .param("runs", kRuns)
+                .metric("drift", drift, "us");
+        }
+    }
+}
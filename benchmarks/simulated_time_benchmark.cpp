@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "benchmark.h"
+#include "simulated_clock.h"
+#include "task_queue_manager.h"
+
+namespace {
+
+using namespace std::chrono_literals;
+
+const int kTimers = 100000;
+
+const int kRepeating = 100;
+
+// A day of timers: one-shot timeouts spread over the day and repeating
+// tasks with periods from one second to a few minutes. Returns the wall
+// time it takes in milliseconds.
+double simulateDay(vi::DelayedQueueType type, uint64_t& tasks) {
+    vi::SimulatedClock clock;
+    TQMgr->setSimulatedClock(&clock);
+    vi::TaskQueueOptions options;
+    options.delayed_queue_type_ = type;
+    TQMgr->create({"bench_sim_timeouts", "bench_sim_periodic"}, options);
+
+    std::mt19937 random(3);
+    for (int i = 0; i < kTimers; ++i) {
+        TQ("bench_sim_timeouts")->postDelayedTask([]{}, std::chrono::microseconds(int64_t(random() % 86400000) * 1000));
+    }
+    std::vector<vi::RepeatingTaskHandle> handles;
+    for (int i = 0; i < kRepeating; ++i) {
+        handles.push_back(TQ("bench_sim_periodic")->postRepeatingTask([]{}, std::chrono::seconds(1 + random() % 300)));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    clock.runFor(24h);
+    const double ms = vi::bench::secondsSince(start) * 1e3;
+    tasks = clock.tasksRun();
+
+    for (auto& handle : handles) {
+        handle.stop();
+    }
+    TQMgr->destroy({"bench_sim_timeouts", "bench_sim_periodic"});
+    TQMgr->setSimulatedClock(nullptr);
+    return ms;
+}
+
+}
+
+VI_BENCHMARK(simulated_time) {
+    struct Variant {
+        const char* name_;
+        vi::DelayedQueueType type_;
+    };
+    const Variant variants[] = {
+        {"ordered map", vi::DelayedQueueType::kOrderedMap},
+        {"timing wheel", vi::DelayedQueueType::kTimingWheel},
+    };
+    printf("%-16s %12s %14s %16s\n", "variant", "tasks", "ms/day", "tasks/s");
+    for (const auto& variant : variants) {
+        uint64_t tasks = 0;
+        const double ms = simulateDay(variant.type_, tasks);
+        const double perSecond = tasks / (ms / 1e3);
+        printf("%-16s %12llu %14.1f %16.0f\n", variant.name_, (unsigned long long)tasks, ms, perSecond);
+        vi::bench::report()
+            .param("variant", variant.name_)
+            .metric("day", ms, "ms")
+            .metric("throughput", perSecond, "tasks/s");
+    }
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <array>
+#include <atomic>
+#include <future>
+#include <new>
+#include "benchmark.h"
+#include "event.h"
+#include "task_queue.h"
+
+namespace {
+
+// Counts every global operator new of the benchmark binary so that the
+// allocations per post can be reported.
+std::atomic<uint64_t> _allocations(0);
+
+const int kPosts = 200000;
+
+template <typename Post>
+void measure(const char* kind, Post post) {
+    auto queue = vi::TaskQueue::create("task_allocation");
+    vi::Event done;
+
+    // Warm up the pools and the pending queue.
+    for (int i = 0; i < kPosts; ++i) {
+        post(queue.get());
+    }
+    queue->postTask([&done]{ done.set(); });
+    done.wait(vi::Event::kForever);
+
+    const uint64_t before = _allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kPosts; ++i) {
+        post(queue.get());
+    }
+    double seconds = vi::bench::secondsSince(start);
+    const uint64_t allocations = _allocations.load() - before;
+
+    queue->postTask([&done]{ done.set(); });
+    done.wait(vi::Event::kForever);
+
+    printf("%-24s %15.3f %12.1f\n", kind, double(allocations) / kPosts, seconds * 1e9 / kPosts);
+    vi::bench::report()
+        .param("task", kind)
+        .metric("allocations", double(allocations) / kPosts, "1/post")
+        .metric("post", seconds * 1e9 / kPosts, "ns");
+}
+
+}
+
+void* operator new(size_t size) {
+    _allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+VI_BENCHMARK(task_allocation) {
+    std::array<char, 32> small{};
+    std::array<char, 160> large{};
+    std::array<char, 1024> huge{};
+    printf("%-24s %15s %12s\n", "task", "allocs/post", "ns/post");
+    measure("closure 32 bytes", [&](vi::TaskQueue* queue) {
+        queue->postTask([small]{ (void)small; });
+    });
+    measure("closure 160 bytes", [&](vi::TaskQueue* queue) {
+        queue->postTask([large]{ (void)large; });
+    });
+    measure("closure 1024 bytes", [&](vi::TaskQueue* queue) {
+        queue->postTask([huge]{ (void)huge; });
+    });
+    measure("QueuedTask subclass", [&](vi::TaskQueue* queue) {
+        queue->postTask(vi::ToQueuedTask([small]{ (void)small; }));
+    });
+    // Round trips with a result, blocking until the task has run.
+    measure("invoke", [&](vi::TaskQueue* queue) {
+        int value = queue->invoke([&small]{ return int(small[0]); });
+        (void)value;
+    });
+    measure("std::promise/future", [&](vi::TaskQueue* queue) {
+        std::promise<int> promise;
+        std::future<int> future = promise.get_future();
+        queue->postTask([&small, promise = std::move(promise)]() mutable { promise.set_value(int(small[0])); });
+        int value = future.get();
+        (void)value;
+    });
+    measure("postTaskAndReply", [&](vi::TaskQueue* queue) {
+        queue->postTaskAndReply([small]{ return small; }, queue, [](std::array<char, 32> result){ (void)result; });
+    });
+}
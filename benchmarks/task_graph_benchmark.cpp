@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <atomic>
+#include <memory>
+#include "benchmark.h"
+#include "event.h"
+#include "task_graph.h"
+#include "task_queue_manager.h"
+
+namespace {
+
+const int kFrames = 20000;
+
+// The pipeline by hand: A posts B and C, which count down a per-frame
+// counter; the second one posts D.
+void handChained(vi::Event& done) {
+    TQ("bench_io")->postTask([&done]{
+        auto remaining = std::make_shared<std::atomic<int>>(2);
+        auto join = [remaining, &done]{
+            if (remaining->fetch_sub(1) == 1) {
+                TQ("bench_net")->postTask([&done]{ done.set(); });
+            }
+        };
+        TQ("bench_codec")->postTask(join);
+        TQ("bench_codec")->postTask(join);
+    });
+    done.wait(vi::Event::kForever);
+}
+
+}
+
+VI_BENCHMARK(task_graph) {
+    TQMgr->create({"bench_io", "bench_codec", "bench_net"});
+
+    vi::Event done;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kFrames; ++i) {
+        handChained(done);
+    }
+    const double handUs = vi::bench::secondsSince(start) * 1e6 / kFrames;
+
+    vi::TaskGraph graph;
+    const auto a = graph.addNode("bench_io", []{});
+    const auto b = graph.addNode("bench_codec", []{});
+    const auto c = graph.addNode("bench_codec", []{});
+    const auto d = graph.addNode("bench_net", []{});
+    graph.addEdge(a, b);
+    graph.addEdge(a, c);
+    graph.addEdge(b, d);
+    graph.addEdge(c, d);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kFrames; ++i) {
+        graph.run();
+        graph.wait();
+    }
+    const double graphUs = vi::bench::secondsSince(start) * 1e6 / kFrames;
+
+    TQMgr->destroy({"bench_io", "bench_codec", "bench_net"});
+
+    printf("%-24s %15s\n", "variant", "us/frame");
+    printf("%-24s %15.2f\n", "hand chained", handUs);
+    printf("%-24s %15.2f\n", "TaskGraph", graphUs);
+    vi::bench::report()
+        .param("variant", "hand chained")
+        .metric("frame", handUs, "us");
+    vi::bench::report()
+        .param("variant", "TaskGraph")
+        .metric("frame", graphUs, "us");
+}
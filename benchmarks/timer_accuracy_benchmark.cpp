@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "benchmark.h"
+#include "event.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kSamples = 200;
+
+struct Lateness {
+    double mean_us_{};
+    double p50_us_{};
+    double p99_us_{};
+    double max_us_{};
+    double min_us_{};
+};
+
+// Posts |kSamples| delayed tasks one after the other and measures how far
+// after the requested fire time each of them actually ran.
+Lateness measureLateness(vi::TaskQueue* queue, std::chrono::microseconds delay) {
+    std::vector<double> samples;
+    samples.reserve(kSamples);
+    vi::Event fired;
+
+    for (int i = 0; i < kSamples; ++i) {
+        const auto requested = std::chrono::steady_clock::now() + delay;
+        queue->postDelayedTask([&samples, &fired, requested]{
+            auto late = std::chrono::steady_clock::now() - requested;
+            samples.push_back(std::chrono::duration<double, std::micro>(late).count());
+            fired.set();
+        }, delay);
+        fired.wait(vi::Event::kForever);
+    }
+
+    std::sort(samples.begin(), samples.end());
+    Lateness result;
+    for (double sample : samples) {
+        result.mean_us_ += sample / samples.size();
+    }
+    result.p50_us_ = samples[samples.size() / 2];
+    result.p99_us_ = samples[samples.size() * 99 / 100];
+    result.max_us_ = samples.back();
+    result.min_us_ = samples.front();
+    return result;
+}
+
+}
+
+VI_BENCHMARK(timer_accuracy) {
+    printf("%-8s %-12s %10s %10s %10s %10s %10s %10s\n", "queue", "backend", "delay us", "min us", "mean us", "p50 us", "p99 us", "max us");
+    for (auto queueType : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        for (auto type : {vi::DelayedQueueType::kOrderedMap, vi::DelayedQueueType::kTimingWheel}) {
+            vi::TaskQueueOptions options;
+            options.type_ = queueType;
+            options.delayed_queue_type_ = type;
+            auto queue = vi::TaskQueue::create("timer_accuracy", options);
+            const char* queueName = queueType == vi::TaskQueueType::kPooled ? "pooled" : "thread";
+            const char* backend = type == vi::DelayedQueueType::kOrderedMap ? "ordered-map" : "timing-wheel";
+            for (int delay_us : {500, 1000, 2000, 5000}) {
+                auto lateness = measureLateness(queue.get(), std::chrono::microseconds(delay_us));
+                printf("%-8s %-12s %10d %10.1f %10.1f %10.1f %10.1f %10.1f\n", queueName, backend,
+                       delay_us, lateness.min_us_, lateness.mean_us_, lateness.p50_us_, lateness.p99_us_, lateness.max_us_);
+                vi::bench::report()
+                    .param("queue", queueName)
+                    .param("backend", backend)
+                    .param("delay_us", delay_us)
+                    .metric("late_min", lateness.min_us_, "us")
+                    .metric("late_mean", lateness.mean_us_, "us")
+                    .metric("late_p50", lateness.p50_us_, "us")
+                    .metric("late_p99", lateness.p99_us_, "us")
+                    .metric("late_max", lateness.max_us_, "us");
+            }
+        }
+    }
+}
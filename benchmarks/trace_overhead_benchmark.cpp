@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <atomic>
+#include "benchmark.h"
+#include "event.h"
+#include "task_queue.h"
+#include "trace_log.h"
+
+namespace {
+
+const int kPosts = 1000000;
+
+// Posts |kPosts| empty tasks from one thread and returns ns per task from the
+// first post until the last task ran, with tracing on or off.
+double measure(bool tracing) {
+    auto queue = vi::TaskQueue::create("trace_overhead");
+    if (tracing) {
+        vi::TraceLog::clear();
+        vi::TraceLog::start();
+    }
+
+    std::atomic<int> remaining(kPosts);
+    vi::Event done;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kPosts; ++i) {
+        queue->postTask([&remaining, &done]{
+            if (remaining.fetch_sub(1, std::memory_order_relaxed) == 1) {
+                done.set();
+            }
+        });
+    }
+    done.wait(vi::Event::kForever);
+    const double ns = vi::bench::secondsSince(start) * 1e9 / kPosts;
+
+    vi::TraceLog::stop();
+    vi::TraceLog::clear();
+    return ns;
+}
+
+}
+
+VI_BENCHMARK(trace_overhead) {
+    printf("%-16s %15s\n", "tracing", "ns/task");
+    for (bool tracing : {false, true}) {
+        const double ns = measure(tracing);
+        printf("%-16s %15.1f\n", tracing ? "on" : "off", ns);
+        vi::bench::report()
+            .param("tracing", tracing ? "on" : "off")
+            .metric("task", ns, "ns");
+    }
+}
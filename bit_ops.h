@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+#if __has_include(<version>)
+#include <version>
+#endif
+
+#if defined(__cpp_lib_bitops)
+#include <bit>
+#endif
+
+namespace vi {
+
+// Bit scans on std::countr_zero and std::countl_zero where the standard
+// library has them, the compiler builtins on GCC and Clang before C++20,
+// and plain loops elsewhere.
+
+// |value| must not be 0.
+inline int countTrailingZeros(uint64_t value) {
+#if defined(__cpp_lib_bitops)
+    return std::countr_zero(value);
+#elif defined(__GNUC__)
+    return __builtin_ctzll(value);
+#else
+    int count = 0;
+    while (!(value & 1)) {
+        value >>= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+// |value| must not be 0.
+inline int countLeadingZeros(uint64_t value) {
+#if defined(__cpp_lib_bitops)
+    return std::countl_zero(value);
+#elif defined(__GNUC__)
+    return __builtin_clzll(value);
+#else
+    int count = 0;
+    while (!(value & (uint64_t(1) << 63))) {
+        value <<= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+}
@@ -0,0 +1,100 @@
+#include "block_pool.h"
+#include <assert.h>
+#include <new>
+
+namespace vi {
+
+namespace {
+
+uint64_t makeHead(uint64_t generation, uint32_t top) {
+    return (generation << 32) | top;
+}
+
+}  // namespace
+
+BlockPool::BlockPool(size_t blockSize, size_t blocksPerSlab)
+    : payload_size_((blockSize + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1))
+    , stride_(kHeaderSize + payload_size_)
+    , blocks_per_slab_(blocksPerSlab > 0 ? blocksPerSlab : 1) {
+}
+
+BlockPool::~BlockPool() {
+    for (size_t i = 0; i < slab_count_; ++i) {
+        ::operator delete(slabs_[i].load(std::memory_order_relaxed));
+    }
+}
+
+BlockPool::BlockHeader* BlockPool::headerAt(uint32_t index) const {
+    char* slab = slabs_[index / blocks_per_slab_].load(std::memory_order_acquire);
+    return reinterpret_cast<BlockHeader*>(slab + (index % blocks_per_slab_) * stride_);
+}
+
+void* BlockPool::allocate() {
+    uint64_t head = free_head_.load(std::memory_order_acquire);
+    while (true) {
+        const uint32_t top = static_cast<uint32_t>(head);
+        if (top == 0) {
+            if (!grow()) {
+                auto header = static_cast<BlockHeader*>(::operator new(stride_));
+                header->index_ = kHeapIndex;
+                return reinterpret_cast<char*>(header) + kHeaderSize;
+            }
+            head = free_head_.load(std::memory_order_acquire);
+            continue;
+        }
+
+        BlockHeader* header = headerAt(top - 1);
+        // |header| may be handed out concurrently, in which case the
+        // generation changed and the exchange below fails.
+        const uint32_t next = header->next_.load(std::memory_order_relaxed);
+        if (free_head_.compare_exchange_weak(head, makeHead((head >> 32) + 1, next), std::memory_order_acquire, std::memory_order_acquire)) {
+            return reinterpret_cast<char*>(header) + kHeaderSize;
+        }
+    }
+}
+
+void BlockPool::deallocate(void* block) {
+    auto header = reinterpret_cast<BlockHeader*>(static_cast<char*>(block) - kHeaderSize);
+    if (header->index_ == kHeapIndex) {
+        ::operator delete(header);
+        return;
+    }
+
+    uint64_t head = free_head_.load(std::memory_order_relaxed);
+    do {
+        header->next_.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+    } while (!free_head_.compare_exchange_weak(head, makeHead((head >> 32) + 1, header->index_ + 1), std::memory_order_release, std::memory_order_relaxed));
+}
+
+bool BlockPool::grow() {
+    std::unique_lock<std::mutex> lock(grow_mutex_);
+
+    if (static_cast<uint32_t>(free_head_.load(std::memory_order_acquire)) != 0) {
+        // Another thread grew the pool or blocks were released meanwhile.
+        return true;
+    }
+    if (slab_count_ == kMaxSlabs) {
+        return false;
+    }
+
+    auto slab = static_cast<char*>(::operator new(stride_ * blocks_per_slab_));
+    const uint32_t first = static_cast<uint32_t>(slab_count_ * blocks_per_slab_);
+    for (size_t i = 0; i < blocks_per_slab_; ++i) {
+        auto header = new (slab + i * stride_) BlockHeader();
+        header->index_ = first + static_cast<uint32_t>(i);
+        header->next_.store(header->index_ + 2, std::memory_order_relaxed);
+    }
+    slabs_[slab_count_].store(slab, std::memory_order_release);
+    ++slab_count_;
+
+    // Splice the new chain in front of whatever was released meanwhile.
+    auto last = reinterpret_cast<BlockHeader*>(slab + (blocks_per_slab_ - 1) * stride_);
+    uint64_t head = free_head_.load(std::memory_order_relaxed);
+    do {
+        last->next_.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+    } while (!free_head_.compare_exchange_weak(head, makeHead((head >> 32) + 1, first + 1), std::memory_order_release, std::memory_order_relaxed));
+
+    return true;
+}
+
+}
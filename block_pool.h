@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+namespace vi {
+
+// Thread-safe pool of fixed size memory blocks.
+//
+// allocate() and deallocate() are lock-free and may be called from any
+// thread; a block is typically allocated by a posting thread and released on
+// the worker thread. Free blocks form a Treiber stack addressed by block index
+// with a generation tag, which rules out the ABA problem. The pool grows one
+// slab at a time under a mutex and only returns memory to the system when it
+// is destroyed. Once |kMaxSlabs| slabs are in use, further blocks come from
+// the heap.
+class BlockPool {
+public:
+    explicit BlockPool(size_t blockSize, size_t blocksPerSlab = 256);
+    ~BlockPool();
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    // Returns uninitialized storage of at least blockSize() bytes, aligned
+    // like std::max_align_t.
+    void* allocate();
+
+    // Returns a block obtained from allocate() on this pool.
+    void deallocate(void* block);
+
+    size_t blockSize() const { return payload_size_; }
+
+private:
+    static constexpr size_t kMaxSlabs = 4096;
+    static constexpr uint32_t kHeapIndex = UINT32_MAX;
+
+    struct BlockHeader {
+        uint32_t index_;
+        // Index + 1 of the next free block, 0 terminates the list.
+        std::atomic<uint32_t> next_;
+    };
+
+    static constexpr size_t kHeaderSize = (sizeof(BlockHeader) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+    BlockHeader* headerAt(uint32_t index) const;
+
+    // Adds a slab to the free list. Returns false when the slab limit is hit.
+    bool grow();
+
+private:
+    const size_t payload_size_;
+
+    const size_t stride_;
+
+    const size_t blocks_per_slab_;
+
+    // (generation << 32) | (index + 1) of the top free block.
+    std::atomic<uint64_t> free_head_ {0};
+
+    std::atomic<char*> slabs_[kMaxSlabs] = {};
+
+    size_t slab_count_ {0};
+
+    std::mutex grow_mutex_;
+};
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include "delayed_task_queue.h"
+
+namespace vi {
+
+struct RepeatingTaskState;
+
+// Removes delayed tasks of one task queue on behalf of DelayedTaskHandle and
+// RepeatingTaskHandle.
+// Owned jointly by the queue and its handles, so that a handle may outlive
+// the queue; cancel() fails once the queue is gone.
+class DelayedTaskCanceler {
+public:
+    virtual ~DelayedTaskCanceler() = default;
+
+    // See DelayedTaskHandle::cancel(). |id| is the value returned by
+    // DelayedTaskQueue::push() for |timeout|.
+    virtual bool cancel(const DelayedEntryTimeout& timeout, uint64_t id) = 0;
+
+    // See RepeatingTaskHandle::stop(), which set |state.stopped_| already.
+    virtual void stop(RepeatingTaskState& state) = 0;
+};
+
+// Returned by postDelayedTask() to cancel the task before it fires. Cheap to
+// copy; a default constructed handle refers to no task.
+class DelayedTaskHandle {
+public:
+    DelayedTaskHandle() = default;
+
+    DelayedTaskHandle(std::shared_ptr<DelayedTaskCanceler> canceler, const DelayedEntryTimeout& timeout, uint64_t id)
+        : canceler_(std::move(canceler))
+        , timeout_(timeout)
+        , id_(id) {
+    }
+
+    // Removes the task from its queue and destroys it, together with
+    // everything its closure captured, before returning. May be called from
+    // any thread, including from tasks of the queue itself. Returns false if
+    // the task already started to run, was cancelled before or its queue was
+    // deleted.
+    bool cancel() {
+        return canceler_ && canceler_->cancel(timeout_, id_);
+    }
+
+    bool valid() const { return canceler_ != nullptr; }
+
+private:
+    std::shared_ptr<DelayedTaskCanceler> canceler_;
+
+    DelayedEntryTimeout timeout_;
+
+    uint64_t id_ {0};
+};
+
+}
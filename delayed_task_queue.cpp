@@ -0,0 +1,67 @@
+#include "delayed_task_queue.h"
+#include <assert.h>
+#include "timing_wheel.h"
+
+namespace vi {
+
+std::unique_ptr<DelayedTaskQueue> DelayedTaskQueue::create(DelayedQueueType type) {
+    switch (type) {
+    case DelayedQueueType::kTimingWheel:
+        return std::make_unique<TimingWheel>();
+    case DelayedQueueType::kOrderedMap:
+    default:
+        return std::make_unique<OrderedMapDelayedTaskQueue>();
+    }
+}
+
+uint64_t OrderedMapDelayedTaskQueue::push(const DelayedEntryTimeout& timeout, Task task) {
+    if (spare_) {
+        spare_.key() = timeout;
+        spare_.mapped() = std::move(task);
+        queue_.insert(std::move(spare_));
+    }
+    else {
+        queue_[timeout] = std::move(task);
+    }
+    // Entries are found by their key.
+    return 0;
+}
+
+Task OrderedMapDelayedTaskQueue::erase(const DelayedEntryTimeout& timeout, uint64_t) {
+    auto entry = queue_.find(timeout);
+    if (entry == queue_.end()) {
+        return Task();
+    }
+    auto task = std::move(entry->second);
+    queue_.erase(entry);
+    return task;
+}
+
+const DelayedEntryTimeout* OrderedMapDelayedTaskQueue::front(int64_t now) {
+    if (queue_.empty()) {
+        return nullptr;
+    }
+    const auto& timeout = queue_.begin()->first;
+    return now >= timeout.next_fire_at_us_ ? &timeout : nullptr;
+}
+
+Task OrderedMapDelayedTaskQueue::pop() {
+    assert(!queue_.empty());
+    spare_ = queue_.extract(queue_.begin());
+    return std::move(spare_.mapped());
+}
+
+int64_t OrderedMapDelayedTaskQueue::nextFireTime() {
+    assert(!queue_.empty());
+    return queue_.begin()->first.next_fire_at_us_;
+}
+
+bool OrderedMapDelayedTaskQueue::empty() const {
+    return queue_.empty();
+}
+
+size_t OrderedMapDelayedTaskQueue::size() const {
+    return queue_.size();
+}
+
+}
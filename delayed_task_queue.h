@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <memory>
+#include <tuple>
+#include "task.h"
+#include "task_queue_options.h"
+
+namespace vi {
+
+struct RepeatingTaskState;
+
+struct DelayedEntryTimeout {
+    // Monotonic fire time, see TaskQueueCore::microseconds().
+    int64_t next_fire_at_us_{};
+    uint64_t order_{};
+    // Set for the entries of repeating tasks, not part of the ordering.
+    RepeatingTaskState* repeating_{nullptr};
+
+    bool operator<(const DelayedEntryTimeout& o) const {
+        return std::tie(next_fire_at_us_, order_) < std::tie(o.next_fire_at_us_, o.order_);
+    }
+};
+
+// Storage for the delayed tasks of a task queue. All times are in
+// microseconds. Entries become due once the time passed to front() reaches
+// their fire time; due entries are handed out in (fire time, order) order so
+// that two tasks due at exactly the same time run in FIFO order.
+//
+// Not thread safe, the owning task queue serializes access.
+class DelayedTaskQueue {
+public:
+    static std::unique_ptr<DelayedTaskQueue> create(DelayedQueueType type);
+
+    virtual ~DelayedTaskQueue() = default;
+
+    // Adds an entry and returns an id for erase().
+    virtual uint64_t push(const DelayedEntryTimeout& timeout, Task task) = 0;
+
+    // Removes the entry that push() returned |id| for and returns its task,
+    // or an empty Task if the entry is gone already. The caller destroys the
+    // task, which allows doing so outside of its lock.
+    virtual Task erase(const DelayedEntryTimeout& timeout, uint64_t id) = 0;
+
+    // Returns the timeout of the next entry to run if it is due at |now|,
+    // otherwise nullptr. The pointer is valid until the next call.
+    virtual const DelayedEntryTimeout* front(int64_t now) = 0;
+
+    // Removes and returns the entry last returned by front().
+    virtual Task pop() = 0;
+
+    // Earliest time at which front() may return an entry. Must not be called
+    // when the queue is empty. After front(now) returned nullptr the result is
+    // always later than |now|, but it may be earlier than the actual fire
+    // time of the next entry.
+    virtual int64_t nextFireTime() = 0;
+
+    virtual bool empty() const = 0;
+
+    virtual size_t size() const = 0;
+};
+
+// The classic backend: a std::map keyed by (fire time, order). Insertion and
+// erase() are O(log n). The node of the last popped entry is kept for the
+// next push, so that tasks which post themselves again, repeating tasks in
+// particular, do not allocate.
+class OrderedMapDelayedTaskQueue final : public DelayedTaskQueue {
+public:
+    uint64_t push(const DelayedEntryTimeout& timeout, Task task) override;
+
+    Task erase(const DelayedEntryTimeout& timeout, uint64_t id) override;
+
+    const DelayedEntryTimeout* front(int64_t now) override;
+
+    Task pop() override;
+
+    int64_t nextFireTime() override;
+
+    bool empty() const override;
+
+    size_t size() const override;
+
+private:
+    // std::priority_queue was considered but rejected due to its inability to
+    // extract the std::unique_ptr out of the queue without the presence of a
+    // hack.
+    std::map<DelayedEntryTimeout, Task> queue_;
+
+    std::map<DelayedEntryTimeout, Task>::node_type spare_;
+};
+
+}
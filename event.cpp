@@ -1,11 +1,14 @@
 #include "event.h"
 #include <optional>
 
-#ifdef _WIN32
-#include <windows.h>
-#include <sys/timeb.h>
-#else
-#include <sys/time.h>
+#if VI_EVENT_USE_FUTEX
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <thread>
 #endif
 
 namespace vi {
@@ -14,8 +17,39 @@ Event::Event() : Event(false, false) {
 
 }
 
+#if VI_EVENT_USE_FUTEX
+
+namespace {
+
+const int kMinSpins = 16;
+const int kMaxSpins = 4096;
+
+bool spinningHelps() {
+    static const bool _multiCore = std::thread::hardware_concurrency() > 1;
+    return _multiCore;
+}
+
+uint32_t* futexWord(std::atomic<uint32_t>* state) {
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bit");
+    return reinterpret_cast<uint32_t*>(state);
+}
+
+// Sleeps while |*state| equals |expected|, until woken or until the absolute
+// CLOCK_MONOTONIC time |deadline| (nullptr waits forever).
+void futexWait(std::atomic<uint32_t>* state, uint32_t expected, const timespec* deadline) {
+    syscall(SYS_futex, futexWord(state), FUTEX_WAIT_BITSET_PRIVATE, expected, deadline, nullptr, FUTEX_BITSET_MATCH_ANY);
+}
+
+void futexWake(std::atomic<uint32_t>* state, int count) {
+    syscall(SYS_futex, futexWord(state), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+}  // namespace
+
 Event::Event(bool manual_reset, bool initially_signaled)
-    : is_manual_reset_(manual_reset), event_status_(initially_signaled) {
+    : is_manual_reset_(manual_reset)
+    , state_(initially_signaled ? uint32_t(kSignaled) : 0)
+    , spin_limit_(kMinSpins) {
 
 }
 
@@ -23,72 +57,138 @@ Event::~Event() {
 }
 
 void Event::set() {
-    std::unique_lock<std::mutex>(event_mutex_);
-    event_status_ = true;
-    event_cond_.notify_all();
+    // The waiter may return and destroy the event right after the fetch_or,
+    // so only the address is used afterwards. A wake that reaches a futex
+    // reusing it is spurious, which every futex waiter tolerates.
+    const int wakeCount = is_manual_reset_ ? INT_MAX : 1;
+    const uint32_t state = state_.fetch_or(kSignaled, std::memory_order_seq_cst);
+    if (!(state & kSignaled) && state >= kWaiter) {
+        futexWake(&state_, wakeCount);
+    }
 }
 
 void Event::reset() {
-    std::unique_lock<std::mutex>(event_mutex_);
-    event_status_ = false;
+    state_.fetch_and(~kSignaled, std::memory_order_release);
 }
 
-namespace {
+bool Event::tryConsume() {
+    uint32_t state = state_.load(std::memory_order_acquire);
+    if (is_manual_reset_) {
+        return (state & kSignaled) != 0;
+    }
+    while (state & kSignaled) {
+        if (state_.compare_exchange_weak(state, state & ~kSignaled, std::memory_order_acquire, std::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Event::waitFutex(const std::chrono::steady_clock::time_point* deadline) {
+    if (tryConsume()) {
+        return true;
+    }
+
+    if (spinningHelps()) {
+        const int limit = spin_limit_.load(std::memory_order_relaxed);
+        for (int i = 0; i < limit; ++i) {
+            cpuRelax();
+            if ((state_.load(std::memory_order_relaxed) & kSignaled) && tryConsume()) {
+                spin_limit_.store(std::min(limit * 2, kMaxSpins), std::memory_order_relaxed);
+                return true;
+            }
+        }
+        spin_limit_.store(std::max(limit / 2, kMinSpins), std::memory_order_relaxed);
+    }
+
+    // steady_clock is CLOCK_MONOTONIC, which is also the clock
+    // FUTEX_WAIT_BITSET measures absolute timeouts against.
+    timespec ts{};
+    if (deadline) {
+        const auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline->time_since_epoch()).count();
+        ts.tv_sec = static_cast<time_t>(since_epoch / 1000000000);
+        ts.tv_nsec = static_cast<long>(since_epoch % 1000000000);
+    }
+
+    // The kernel only parks us while |state_| is unchanged since it was
+    // read, so a set() that races with the increment below cannot be lost.
+    state_.fetch_add(kWaiter, std::memory_order_seq_cst);
+    bool signaled = false;
+    while (true) {
+        if (tryConsume()) {
+            signaled = true;
+            break;
+        }
+        if (deadline && std::chrono::steady_clock::now() >= *deadline) {
+            break;
+        }
+        const uint32_t state = state_.load(std::memory_order_seq_cst);
+        if (!(state & kSignaled)) {
+            futexWait(&state_, state, deadline ? &ts : nullptr);
+        }
+    }
+    state_.fetch_sub(kWaiter, std::memory_order_relaxed);
 
-#ifdef _WIN32
-static void gettimeofday(struct timeval *tv, void *ignore)
-{
-    struct timeb tb;
+    return signaled;
+}
 
-    ftime(&tb);
-    tv->tv_sec = (long)tb.time;
-    tv->tv_usec = tb.millitm * 1000;
+bool Event::wait(const int give_up_after_ms, const int warn_after_ms) {
+    // There is no logging in this tree, so only the give up deadline matters.
+    (void)warn_after_ms;
+
+    if (give_up_after_ms == kForever) {
+        return waitFutex(nullptr);
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(give_up_after_ms);
+    return waitFutex(&deadline);
 }
-#endif
 
-timespec getTimespec(const int milliseconds_from_now) {
-    timespec ts;
+bool Event::waitUntil(std::chrono::steady_clock::time_point deadline) {
+    return waitFutex(&deadline);
+}
 
-    // Get the current time.
-#if USE_CLOCK_GETTIME
-    clock_gettime(CLOCK_MONOTONIC, &ts);
 #else
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    ts.tv_sec = tv.tv_sec;
-    ts.tv_nsec = tv.tv_usec * 1000;
-#endif
 
-    // Add the specified number of milliseconds to it.
-    ts.tv_sec += (milliseconds_from_now / 1000);
-    ts.tv_nsec += (milliseconds_from_now % 1000) * 1000000;
+Event::Event(bool manual_reset, bool initially_signaled)
+    : is_manual_reset_(manual_reset), event_status_(initially_signaled) {
 
-    // Normalize.
-    if (ts.tv_nsec >= 1000000000) {
-        ts.tv_sec++;
-        ts.tv_nsec -= 1000000000;
-    }
+}
 
-    return ts;
+Event::~Event() {
 }
 
-}  // namespace
+void Event::set() {
+    std::unique_lock<std::mutex> lock(event_mutex_);
+    event_status_ = true;
+    event_cond_.notify_all();
+}
+
+void Event::reset() {
+    std::unique_lock<std::mutex> lock(event_mutex_);
+    event_status_ = false;
+}
 
 bool Event::wait(const int give_up_after_ms, const int warn_after_ms) {
+    using namespace std::chrono;
+
+    // Deadlines are taken from the monotonic clock so that wall-clock jumps
+    // neither cut a wait short nor stretch it.
+    const auto now = steady_clock::now();
+
     // Instant when we'll log a warning message (because we've been waiting so
     // long it might be a bug), but not yet give up waiting. nullopt if we
     // shouldn't log a warning.
-    const std::optional<timespec> warn_ts = warn_after_ms == kForever ||
+    const std::optional<steady_clock::time_point> warn_tp = warn_after_ms == kForever ||
             (give_up_after_ms != kForever && warn_after_ms > give_up_after_ms)
             ? std::nullopt
-            : std::make_optional(getTimespec(warn_after_ms));
+            : std::make_optional(now + milliseconds(warn_after_ms));
 
     // Instant when we'll stop waiting and return an error. nullopt if we should
     // never give up.
-    const std::optional<timespec> give_up_ts =
+    const std::optional<steady_clock::time_point> give_up_tp =
             give_up_after_ms == kForever
             ? std::nullopt
-            : std::make_optional(getTimespec(give_up_after_ms));
+            : std::make_optional(now + milliseconds(give_up_after_ms));
 
     //ScopedYieldPolicy::YieldExecution();
 
@@ -96,27 +196,25 @@ bool Event::wait(const int give_up_after_ms, const int warn_after_ms) {
 
     // Wait for `event_cond_` to trigger and `event_status_` to be set, with the
     // given timeout (or without a timeout if none is given).
-    const auto wait = [&](const std::optional<timespec> timeout_ts) {
+    const auto wait = [&](const std::optional<steady_clock::time_point> timeout_tp) {
         std::cv_status status = std::cv_status::no_timeout;
         while (!event_status_ && status == std::cv_status::no_timeout) {
-            if (timeout_ts == std::nullopt) {
+            if (timeout_tp == std::nullopt) {
                 event_cond_.wait(lock);
             } else {
-                using namespace std::chrono;
-                system_clock::time_point tp{duration_cast<system_clock::duration>(seconds{timeout_ts->tv_sec} + nanoseconds{(timeout_ts->tv_nsec)})};
-                status = event_cond_.wait_until(lock, tp);
+                status = event_cond_.wait_until(lock, *timeout_tp);
             }
         }
         return status;
     };
 
     std::cv_status error;
-    if (warn_ts == std::nullopt) {
-        error = wait(give_up_ts);
+    if (warn_tp == std::nullopt) {
+        error = wait(give_up_tp);
     } else {
-        error = wait(warn_ts);
+        error = wait(warn_tp);
         if (error == std::cv_status::timeout) {
-            error = wait(give_up_ts);
+            error = wait(give_up_tp);
         }
     }
 
@@ -130,4 +228,22 @@ bool Event::wait(const int give_up_after_ms, const int warn_after_ms) {
     return (error == std::cv_status::no_timeout);
 }
 
+bool Event::waitUntil(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(event_mutex_);
+
+    while (!event_status_) {
+        if (event_cond_.wait_until(lock, deadline) == std::cv_status::timeout) {
+            break;
+        }
+    }
+
+    const bool signaled = event_status_;
+    if (signaled && !is_manual_reset_) {
+        event_status_ = false;
+    }
+    return signaled;
+}
+
+#endif
+
 }
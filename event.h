@@ -1,10 +1,37 @@
 #pragma once
 
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
 
+// On Linux the event parks on a futex, elsewhere it falls back to a mutex
+// and a condition variable.
+#if defined(__linux__)
+#define VI_EVENT_USE_FUTEX 1
+#else
+#define VI_EVENT_USE_FUTEX 0
+#endif
+
 namespace vi {
 
+// Hint to the CPU that the thread is in a spin loop.
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Auto- or manual-reset event.
+//
+// The futex implementation makes set() cheap when nobody waits: it is a
+// single atomic exchange and only enters the kernel if a waiter is parked.
+// Waiters spin briefly before parking; the spin budget adapts per event to
+// how often spinning succeeded, and spinning is skipped on single core
+// machines.
 class Event {
 public:
     static const int kForever = -1;
@@ -31,15 +58,43 @@ public:
         return wait(give_up_after_ms, give_up_after_ms == kForever ? 3000 : kForever);
     }
 
+    // Waits until the event becomes signaled or the monotonic clock reaches
+    // `deadline`, whichever comes first. Returns true if the event was
+    // signaled.
+    bool waitUntil(std::chrono::steady_clock::time_point deadline);
+
 private:
     Event(const Event&) = delete;
     Event& operator=(const Event&) = delete;
 
 private:
+    const bool is_manual_reset_;
+
+#if VI_EVENT_USE_FUTEX
+    bool waitFutex(const std::chrono::steady_clock::time_point* deadline);
+
+    // Takes the signal if set, resetting it for auto-reset events.
+    bool tryConsume();
+
+    // Bits of |state_|.
+    enum : uint32_t {
+        kSignaled = 1,
+        // Added per thread parked, or about to park, in the kernel.
+        kWaiter = 2,
+    };
+
+    // |kSignaled| plus the waiters. Also the futex word. Keeping both in one
+    // word lets set() finish with a single read-modify-write, so an event
+    // may be destroyed as soon as a wait() for it returns.
+    std::atomic<uint32_t> state_;
+
+    // Iterations to spin before parking.
+    std::atomic<int> spin_limit_;
+#else
     std::mutex event_mutex_;
     std::condition_variable event_cond_;
-    const bool is_manual_reset_;
     bool event_status_;
+#endif
 };
 
 }
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+namespace vi {
+
+// Readiness of a file descriptor, see TaskQueue::watchFd(). The values are
+// those of the matching EPOLL* flags.
+enum FdEvents : uint32_t {
+    kFdReadable = 0x001,
+    kFdWritable = 0x004,
+    // Reported whether asked for or not.
+    kFdError = 0x008,
+    kFdHangUp = 0x010,
+    // Report a readiness only when it changes instead of for as long as it
+    // lasts. The callback must then read or write until EAGAIN.
+    kFdEdgeTriggered = 1u << 31,
+};
+
+// Shared by a file descriptor watch, its handle and the queue that runs it.
+struct FdWatchState {
+    int fd_ {-1};
+
+    // Set by FdWatchHandle::stop().
+    std::atomic<bool> stopped_ {false};
+
+    // Bookkeeping of the queue, guarded by it.
+    uint64_t id_ {0};
+
+    // FdEvents of the readiness the callback runs for. Written and read on
+    // the queue only.
+    uint32_t ready_events_ {0};
+};
+
+// Stops the file descriptor watches of one task queue on behalf of
+// FdWatchHandle. Owned jointly by the queue and its handles, so that a
+// handle may outlive the queue.
+class FdWatchCanceler {
+public:
+    virtual ~FdWatchCanceler() = default;
+
+    // See FdWatchHandle::stop(), which set |state.stopped_| already.
+    virtual void stop(FdWatchState& state) = 0;
+};
+
+// Returned by watchFd() to stop watching. Cheap to copy; a default
+// constructed handle refers to no watch, which is also what queues that
+// cannot watch file descriptors return.
+class FdWatchHandle {
+public:
+    FdWatchHandle() = default;
+
+    FdWatchHandle(std::shared_ptr<FdWatchCanceler> canceler, std::shared_ptr<FdWatchState> state)
+        : canceler_(std::move(canceler))
+        , state_(std::move(state)) {
+    }
+
+    // Removes the descriptor from the queue and destroys the callback before
+    // returning, unless the callback is running right now, which includes
+    // calling stop() from the callback itself; then it is destroyed on the
+    // queue when it returns. Stop the watch before closing the descriptor.
+    // May be called from any thread.
+    void stop() {
+        if (!state_) {
+            return;
+        }
+        state_->stopped_.store(true, std::memory_order_release);
+        if (canceler_) {
+            canceler_->stop(*state_);
+        }
+    }
+
+    bool valid() const { return state_ != nullptr; }
+
+private:
+    std::shared_ptr<FdWatchCanceler> canceler_;
+
+    std::shared_ptr<FdWatchState> state_;
+};
+
+}
@@ -0,0 +1,61 @@
+#include "latency_histogram.h"
+#include <math.h>
+#include <algorithm>
+#include "bit_ops.h"
+
+namespace vi {
+
+int LatencyHistogram::bucketIndex(int64_t ns) {
+    const uint64_t value = static_cast<uint64_t>(ns);
+    if (value < static_cast<uint64_t>(kSubBuckets)) {
+        return static_cast<int>(value);
+    }
+
+    int exponent = 63 - countLeadingZeros(value);
+    if (exponent >= kMaxExponent) {
+        return kBucketCount - 1;
+    }
+    const int shift = exponent - kSubBucketBits;
+    const int sub = static_cast<int>(value >> shift) & (kSubBuckets - 1);
+    return (shift + 1) * kSubBuckets + sub;
+}
+
+int64_t LatencyHistogram::bucketUpperBound(int index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    const int shift = index / kSubBuckets - 1;
+    const int64_t lower = static_cast<int64_t>(kSubBuckets + index % kSubBuckets) << shift;
+    return lower + (int64_t(1) << shift) - 1;
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const {
+    HistogramSnapshot result;
+    result.buckets_.resize(kBucketCount);
+    for (int i = 0; i < kBucketCount; ++i) {
+        result.buckets_[i] = buckets_[i].load(std::memory_order_relaxed);
+        result.count_ += result.buckets_[i];
+    }
+    result.sum_ns_ = sum_ns_.load(std::memory_order_relaxed);
+    result.max_ns_ = max_ns_.load(std::memory_order_relaxed);
+    return result;
+}
+
+int64_t HistogramSnapshot::percentile(double quantile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(ceil(quantile * count_)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            // The last bucket is open ended.
+            return i + 1 == buckets_.size() ? max_ns_ : std::min(LatencyHistogram::bucketUpperBound(static_cast<int>(i)), max_ns_);
+        }
+    }
+    return max_ns_;
+}
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+namespace vi {
+
+// Copy of a LatencyHistogram taken by LatencyHistogram::snapshot().
+struct HistogramSnapshot {
+    // Counts per bucket, see LatencyHistogram::bucketIndex().
+    std::vector<uint64_t> buckets_;
+
+    uint64_t count_ {0};
+
+    int64_t sum_ns_ {0};
+
+    int64_t max_ns_ {0};
+
+    // Smallest bucket bound that at least |quantile| (0...1) of the recorded
+    // values do not exceed, 0 if nothing was recorded.
+    int64_t percentile(double quantile) const;
+
+    double mean() const { return count_ ? double(sum_ns_) / count_ : 0.0; }
+};
+
+// Log-linear histogram of durations in nanoseconds, in the style of
+// HdrHistogram: values below |kSubBuckets| get a bucket each, above that
+// every power of two is split into |kSubBuckets| equal buckets. A value is
+// therefore reported with an error of at most 1/kSubBuckets (12.5%), and
+// the whole range up to about an hour fits into a few hundred counters.
+//
+// record() has a single writer, which may change threads as long as the
+// hand-over is synchronized, and uses relaxed loads and stores only.
+// snapshot() may be called from any thread and may see a record() in
+// progress only partially.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 3;
+
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+
+    // Values of 2^kMaxExponent ns and more share the last bucket.
+    static constexpr int kMaxExponent = 42;
+
+    static constexpr int kBucketCount = (kMaxExponent - kSubBucketBits + 1) * kSubBuckets + 1;
+
+    LatencyHistogram() = default;
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(int64_t ns) {
+        if (ns < 0) {
+            ns = 0;
+        }
+        increment<uint64_t>(buckets_[bucketIndex(ns)], 1);
+        increment<int64_t>(sum_ns_, ns);
+        if (ns > max_ns_.load(std::memory_order_relaxed)) {
+            max_ns_.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    HistogramSnapshot snapshot() const;
+
+    static int bucketIndex(int64_t ns);
+
+    // Largest value that falls into bucket |index|.
+    static int64_t bucketUpperBound(int index);
+
+private:
+    template <typename T>
+    static void increment(std::atomic<T>& counter, T value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> buckets_[kBucketCount] = {};
+
+    std::atomic<int64_t> sum_ns_ {0};
+
+    std::atomic<int64_t> max_ns_ {0};
+};
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+namespace vi {
+
+// Source location of a post, recorded by TraceLog while tracing is on.
+// TaskQueue takes one as the last argument of every post, defaulted to
+// Location::current(), so callers get the location of their call without
+// writing anything. The default costs a few constants per call and nothing
+// is recorded while tracing is off. The strings must be static, which
+// literals and the compiler builtins are.
+class Location {
+public:
+    constexpr Location() = default;
+
+    constexpr Location(const char* function, const char* file, int line)
+        : function_(function)
+        , file_(file)
+        , line_(line) {
+    }
+
+#if defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1926)
+    // The location of the caller when used as a default argument.
+    static constexpr Location current(const char* function = __builtin_FUNCTION(), const char* file = __builtin_FILE(), int line = __builtin_LINE()) {
+        return Location(function, file, line);
+    }
+#else
+    static constexpr Location current() { return Location(); }
+#endif
+
+    const char* function() const { return function_; }
+
+    const char* file() const { return file_; }
+
+    int line() const { return line_; }
+
+private:
+    const char* function_ {nullptr};
+
+    const char* file_ {nullptr};
+
+    int line_ {0};
+};
+
+}
+
+// The location of the expression, for passing a location on explicitly.
+#define VI_FROM_HERE ::vi::Location(__func__, __FILE__, __LINE__)
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+
+namespace vi {
+
+// Unbounded multi-producer/single-consumer FIFO queue, the intrusive variant
+// of Dmitry Vyukov's MPSC queue.
+//
+// push() is wait-free and may be called concurrently from any number of
+// threads. pop() must only ever be called from a single consumer thread.
+// |Node| must be default constructible and expose a public
+// |std::atomic<Node*> next_| member. The queue never owns the nodes.
+//
+// A producer that has been preempted in the middle of push() temporarily
+// hides its node (and every node pushed after it) from the consumer; pop()
+// then reports the queue as empty. The stalled producer makes the nodes
+// visible once it resumes, so callers must signal the consumer after push()
+// returns rather than before.
+template <typename Node>
+class MpscQueue {
+public:
+    MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(Node* node) {
+        push(node, node);
+    }
+
+    // Appends the already linked chain |first| ... |last| in one step.
+    void push(Node* first, Node* last) {
+        last->next_.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head_.exchange(last, std::memory_order_acq_rel);
+        prev->next_.store(first, std::memory_order_release);
+    }
+
+    // Returns the oldest node or nullptr if no node is currently visible.
+    Node* pop() {
+        Node* tail = tail_;
+        Node* next = tail->next_.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next_.load(std::memory_order_acquire);
+        }
+
+        if (next != nullptr) {
+            tail_ = next;
+            return tail;
+        }
+
+        if (tail != head_.load(std::memory_order_acquire)) {
+            // A producer is between exchanging |head_| and linking its node.
+            return nullptr;
+        }
+
+        push(&stub_);
+
+        next = tail->next_.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    // Only meaningful on the consumer thread.
+    bool empty() const {
+        return tail_ == &stub_ && stub_.next_.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    // Producers swap themselves in here.
+    std::atomic<Node*> head_;
+
+    // Consumer-owned end of the list.
+    Node* tail_;
+
+    Node stub_;
+};
+
+}
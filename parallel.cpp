@@ -0,0 +1,113 @@
+#include "parallel.h"
+#include <algorithm>
+#include "task_queue.h"
+#include "thread_pool.h"
+
+namespace vi {
+
+namespace parallel_internal {
+
+namespace {
+
+// Chunks per participant for grain 0. More chunks balance better, fewer
+// cost less to claim.
+const size_t kChunksPerParticipant = 8;
+
+size_t chunkCount(size_t begin, size_t end, size_t grain) {
+    return end > begin ? (end - begin + grain - 1) / grain : 0;
+}
+
+// Helper of parallelFor() on a ThreadPool. Deletes itself once run.
+class PoolHelper final : public ThreadPool::Job {
+public:
+    explicit PoolHelper(std::shared_ptr<ForState> state) : state_(std::move(state)) {}
+
+    void run() override {
+        state_->work();
+        delete this;
+    }
+
+    void wake() override {}
+
+private:
+    const std::shared_ptr<ForState> state_;
+};
+
+}
+
+ForState::ForState(size_t begin, size_t end, size_t grain, RunChunk run, void* fn)
+    : begin_(begin)
+    , end_(end)
+    , grain_(grain)
+    , chunks_(chunkCount(begin, end, grain))
+    , run_(run)
+    , fn_(fn)
+    , done_(chunks_) {
+}
+
+void ForState::work() {
+    size_t ran = 0;
+    while (true) {
+        const size_t chunk = next_.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= chunks_) {
+            break;
+        }
+        const size_t begin = begin_ + chunk * grain_;
+        run_(fn_, begin, std::min(begin + grain_, end_));
+        ++ran;
+    }
+    if (ran != 0) {
+        done_.countDown(ran);
+    }
+}
+
+void ForState::join() {
+    work();
+    done_.wait();
+}
+
+size_t autoGrain(size_t count, size_t participants) {
+    return std::max<size_t>(1, count / (participants * kChunksPerParticipant));
+}
+
+void parallelFor(const std::vector<TaskQueue*>& queues, size_t begin, size_t end, size_t grain, RunChunk run, void* fn) {
+    if (end <= begin) {
+        return;
+    }
+    if (grain == 0) {
+        grain = autoGrain(end - begin, queues.size() + 1);
+    }
+    auto state = std::make_shared<ForState>(begin, end, grain, run, fn);
+    // The caller takes a chunk as well.
+    size_t helpers = state->chunks() - 1;
+    for (TaskQueue* queue : queues) {
+        if (helpers == 0) {
+            break;
+        }
+        if (queue->isCurrent()) {
+            continue;
+        }
+        queue->postTask([state]{ state->work(); });
+        --helpers;
+    }
+    state->join();
+}
+
+void parallelFor(ThreadPool* pool, size_t begin, size_t end, size_t grain, RunChunk run, void* fn) {
+    if (end <= begin) {
+        return;
+    }
+    if (grain == 0) {
+        grain = autoGrain(end - begin, pool->threads() + 1);
+    }
+    auto state = std::make_shared<ForState>(begin, end, grain, run, fn);
+    const size_t helpers = std::min(pool->threads(), state->chunks() - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        pool->schedule(new PoolHelper(state));
+    }
+    state->join();
+}
+
+}
+
+}
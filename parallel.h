@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "event.h"
+
+namespace vi {
+
+class TaskQueue;
+class ThreadPool;
+
+// Single use countdown: wait() returns once countDown() brought the count
+// to zero. Waiting costs one Event for the whole latch, however many
+// threads count down.
+class Latch {
+public:
+    explicit Latch(size_t count)
+        : count_(count)
+        , done_(/*manual_reset=*/true, /*initially_signaled=*/count == 0) {}
+
+    Latch(const Latch&) = delete;
+    Latch& operator=(const Latch&) = delete;
+
+    void countDown(size_t n = 1) {
+        if (count_.fetch_sub(n, std::memory_order_acq_rel) == n) {
+            done_.set();
+        }
+    }
+
+    bool tryWait() const { return count_.load(std::memory_order_acquire) == 0; }
+
+    void wait() { done_.wait(Event::kForever, Event::kForever); }
+
+private:
+    std::atomic<size_t> count_;
+
+    Event done_;
+};
+
+namespace parallel_internal {
+
+using RunChunk = void (*)(void* fn, size_t begin, size_t end);
+
+// State of one parallelFor() call, shared by the caller and its helpers.
+// Helpers hold it through a shared_ptr, so the caller only waits for the
+// chunks to be done, not for helpers stuck behind other tasks of their
+// queue to start; those find nothing left to claim.
+class ForState {
+public:
+    ForState(size_t begin, size_t end, size_t grain, RunChunk run, void* fn);
+
+    // Claims and runs chunks until none is left.
+    void work();
+
+    // Runs the share of the calling thread and waits for the rest.
+    void join();
+
+    size_t chunks() const { return chunks_; }
+
+private:
+    const size_t begin_;
+
+    const size_t end_;
+
+    const size_t grain_;
+
+    const size_t chunks_;
+
+    const RunChunk run_;
+
+    // Only called for claimed chunks, so it is not touched once the caller
+    // returned.
+    void* const fn_;
+
+    // Next chunk to claim.
+    std::atomic<size_t> next_ {0};
+
+    // Counts the chunks that ran.
+    Latch done_;
+};
+
+// Chunk size that gives every participant a few chunks to balance with.
+size_t autoGrain(size_t count, size_t participants);
+
+void parallelFor(const std::vector<TaskQueue*>& queues, size_t begin, size_t end, size_t grain, RunChunk run, void* fn);
+
+void parallelFor(ThreadPool* pool, size_t begin, size_t end, size_t grain, RunChunk run, void* fn);
+
+template <class Fn>
+void runChunk(void* fn, size_t begin, size_t end) {
+    Fn& function = *static_cast<Fn*>(fn);
+    if constexpr (std::is_invocable<Fn&, size_t, size_t>::value) {
+        function(begin, end);
+    }
+    else {
+        for (size_t i = begin; i < end; ++i) {
+            function(i);
+        }
+    }
+}
+
+}
+
+// Calls |fn| for every index in [begin, end) and returns when all calls
+// returned. |fn| takes either a single index or the bounds of a chunk,
+// fn(chunkBegin, chunkEnd), which saves a call per index.
+//
+// The range is cut into chunks of |grain| indices, 0 for a grain that gives
+// every participant several chunks. Chunks are handed out one at a time to
+// whoever asks next, so fast participants take over the share of slow
+// ones. The calling thread takes part, and one helper task is posted to
+// each of |queues| that is not the current queue. Helpers that start after
+// the last chunk was claimed return right away, so busy queues in the group
+// delay nothing; in the extreme the caller runs every chunk itself. That
+// also makes nested calls from tasks of |queues| safe.
+//
+// |fn| runs concurrently on several threads and must not throw.
+template <class Fn>
+void parallelFor(const std::vector<TaskQueue*>& queues, size_t begin, size_t end, size_t grain, Fn&& fn) {
+    using Function = typename std::remove_reference<Fn>::type;
+    parallel_internal::parallelFor(queues, begin, end, grain, &parallel_internal::runChunk<Function>, const_cast<void*>(static_cast<const void*>(&fn)));
+}
+
+// Like above, with helpers scheduled on the workers of |pool|, for instance
+// ThreadPool::shared().
+template <class Fn>
+void parallelFor(ThreadPool* pool, size_t begin, size_t end, size_t grain, Fn&& fn) {
+    using Function = typename std::remove_reference<Fn>::type;
+    parallel_internal::parallelFor(pool, begin, end, grain, &parallel_internal::runChunk<Function>, const_cast<void*>(static_cast<const void*>(&fn)));
+}
+
+// Runs every one of |fns| once, in parallel as far as |queues| (or a
+// ThreadPool) allow, and returns when all returned. See parallelFor().
+template <class Executor, class... Fns>
+void forkJoin(Executor&& executor, Fns&&... fns) {
+    parallelFor(std::forward<Executor>(executor), 0, sizeof...(Fns), 1, [&fns...](size_t i) {
+        size_t index = 0;
+        ((i == index++ ? (void)fns() : (void)0), ...);
+    });
+}
+
+}
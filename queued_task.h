@@ -56,4 +56,9 @@ private:
     typename std::decay<Cleanup>::type cleanup_;
 };
 
+template <typename Closure, typename Cleanup>
+std::unique_ptr<QueuedTask> ToQueuedTask(Closure&& closure, Cleanup&& cleanup) {
+    return std::make_unique<ClosureTaskWithCleanup<Closure, Cleanup>>(std::forward<Closure>(closure), std::forward<Cleanup>(cleanup));
+}
+
 }
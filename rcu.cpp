@@ -0,0 +1,98 @@
+#include "rcu.h"
+#include <assert.h>
+#include <thread>
+
+namespace vi {
+
+namespace {
+
+// Read state of one thread. Slots are never freed, a slot released by an
+// exiting thread is reused by the next thread that needs one.
+struct ReaderSlot {
+    // Grace period the current read section started in, 0 outside of one.
+    std::atomic<uint64_t> epoch_ {0};
+
+    std::atomic<bool> in_use_ {true};
+
+    // Only touched by the owning thread.
+    uint32_t nesting_ {0};
+
+    ReaderSlot* next_ {nullptr};
+};
+
+std::atomic<ReaderSlot*> _slots {nullptr};
+
+std::atomic<uint64_t> _epoch {1};
+
+ReaderSlot* acquireSlot() {
+    for (ReaderSlot* slot = _slots.load(std::memory_order_acquire); slot; slot = slot->next_) {
+        bool in_use = false;
+        if (!slot->in_use_.load(std::memory_order_relaxed) && slot->in_use_.compare_exchange_strong(in_use, true, std::memory_order_acquire)) {
+            return slot;
+        }
+    }
+
+    ReaderSlot* slot = new ReaderSlot();
+    slot->next_ = _slots.load(std::memory_order_relaxed);
+    while (!_slots.compare_exchange_weak(slot->next_, slot, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    return slot;
+}
+
+struct ThreadSlot {
+    ~ThreadSlot() {
+        if (slot_) {
+            slot_->in_use_.store(false, std::memory_order_release);
+        }
+    }
+
+    ReaderSlot* get() {
+        if (!slot_) {
+            slot_ = acquireSlot();
+        }
+        return slot_;
+    }
+
+    ReaderSlot* slot_ {nullptr};
+};
+
+thread_local ThreadSlot _threadSlot;
+
+}  // namespace
+
+void Rcu::readLock() {
+    ReaderSlot* slot = _threadSlot.get();
+    if (slot->nesting_++ == 0) {
+        slot->epoch_.store(_epoch.load(std::memory_order_seq_cst), std::memory_order_relaxed);
+        // Pairs with the fence in synchronize(): either the writer sees this
+        // section, or this section sees what the writer published.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+void Rcu::readUnlock() {
+    ReaderSlot* slot = _threadSlot.get();
+    assert(slot->nesting_ > 0);
+    if (--slot->nesting_ == 0) {
+        slot->epoch_.store(0, std::memory_order_release);
+    }
+}
+
+void Rcu::synchronize() {
+    assert(_threadSlot.get()->nesting_ == 0);
+
+    const uint64_t epoch = _epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    for (ReaderSlot* slot = _slots.load(std::memory_order_acquire); slot; slot = slot->next_) {
+        while (true) {
+            const uint64_t reader = slot->epoch_.load(std::memory_order_acquire);
+            if (reader == 0 || reader >= epoch) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+    }
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+namespace vi {
+
+// Minimal read-copy-update support for read-mostly data.
+//
+// Readers wrap their accesses into a ReadSection, which costs two stores to a
+// per-thread slot and a fence: no lock, no shared counter. A writer replaces
+// the published pointer and then calls synchronize(), which returns once
+// every read section that might still see the old data has ended, so the old
+// data can be freed.
+//
+// Read sections may nest and must be short: synchronize() spins until they
+// end. synchronize() must not be called inside a read section.
+class Rcu {
+public:
+    class ReadSection {
+    public:
+        ReadSection() { Rcu::readLock(); }
+        ~ReadSection() { Rcu::readUnlock(); }
+
+        ReadSection(const ReadSection&) = delete;
+        ReadSection& operator=(const ReadSection&) = delete;
+    };
+
+    static void readLock();
+
+    static void readUnlock();
+
+    // Waits for the end of every read section that started before the call.
+    static void synchronize();
+};
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include "delayed_task_handle.h"
+#include "delayed_task_queue.h"
+
+namespace vi {
+
+// Returned by the closure of a repeating task to stop repeating.
+constexpr std::chrono::microseconds kStopRepeating = std::chrono::microseconds::max();
+
+// Shared by a repeating task, its handle and the queue that runs it.
+struct RepeatingTaskState {
+    // Delay from one deadline to the next, set when posting and updated by
+    // closures that return their next interval. kStopRepeating.count() ends
+    // the task. Written and read on the queue only.
+    int64_t interval_us_ {0};
+
+    // Set by RepeatingTaskHandle::stop().
+    std::atomic<bool> stopped_ {false};
+
+    // Bookkeeping of the queue, guarded by it.
+    int64_t deadline_us_ {0};
+
+    // Whether the task waits in the delayed queue as entry |timeout_|/|id_|,
+    // as opposed to running right now.
+    bool queued_ {false};
+
+    DelayedEntryTimeout timeout_;
+
+    uint64_t id_ {0};
+};
+
+// Returned by postRepeatingTask() to stop the task. Cheap to copy; a default
+// constructed handle refers to no task.
+class RepeatingTaskHandle {
+public:
+    RepeatingTaskHandle() = default;
+
+    RepeatingTaskHandle(std::shared_ptr<DelayedTaskCanceler> canceler, std::shared_ptr<RepeatingTaskState> state)
+        : canceler_(std::move(canceler))
+        , state_(std::move(state)) {
+    }
+
+    // Stops the task. If it is waiting for its next deadline its closure is
+    // destroyed before returning; if it is running right now, which includes
+    // calling stop() from the closure itself, the closure is destroyed on the
+    // queue when the run ends. May be called from any thread.
+    void stop() {
+        if (!state_) {
+            return;
+        }
+        state_->stopped_.store(true, std::memory_order_release);
+        if (canceler_) {
+            canceler_->stop(*state_);
+        }
+    }
+
+    bool valid() const { return state_ != nullptr; }
+
+private:
+    std::shared_ptr<DelayedTaskCanceler> canceler_;
+
+    std::shared_ptr<RepeatingTaskState> state_;
+};
+
+}
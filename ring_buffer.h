@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace vi {
+
+// FIFO queue backed by a power-of-two circular array. Unlike std::deque it
+// keeps its storage when drained, so a queue that reached its working size
+// no longer allocates. Offers the subset of the std::queue interface used by
+// the task queues. Not thread safe.
+template <typename T>
+class RingBuffer {
+public:
+    RingBuffer() = default;
+
+    ~RingBuffer() {
+        while (!empty()) {
+            pop();
+        }
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    bool empty() const { return size_ == 0; }
+
+    size_t size() const { return size_; }
+
+    T& front() { return *slot(head_); }
+
+    const T& front() const { return *slot(head_); }
+
+    void push(T&& value) {
+        if (size_ == capacity_) {
+            grow();
+        }
+        new (slot(head_ + size_)) T(std::move(value));
+        ++size_;
+    }
+
+    void pop() {
+        slot(head_)->~T();
+        head_ = (head_ + 1) & (capacity_ - 1);
+        --size_;
+    }
+
+private:
+    T* slot(size_t index) {
+        return reinterpret_cast<T*>(storage_.get()) + (index & (capacity_ - 1));
+    }
+
+    const T* slot(size_t index) const {
+        return reinterpret_cast<const T*>(storage_.get()) + (index & (capacity_ - 1));
+    }
+
+    void grow() {
+        const size_t capacity = capacity_ ? capacity_ * 2 : 64;
+        std::unique_ptr<Storage[]> storage(new Storage[capacity]);
+        T* target = reinterpret_cast<T*>(storage.get());
+        for (size_t i = 0; i < size_; ++i) {
+            T* source = slot(head_ + i);
+            new (target + i) T(std::move(*source));
+            source->~T();
+        }
+        storage_ = std::move(storage);
+        capacity_ = capacity;
+        head_ = 0;
+    }
+
+private:
+    struct alignas(T) Storage {
+        unsigned char bytes_[sizeof(T)];
+    };
+
+    std::unique_ptr<Storage[]> storage_;
+
+    size_t capacity_ {0};
+
+    size_t head_ {0};
+
+    size_t size_ {0};
+};
+
+}
@@ -0,0 +1,105 @@
+#include "simulated_clock.h"
+#include <assert.h>
+#include <algorithm>
+#include "task_queue_simulated.h"
+
+namespace vi {
+
+SimulatedClock* SimulatedClock::shared() {
+    // Leaked on purpose, like ThreadPool::shared().
+    static SimulatedClock* clock = new SimulatedClock();
+    return clock;
+}
+
+SimulatedClock::SimulatedClock(std::chrono::microseconds start)
+    : now_us_(start.count()) {
+}
+
+SimulatedClock::~SimulatedClock() {
+    assert(queues_.empty());
+}
+
+void SimulatedClock::add(TaskQueueSimulated* queue) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queues_.push_back(queue);
+}
+
+void SimulatedClock::remove(TaskQueueSimulated* queue) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    left_.wait(lock, [this, queue]{ return running_ != queue; });
+    for (auto it = queues_.begin(); it != queues_.end(); ++it) {
+        if (*it == queue) {
+            queues_.erase(it);
+            break;
+        }
+    }
+}
+
+void SimulatedClock::runFor(std::chrono::microseconds duration) {
+    runUntil(microseconds() + std::max<int64_t>(duration.count(), 0));
+}
+
+void SimulatedClock::runUntil(int64_t us) {
+    while (true) {
+        const int64_t next = runDue();
+        if (next == 0 || next > us) {
+            break;
+        }
+        now_us_.store(next, std::memory_order_release);
+    }
+    if (us > microseconds()) {
+        now_us_.store(us, std::memory_order_release);
+    }
+}
+
+void SimulatedClock::runUntilIdle() {
+    while (const int64_t next = runDue()) {
+        now_us_.store(next, std::memory_order_release);
+    }
+}
+
+int64_t SimulatedClock::runDue() {
+    const int64_t now = microseconds();
+    while (true) {
+        bool ran = false;
+        int64_t next = 0;
+        // By index, since tasks may add and remove queues. A queue that is
+        // skipped because of that is visited on the next pass, which there
+        // is since a task ran.
+        for (size_t i = 0;; ++i) {
+            TaskQueueSimulated* queue = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (i >= queues_.size()) {
+                    break;
+                }
+                queue = queues_[i];
+                running_ = queue;
+            }
+
+            int64_t sleepUntilUs = 0;
+            const int count = queue->runTasks(now, sleepUntilUs);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                running_ = nullptr;
+            }
+            left_.notify_all();
+
+            if (count > 0) {
+                tasks_run_.fetch_add(uint64_t(count), std::memory_order_relaxed);
+                ran = true;
+            }
+            if (sleepUntilUs != 0 && (next == 0 || sleepUntilUs < next)) {
+                next = sleepUntilUs;
+            }
+        }
+        // Only a pass without tasks has seen every deadline, since a task
+        // may post to a queue that was visited before it.
+        if (!ran) {
+            return next;
+        }
+    }
+}
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace vi {
+
+class TaskQueueSimulated;
+
+// Virtual monotonic clock that kSimulated task queues measure their delays
+// on, and the loop that runs their tasks.
+//
+//   vi::SimulatedClock clock;
+//   TQMgr->setSimulatedClock(&clock);
+//   TQMgr->create({"scheduler", "billing"});
+//   TQ("scheduler")->postRepeatingTask(..., std::chrono::minutes(5));
+//   clock.runFor(std::chrono::hours(24));
+//
+// Time only moves while a run method is driving the clock. It runs the due
+// tasks of every queue on the calling thread and, once none is left, jumps
+// to the earliest deadline among the queues, so a day of timers takes only
+// as long as the tasks themselves. Queues take turns in the order they were
+// created and a queue runs its due tasks in the usual order, which makes a
+// run deterministic as long as no other thread posts into the queues.
+//
+// One thread at a time may drive a clock. Tasks may post, create and
+// delete simulated queues; deleting a queue from another thread while the
+// driver runs one of its tasks waits for the task.
+class SimulatedClock {
+public:
+    // Process wide clock for kSimulated queues created without one, never
+    // destroyed.
+    static SimulatedClock* shared();
+
+    explicit SimulatedClock(std::chrono::microseconds start = std::chrono::microseconds(0));
+
+    // Every queue of the clock must be gone.
+    ~SimulatedClock();
+
+    SimulatedClock(const SimulatedClock&) = delete;
+    SimulatedClock& operator=(const SimulatedClock&) = delete;
+
+    // Current virtual time in microseconds.
+    int64_t microseconds() const { return now_us_.load(std::memory_order_acquire); }
+
+    std::chrono::microseconds now() const { return std::chrono::microseconds(microseconds()); }
+
+    // Runs tasks up to |duration| from now, then leaves the clock there.
+    void runFor(std::chrono::microseconds duration);
+
+    // Runs tasks up to the virtual time |us|. The clock never goes back.
+    void runUntil(int64_t us);
+
+    // Runs tasks until no queue has one left, delayed ones included. Does
+    // not return while a repeating task is running; use runFor() then.
+    void runUntilIdle();
+
+    // Tasks run so far.
+    uint64_t tasksRun() const { return tasks_run_.load(std::memory_order_relaxed); }
+
+private:
+    friend class TaskQueueSimulated;
+
+    void add(TaskQueueSimulated* queue);
+
+    // Waits until the driver is not running a task of |queue|.
+    void remove(TaskQueueSimulated* queue);
+
+    // Runs every task that is due at the current time. Returns the earliest
+    // deadline of the queues, 0 if they have none.
+    int64_t runDue();
+
+private:
+    std::atomic<int64_t> now_us_;
+
+    std::atomic<uint64_t> tasks_run_ {0};
+
+    std::mutex mutex_;
+
+    // Signaled when the driver leaves a queue.
+    std::condition_variable left_;
+
+    // In creation order. Guarded by |mutex_|.
+    std::vector<TaskQueueSimulated*> queues_;
+
+    // Queue whose tasks the driver is running. Guarded by |mutex_|.
+    TaskQueueSimulated* running_ {nullptr};
+};
+
+}
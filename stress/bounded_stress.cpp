@@ -0,0 +1,262 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_queue.h"
+#include "task_queue_manager.h"
+
+namespace {
+
+const size_t kLimit = 16;
+
+vi::TaskQueueOptions bounded(vi::TaskQueueType type, vi::OverflowPolicy policy, bool lockFree) {
+    vi::TaskQueueOptions options;
+    options.type_ = type;
+    options.lock_free_submission_ = lockFree;
+    options.max_pending_tasks_ = kLimit;
+    options.overflow_policy_ = policy;
+    return options;
+}
+
+// Keeps the queue busy until open() is called, so that posts pile up.
+class Gate {
+public:
+    explicit Gate(vi::TaskQueue* queue) {
+        queue->postTask([this]{
+            entered_.set();
+            open_.wait(vi::Event::kForever);
+        });
+        entered_.wait(vi::Event::kForever);
+    }
+
+    void open() { open_.set(); }
+
+private:
+    vi::Event entered_;
+    vi::Event open_;
+};
+
+void drain(vi::TaskQueue* queue) {
+    queue->invoke([]{});
+}
+
+// For queues that are still full, where the task of drain() would compete
+// with the ones being counted.
+void waitFor(const std::atomic<int>& count, int expected) {
+    while (count.load(std::memory_order_acquire) < expected) {
+        std::this_thread::yield();
+    }
+}
+
+// Producers block while the queue is full and every task runs exactly once.
+// A task posting to its own full queue is let through instead.
+void checkBlock(vi::TaskQueueType type, bool lockFree) {
+    const int kProducers = 4;
+    const int kPosts = 5000;
+
+    auto queue = vi::TaskQueue::create("bounded_block", bounded(type, vi::OverflowPolicy::kBlock, lockFree));
+    std::atomic<int> runs(0);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&]{
+            for (int i = 0; i < kPosts; ++i) {
+                VI_EXPECT(queue->tryPostTask([&runs]{ runs.fetch_add(1, std::memory_order_relaxed); }) == vi::PostResult::kPosted);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    drain(queue.get());
+    VI_EXPECT(runs.load() == kProducers * kPosts);
+
+    auto stats = queue->stats();
+    VI_EXPECT(stats.max_pending_ <= kLimit);
+    VI_EXPECT(stats.pending_ == 0 && stats.pending_bytes_ == 0);
+
+    runs = 0;
+    queue->invoke([&]{
+        for (size_t i = 0; i < kLimit * 2; ++i) {
+            queue->postTask([&runs]{ runs.fetch_add(1, std::memory_order_relaxed); });
+        }
+    });
+    drain(queue.get());
+    VI_EXPECT(runs.load() == int(kLimit * 2));
+}
+
+// kFail and kDropNewest turn the new task away and run its cleanup.
+void checkRejectNewest(vi::TaskQueueType type, vi::OverflowPolicy policy, bool lockFree) {
+    auto queue = vi::TaskQueue::create("bounded_reject", bounded(type, policy, lockFree));
+    std::atomic<int> runs(0);
+    std::atomic<int> cleanups(0);
+    Gate gate(queue.get());
+    for (size_t i = 0; i < kLimit; ++i) {
+        VI_EXPECT(queue->tryPostTask([&runs]{ ++runs; }) == vi::PostResult::kPosted);
+    }
+    const auto expected = policy == vi::OverflowPolicy::kFail ? vi::PostResult::kRejected : vi::PostResult::kDropped;
+    for (int i = 0; i < 10; ++i) {
+        VI_EXPECT(queue->tryPostTask(vi::ToQueuedTask([&runs]{ ++runs; }, [&cleanups]{ ++cleanups; })) == expected);
+    }
+    // postTask() applies the policy as well.
+    auto token = std::make_shared<int>(0);
+    std::weak_ptr<int> watch = token;
+    queue->postTask([token = std::move(token)]{});
+    VI_EXPECT(watch.expired());
+    VI_EXPECT(cleanups.load() == 10);
+
+    gate.open();
+    waitFor(runs, kLimit);
+    drain(queue.get());
+    VI_EXPECT(runs.load() == int(kLimit));
+    auto stats = queue->stats();
+    VI_EXPECT(stats.rejected_ == 11);
+    VI_EXPECT(stats.dropped_ == 0);
+}
+
+// kDropOldest keeps the newest tasks, drops from the lowest lane first and
+// never drops a task of higher priority than the new one.
+void checkDropOldest(vi::TaskQueueType type, bool lockFree) {
+    auto queue = vi::TaskQueue::create("bounded_drop", bounded(type, vi::OverflowPolicy::kDropOldest, lockFree));
+    std::vector<int> ran;
+    std::atomic<int> runs(0);
+    std::atomic<int> cleanups(0);
+    Gate gate(queue.get());
+    for (int i = 0; i < int(kLimit) + 10; ++i) {
+        VI_EXPECT(queue->tryPostTask(vi::ToQueuedTask([&ran, &runs, i]{
+            ran.push_back(i);
+            ++runs;
+        }, [&cleanups]{ ++cleanups; })) == vi::PostResult::kPosted);
+    }
+    // Run or not, every task was destroyed once.
+    VI_EXPECT(cleanups.load() == 10);
+    gate.open();
+    waitFor(runs, kLimit);
+    drain(queue.get());
+    VI_EXPECT(ran.size() == kLimit);
+    for (size_t i = 0; i < ran.size(); ++i) {
+        VI_EXPECT(ran[i] == int(i) + 10);
+    }
+    VI_EXPECT(queue->stats().dropped_ == 10);
+
+    ran.clear();
+    runs = 0;
+    Gate second(queue.get());
+    for (int i = 0; i < int(kLimit) - 1; ++i) {
+        queue->postTask([&ran, &runs]{ ran.push_back(1); ++runs; }, vi::TaskPriority::kHigh);
+    }
+    queue->postTask([&ran, &runs]{ ran.push_back(3); ++runs; }, vi::TaskPriority::kLow);
+    // Takes the place of the low priority task. Another low priority task
+    // finds nothing it may push out.
+    VI_EXPECT(queue->tryPostTask([&ran, &runs]{ ran.push_back(2); ++runs; }) == vi::PostResult::kPosted);
+    VI_EXPECT(queue->tryPostTask([&ran, &runs]{ ran.push_back(3); ++runs; }, vi::TaskPriority::kLow) == vi::PostResult::kDropped);
+    second.open();
+    waitFor(runs, kLimit);
+    drain(queue.get());
+    VI_EXPECT(ran.size() == kLimit);
+    VI_EXPECT(ran.back() == 2);
+}
+
+// The byte limit counts closures stored outside of the Task.
+void checkBytes(vi::TaskQueueType type) {
+    vi::TaskQueueOptions options;
+    options.type_ = type;
+    options.max_pending_bytes_ = 16 * 1024;
+    options.overflow_policy_ = vi::OverflowPolicy::kFail;
+    auto queue = vi::TaskQueue::create("bounded_bytes", options);
+    Gate gate(queue.get());
+    std::array<char, 1024> payload{};
+    int accepted = 0;
+    while (queue->tryPostTask([payload]{ (void)payload; }) == vi::PostResult::kPosted) {
+        ++accepted;
+    }
+    VI_EXPECT(accepted > 0 && accepted < 16);
+    VI_EXPECT(queue->stats().pending_bytes_ <= options.max_pending_bytes_);
+    // Small tasks still fit where a big one did not.
+    std::atomic<int> runs(0);
+    VI_EXPECT(queue->tryPostTask([&runs]{ ++runs; }) == vi::PostResult::kPosted);
+    gate.open();
+    waitFor(runs, 1);
+    drain(queue.get());
+    VI_EXPECT(queue->stats().pending_bytes_ == 0);
+}
+
+// Posts through TaskQueueManager that wait for room, or destroy the task
+// they turn away, run outside of the manager's read section: the task a
+// blocked producer waits for and the destructor of a dropped closure may
+// intern names, create and destroy queues. A destroy() that races with a
+// blocked producer waits for its post.
+void checkManager() {
+    auto options = bounded(vi::TaskQueueType::kDedicatedThread, vi::OverflowPolicy::kBlock, false);
+    options.max_pending_tasks_ = 1;
+    TQMgr->create({"bounded_manager"}, options);
+    auto handle = TQMgr->handle("bounded_manager");
+    std::atomic<int> runs(0);
+    {
+        Gate gate(TQMgr->queue(handle));
+        VI_EXPECT(TQMgr->postTask(handle, [&runs]{
+            TQMgr->handle("bounded_manager_fresh");
+            TQMgr->create({"bounded_manager_scratch"});
+            TQMgr->destroy({"bounded_manager_scratch"});
+            ++runs;
+        }));
+        std::thread producer([&]{
+            VI_EXPECT(TQMgr->postTask(handle, [&runs]{ ++runs; }));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        gate.open();
+        producer.join();
+    }
+    drain(TQMgr->queue(handle));
+    VI_EXPECT(runs.load() == 2);
+
+    {
+        Gate gate(TQMgr->queue(handle));
+        VI_EXPECT(TQMgr->postTask(handle, []{}));
+        std::thread producer([&]{
+            VI_EXPECT(TQMgr->postTask(handle, []{}));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::thread destroyer([]{ TQMgr->destroy({"bounded_manager"}); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        gate.open();
+        producer.join();
+        destroyer.join();
+    }
+    VI_EXPECT(!TQMgr->queue(handle));
+
+    options.overflow_policy_ = vi::OverflowPolicy::kDropNewest;
+    TQMgr->create({"bounded_manager"}, options);
+    std::atomic<int> cleanups(0);
+    {
+        Gate gate(TQMgr->queue(handle));
+        VI_EXPECT(TQMgr->postTask(handle, []{}));
+        VI_EXPECT(TQMgr->postTask(handle, [token = std::shared_ptr<int>(new int(0), [&cleanups](int* value) {
+            delete value;
+            TQMgr->create({"bounded_manager_scratch"});
+            TQMgr->destroy({"bounded_manager_scratch"});
+            ++cleanups;
+        })]{}));
+        VI_EXPECT(cleanups.load() == 1);
+        gate.open();
+    }
+    TQMgr->destroy({"bounded_manager"});
+}
+
+}
+
+VI_STRESS(bounded_queue) {
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        for (bool lockFree : {false, true}) {
+            checkBlock(type, lockFree);
+            checkRejectNewest(type, vi::OverflowPolicy::kFail, lockFree);
+            checkRejectNewest(type, vi::OverflowPolicy::kDropNewest, lockFree);
+            checkDropOldest(type, lockFree);
+        }
+        checkBytes(type);
+    }
+    checkManager();
+}
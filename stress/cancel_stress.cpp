@@ -0,0 +1,129 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kCancelers = 3;
+
+const int kTimeoutsPerCanceler = 5000;
+
+// Timeouts race with their cancellation from other threads: each one either
+// runs or is cancelled, never both, and a successful cancel() has destroyed
+// the closure by the time it returns.
+void checkCancelRace(const vi::TaskQueueOptions& options) {
+    auto queue = vi::TaskQueue::create("cancel", options);
+
+    std::atomic<int> ran(0);
+    std::atomic<int> cancelled(0);
+    std::vector<std::thread> cancelers;
+    for (int c = 0; c < kCancelers; ++c) {
+        cancelers.emplace_back([&, c]{
+            for (int i = 0; i < kTimeoutsPerCanceler; ++i) {
+                auto alive = std::make_shared<int>(0);
+                std::weak_ptr<int> watch = alive;
+                auto handle = queue->postDelayedTask([&ran, alive]{
+                    ran.fetch_add(1, std::memory_order_relaxed);
+                }, std::chrono::microseconds((i * 7 + c) % 300));
+                alive.reset();
+                if (i % 3 != 0) {
+                    std::this_thread::yield();
+                }
+                if (handle.cancel()) {
+                    VI_EXPECT(watch.expired());
+                    VI_EXPECT(!handle.cancel());
+                    cancelled.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+    for (auto& canceler : cancelers) {
+        canceler.join();
+    }
+
+    vi::Event done;
+    queue->postDelayedTask([&done]{ done.set(); }, 5);
+    done.wait(vi::Event::kForever);
+
+    VI_EXPECT(ran.load() + cancelled.load() == kCancelers * kTimeoutsPerCanceler);
+    auto stats = queue->stats();
+    VI_EXPECT(stats.cancelled_ == static_cast<uint64_t>(cancelled.load()));
+    VI_EXPECT(stats.delayed_ == 0);
+}
+
+// Tasks cancel timeouts of their own queue, including ones whose closures
+// cancel further timeouts when destroyed, and handles outlive the queue.
+void checkCancelFromQueue(const vi::TaskQueueOptions& options) {
+    auto queue = vi::TaskQueue::create("cancel_self", options);
+
+    struct CancelOnDestroy {
+        vi::DelayedTaskHandle next_;
+        ~CancelOnDestroy() { next_.cancel(); }
+    };
+
+    std::vector<vi::DelayedTaskHandle> handles;
+    vi::Event done;
+    queue->postTask([&]{
+        vi::DelayedTaskHandle next;
+        for (int i = 0; i < 100; ++i) {
+            auto chain = std::make_shared<CancelOnDestroy>();
+            chain->next_ = next;
+            next = queue->postDelayedTask([chain]{ VI_EXPECT(false); }, 10000);
+        }
+        // Cancelling the last one cascades through the whole chain.
+        VI_EXPECT(next.cancel());
+        VI_EXPECT(queue->stats().cancelled_ == 100);
+        for (int i = 0; i < 100; ++i) {
+            handles.push_back(queue->postDelayedTask([]{ VI_EXPECT(false); }, 10000));
+        }
+        done.set();
+    });
+    done.wait(vi::Event::kForever);
+
+    queue.reset();
+    for (auto& handle : handles) {
+        VI_EXPECT(!handle.cancel());
+    }
+}
+
+// Delayed QueuedTasks return a handle as well. Cancelling destroys the
+// task, which runs its cleanup, and it never runs.
+void checkCancelQueuedTask(const vi::TaskQueueOptions& options) {
+    auto queue = vi::TaskQueue::create("cancel_queued", options);
+    std::atomic<int> ran(0);
+    std::atomic<int> cleanups(0);
+    auto millis = queue->postDelayedTask(vi::ToQueuedTask([&ran]{ ++ran; }, [&cleanups]{ ++cleanups; }), 60000);
+    auto micros = queue->postDelayedTask(vi::ToQueuedTask([&ran]{ ++ran; }, [&cleanups]{ ++cleanups; }), std::chrono::seconds(60));
+    VI_EXPECT(millis.cancel());
+    VI_EXPECT(micros.cancel());
+    VI_EXPECT(cleanups.load() == 2);
+    VI_EXPECT(!millis.cancel());
+
+    auto fired = queue->postDelayedTask(vi::ToQueuedTask([&ran]{ ++ran; }), std::chrono::microseconds(10));
+    while (ran.load() == 0) {
+        std::this_thread::yield();
+    }
+    VI_EXPECT(!fired.cancel());
+    queue->invoke([]{});
+    VI_EXPECT(ran.load() == 1);
+}
+
+}
+
+VI_STRESS(delayed_cancel) {
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        for (auto delayedType : {vi::DelayedQueueType::kOrderedMap, vi::DelayedQueueType::kTimingWheel}) {
+            vi::TaskQueueOptions options;
+            options.type_ = type;
+            options.delayed_queue_type_ = delayedType;
+            checkCancelRace(options);
+            checkCancelFromQueue(options);
+            checkCancelQueuedTask(options);
+        }
+    }
+}
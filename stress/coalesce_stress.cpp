@@ -0,0 +1,178 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kKeys = 8;
+
+// Keeps the queue busy until open() is called, so that posts pile up.
+class Gate {
+public:
+    explicit Gate(vi::TaskQueue* queue) {
+        queue->postTask([this]{
+            entered_.set();
+            open_.wait(vi::Event::kForever);
+        });
+        entered_.wait(vi::Event::kForever);
+    }
+
+    void open() { open_.set(); }
+
+private:
+    vi::Event entered_;
+    vi::Event open_;
+};
+
+// Concurrent posts for a few keys to a busy queue run once per key, and
+// every replaced closure is destroyed.
+void checkPending(const vi::TaskQueueOptions& options) {
+    const int kThreads = 4;
+    const int kPosts = 2000;
+
+    auto queue = vi::TaskQueue::create("coalesce_pending", options);
+    std::array<std::atomic<int>, kKeys> runs{};
+    auto token = std::make_shared<int>(0);
+    std::weak_ptr<int> watch = token;
+    {
+        Gate gate(queue.get());
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&, t]{
+                for (int i = 0; i < kPosts; ++i) {
+                    const int key = (i + t) % kKeys;
+                    queue->postCoalescedTask(key, [&runs, key, token]{ ++runs[key]; });
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        gate.open();
+        queue->invoke([]{});
+    }
+    for (auto& count : runs) {
+        VI_EXPECT(count.load() == 1);
+    }
+    token.reset();
+    VI_EXPECT(watch.expired());
+    auto stats = queue->stats();
+    VI_EXPECT(stats.coalesced_ == uint64_t(kThreads * kPosts - kKeys));
+    VI_EXPECT(stats.pending_ == 0);
+}
+
+// While the queue keeps up, a key runs again after it started and the last
+// post always runs.
+void checkRunning(const vi::TaskQueueOptions& options) {
+    const int kPosts = 20000;
+
+    auto queue = vi::TaskQueue::create("coalesce_running", options);
+    int last = -1;
+    int runs = 0;
+    for (int i = 0; i < kPosts; ++i) {
+        queue->postCoalescedTask(1, [&last, &runs, i]{
+            VI_EXPECT(i > last);
+            last = i;
+            ++runs;
+        });
+    }
+    queue->invoke([&]{
+        VI_EXPECT(last == kPosts - 1);
+        VI_EXPECT(runs >= 1 && runs <= kPosts);
+    });
+}
+
+// A debounced key runs once, no earlier than the delay after its last post,
+// with the last closure.
+void checkDebounce(const vi::TaskQueueOptions& options) {
+    const auto kDelay = std::chrono::milliseconds(20);
+
+    auto queue = vi::TaskQueue::create("debounce", options);
+    std::atomic<int> runs(0);
+    std::atomic<int> value(-1);
+    std::chrono::steady_clock::time_point lastPost;
+    std::chrono::steady_clock::time_point ranAt;
+    vi::Event done;
+    for (int i = 0; i < 50; ++i) {
+        lastPost = std::chrono::steady_clock::now();
+        queue->postDebouncedTask(7, [&, i]{
+            ranAt = std::chrono::steady_clock::now();
+            value = i;
+            ++runs;
+            done.set();
+        }, kDelay);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    done.wait(vi::Event::kForever);
+    queue->invoke([]{});
+    VI_EXPECT(runs.load() == 1);
+    VI_EXPECT(value.load() == 49);
+    // The core clock truncates to microseconds.
+    VI_EXPECT(ranAt - lastPost >= kDelay - std::chrono::microseconds(1));
+}
+
+// A coalesced post that a full queue turns away leaves no entry behind, and
+// replacing a pending entry takes no room.
+void checkBounded(const vi::TaskQueueOptions& base) {
+    auto options = base;
+    options.max_pending_tasks_ = 4;
+    options.overflow_policy_ = vi::OverflowPolicy::kFail;
+    auto queue = vi::TaskQueue::create("coalesce_bounded", options);
+    std::atomic<int> runs(0);
+    {
+        Gate gate(queue.get());
+        VI_EXPECT(queue->postCoalescedTask(1, [&runs]{ ++runs; }) == vi::PostResult::kPosted);
+        for (int i = 0; i < 3; ++i) {
+            VI_EXPECT(queue->tryPostTask([]{}) == vi::PostResult::kPosted);
+        }
+        VI_EXPECT(queue->postCoalescedTask(1, [&runs]{ ++runs; }) == vi::PostResult::kReplaced);
+        VI_EXPECT(queue->postCoalescedTask(2, [&runs]{ ++runs; }) == vi::PostResult::kRejected);
+        gate.open();
+        while (queue->stats().pending_ != 0) {
+            std::this_thread::yield();
+        }
+    }
+    VI_EXPECT(queue->postCoalescedTask(2, [&runs]{ ++runs; }) == vi::PostResult::kPosted);
+    queue->invoke([]{});
+    VI_EXPECT(runs.load() == 2);
+}
+
+// Deleting a queue destroys the closures of pending and debounced keys.
+void checkDelete(const vi::TaskQueueOptions& options) {
+    auto token = std::make_shared<int>(0);
+    std::weak_ptr<int> watch = token;
+    {
+        auto queue = vi::TaskQueue::create("coalesce_delete", options);
+        Gate gate(queue.get());
+        for (int i = 0; i < 100; ++i) {
+            queue->postCoalescedTask(i % 3, [token]{});
+            queue->postDebouncedTask(10 + i % 3, [token]{}, std::chrono::seconds(10));
+        }
+        token.reset();
+        gate.open();
+    }
+    VI_EXPECT(watch.expired());
+}
+
+}
+
+VI_STRESS(coalesced_tasks) {
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        for (bool lockFree : {false, true}) {
+            vi::TaskQueueOptions options;
+            options.type_ = type;
+            options.lock_free_submission_ = lockFree;
+            checkPending(options);
+            checkRunning(options);
+            checkDebounce(options);
+            checkBounded(options);
+            checkDelete(options);
+        }
+    }
+}
@@ -0,0 +1,159 @@
+#include "task_queue_coroutine.h"
+
+#if VI_TASK_QUEUE_COROUTINES
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_queue.h"
+#include "task_queue_base.h"
+#include "task_queue_manager.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+vi::CoTask<int> square(vi::TaskQueue* queue, int value) {
+    co_await vi::resumeOn(queue);
+    VI_EXPECT(queue->isCurrent());
+    co_return value * value;
+}
+
+vi::CoTask<> fail(vi::TaskQueue* queue) {
+    co_await vi::resumeOn(queue);
+    throw std::runtime_error("fail");
+}
+
+// Hops between the queues, sleeps, awaits nested tasks and catches what
+// they throw, checking after every step where it runs.
+vi::CoTask<> pipeline(vi::TaskQueue* queues[3], int index, std::atomic<int>* finished, vi::Event* done, int total) {
+    int sum = 0;
+    for (int round = 0; round < 20; ++round) {
+        vi::TaskQueue* queue = queues[(index + round) % 3];
+        co_await vi::resumeOn(queue);
+        VI_EXPECT(queue->isCurrent());
+        if (round % 5 == 0) {
+            const auto before = Clock::now();
+            co_await vi::sleepFor(std::chrono::microseconds(200));
+            VI_EXPECT(queue->isCurrent());
+            // Fire times are kept in whole microseconds.
+            VI_EXPECT(Clock::now() - before >= std::chrono::microseconds(199));
+        }
+        sum += co_await square(queues[(index + round + 1) % 3], round);
+        VI_EXPECT(queues[(index + round + 1) % 3]->isCurrent());
+    }
+    VI_EXPECT(sum == 2470);
+
+    bool caught = false;
+    try {
+        co_await fail(queues[index % 3]);
+    }
+    catch (const std::runtime_error&) {
+        caught = true;
+    }
+    VI_EXPECT(caught);
+
+    if (finished->fetch_add(1) + 1 == total) {
+        done->set();
+    }
+}
+
+void checkPipelines(const vi::TaskQueueOptions& options) {
+    const int kCoroutines = 200;
+
+    auto first = vi::TaskQueue::create("coroutine_1", options);
+    auto second = vi::TaskQueue::create("coroutine_2", options);
+    auto third = vi::TaskQueue::create("coroutine_3", options);
+    vi::TaskQueue* queues[3] = {first.get(), second.get(), third.get()};
+
+    std::atomic<int> finished(0);
+    vi::Event done;
+    for (int i = 0; i < kCoroutines; ++i) {
+        pipeline(queues, i, &finished, &done, kCoroutines).start();
+    }
+    done.wait(vi::Event::kForever);
+    VI_EXPECT(finished.load() == kCoroutines);
+}
+
+vi::CoTask<> named(vi::TaskQueueManager::Handle handle, bool* onQueue, bool* missing, vi::Event* done) {
+    *onQueue = co_await vi::resumeOn(handle);
+    *onQueue = *onQueue && TQMgr->queue(handle)->isCurrent();
+    *missing = !co_await vi::resumeOn(TQMgr->handle("coroutine_missing"));
+    done->set();
+}
+
+// Named queues are resolved when awaited, and awaiting a missing one leaves
+// the coroutine where it is.
+void checkNamedQueues() {
+    auto handle = TQMgr->handle("coroutine_named");
+    TQMgr->create({"coroutine_named"});
+
+    bool onQueue = false;
+    bool missing = false;
+    vi::Event done;
+    named(handle, &onQueue, &missing, &done).start();
+    done.wait(vi::Event::kForever);
+    VI_EXPECT(onQueue);
+    VI_EXPECT(missing);
+
+    TQMgr->destroy({"coroutine_named"});
+}
+
+vi::CoTask<> turnedAway(vi::TaskQueue* queue, vi::TaskQueueManager::Handle handle, int* switched, std::thread::id* thread) {
+    *switched += co_await vi::resumeOn(queue);
+    *switched += co_await vi::resumeOn(handle);
+    *thread = std::this_thread::get_id();
+}
+
+// A full queue that turns the switch away makes co_await yield false and
+// the coroutine go on where it is, instead of leaving it suspended.
+void checkTurnedAway() {
+    for (auto policy : {vi::OverflowPolicy::kFail, vi::OverflowPolicy::kDropNewest, vi::OverflowPolicy::kDropOldest}) {
+        vi::TaskQueueOptions options;
+        options.max_pending_tasks_ = 1;
+        options.overflow_policy_ = policy;
+        TQMgr->create({"coroutine_full"}, options);
+        auto handle = TQMgr->handle("coroutine_full");
+        vi::TaskQueue* queue = TQMgr->queue(handle);
+
+        vi::Event entered;
+        vi::Event open;
+        queue->postTask([&]{
+            entered.set();
+            open.wait(vi::Event::kForever);
+        });
+        entered.wait(vi::Event::kForever);
+        // A kHigh task that kDropOldest cannot push out for a kNormal one.
+        queue->postTask([]{}, vi::TaskPriority::kHigh);
+
+        int switched = 0;
+        std::thread::id thread;
+        turnedAway(queue, handle, &switched, &thread).start();
+        VI_EXPECT(switched == 0);
+        VI_EXPECT(thread == std::this_thread::get_id());
+
+        open.set();
+        queue->invoke([]{});
+        TQMgr->destroy({"coroutine_full"});
+    }
+}
+
+}
+
+VI_STRESS(coroutine_hops) {
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        vi::TaskQueueOptions options;
+        options.type_ = type;
+        checkPipelines(options);
+    }
+    checkNamedQueues();
+    checkTurnedAway();
+}
+
+#endif
@@ -0,0 +1,149 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_queue_manager.h"
+#include "thread_pool.h"
+
+namespace {
+
+vi::ThreadPoolScaling scaling() {
+    vi::ThreadPoolScaling scaling;
+    scaling.min_threads_ = 1;
+    scaling.max_threads_ = 6;
+    scaling.backlog_threshold_ = 2;
+    scaling.delay_threshold_ = std::chrono::microseconds(500);
+    scaling.check_interval_ = std::chrono::microseconds(500);
+    scaling.idle_timeout_ = std::chrono::milliseconds(30);
+    return scaling;
+}
+
+// Waits up to two seconds for the pool to shrink back to its minimum.
+bool waitForMinimum(const vi::ThreadPool& pool) {
+    for (int i = 0; i < 2000; ++i) {
+        if (pool.threads() == pool.stats().min_threads_) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+// Bursts of slow tasks into pooled queues make the pool grow, the pauses
+// between them make it shrink again, so slots get new threads over and
+// over. Tasks of one queue never overlap and run in the order posted.
+void checkBursts() {
+    const int kQueues = 4;
+    const int kProducers = 2;
+    const int kPosts = 150;
+    const int kBursts = 3;
+
+    vi::ThreadPool pool(scaling());
+    vi::TaskQueueOptions options;
+    options.type_ = vi::TaskQueueType::kPooled;
+    options.thread_pool_ = &pool;
+    std::vector<std::string> names;
+    for (int q = 0; q < kQueues; ++q) {
+        names.push_back("elastic_" + std::to_string(q));
+    }
+    TQMgr->create(names, options);
+
+    struct Sequence {
+        std::atomic<bool> running {false};
+        int last[kProducers];
+    };
+    std::vector<Sequence> sequences(kQueues);
+
+    uint64_t grown = 0;
+    for (int burst = 0; burst < kBursts; ++burst) {
+        for (auto& sequence : sequences) {
+            for (int& last : sequence.last) {
+                last = -1;
+            }
+        }
+        std::atomic<int> remaining(kQueues * kProducers * kPosts);
+        vi::Event done;
+        std::vector<std::thread> producers;
+        for (int p = 0; p < kProducers; ++p) {
+            producers.emplace_back([&, p]{
+                for (int i = 0; i < kPosts; ++i) {
+                    for (int q = 0; q < kQueues; ++q) {
+                        TQ(names[q])->postTask([&, p, q, i]{
+                            Sequence& sequence = sequences[q];
+                            VI_EXPECT(!sequence.running.exchange(true));
+                            VI_EXPECT(sequence.last[p] == i - 1);
+                            sequence.last[p] = i;
+                            std::this_thread::sleep_for(std::chrono::microseconds(50));
+                            sequence.running.store(false);
+                            if (remaining.fetch_sub(1) == 1) {
+                                done.set();
+                            }
+                        });
+                    }
+                }
+            });
+        }
+        for (auto& producer : producers) {
+            producer.join();
+        }
+        done.wait(vi::Event::kForever);
+
+        const vi::ThreadPoolStats stats = pool.stats();
+        VI_EXPECT(stats.grown_ > grown);
+        VI_EXPECT(stats.peak_threads_ > 1 && stats.peak_threads_ <= stats.max_threads_);
+        VI_EXPECT(stats.last_scaled_at_us_ > 0);
+        grown = stats.grown_;
+
+        VI_EXPECT(waitForMinimum(pool));
+        const vi::ThreadPoolStats idle = pool.stats();
+        VI_EXPECT(idle.threads_ == 1);
+        VI_EXPECT(idle.backlog_ == 0);
+        VI_EXPECT(idle.shrunk_ == idle.grown_);
+    }
+
+    TQMgr->destroy(names);
+}
+
+// A fixed pool never scales, and an elastic one created with equal bounds
+// is a fixed one.
+void checkFixed() {
+    vi::ThreadPool fixed(2);
+    vi::ThreadPoolScaling bounds = scaling();
+    bounds.max_threads_ = bounds.min_threads_ = 3;
+    vi::ThreadPool flat(bounds);
+
+    std::atomic<int> remaining(400);
+    vi::Event done;
+    struct Job : vi::ThreadPool::Job {
+        void run() override {
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+            if (remaining_->fetch_sub(1) == 1) {
+                done_->set();
+            }
+        }
+        void wake() override {}
+        std::atomic<int>* remaining_;
+        vi::Event* done_;
+    };
+    std::vector<Job> jobs(400);
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        jobs[i].remaining_ = &remaining;
+        jobs[i].done_ = &done;
+        (i % 2 ? fixed : flat).schedule(&jobs[i]);
+    }
+    done.wait(vi::Event::kForever);
+
+    VI_EXPECT(fixed.threads() == 2 && fixed.stats().grown_ == 0);
+    VI_EXPECT(flat.threads() == 3 && flat.stats().grown_ == 0);
+    VI_EXPECT(fixed.stats().oldest_wait_us_ == 0);
+}
+
+}
+
+VI_STRESS(elastic_pool) {
+    checkBursts();
+    checkFixed();
+}
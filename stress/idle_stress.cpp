@@ -0,0 +1,109 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_queue.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+vi::TaskQueueOptions idleOptions(vi::IdlePolicy policy) {
+    vi::TaskQueueOptions options;
+    options.idle_policy_ = policy;
+    options.idle_spin_budget_ = std::chrono::microseconds(20);
+    return options;
+}
+
+// Producers that pause between posts keep sending the queue idle, so posts
+// race with it starting to poll, running out of budget and parking. Every
+// task runs, in order per producer, and delayed tasks never early.
+void checkPosts(vi::IdlePolicy policy) {
+    const int kProducers = 3;
+    const int kPosts = 3000;
+
+    auto queue = vi::TaskQueue::create("idle_posts", idleOptions(policy));
+    std::vector<int> last(kProducers, -1);
+    std::atomic<int> remaining(kProducers * (kPosts + kPosts / 50));
+    vi::Event done;
+    auto count = [&remaining, &done]{
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            done.set();
+        }
+    };
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p]{
+            for (int i = 0; i < kPosts; ++i) {
+                queue->postTask([&, p, i]{
+                    VI_EXPECT(last[p] < i);
+                    last[p] = i;
+                    count();
+                });
+                if (i % 50 == 0) {
+                    const auto delay = std::chrono::microseconds(i % 400);
+                    const auto earliest = Clock::now() + delay;
+                    queue->postDelayedTask([&count, earliest]{
+                        // The queue truncates its clock to microseconds.
+                        VI_EXPECT(Clock::now() >= earliest - std::chrono::microseconds(1));
+                        count();
+                    }, delay);
+                }
+                if (i % 7 == 0) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(i % 60));
+                }
+                else if (i % 3 == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    done.wait(vi::Event::kForever);
+
+    const vi::TaskQueueStats stats = queue->stats();
+    VI_EXPECT(stats.spin_us_ <= stats.idle_us_);
+    if (policy == vi::IdlePolicy::kBlock) {
+        VI_EXPECT(stats.spin_us_ == 0);
+        VI_EXPECT(stats.spin_hits_ == 0);
+    }
+    if (policy == vi::IdlePolicy::kBusyPoll) {
+        VI_EXPECT(stats.wakeups_ == 0);
+    }
+}
+
+// A queue that is idle for much longer than its budget parks, and only
+// then counts wakeups; a polling queue comes to an end when deleted.
+void checkParking() {
+    {
+        auto queue = vi::TaskQueue::create("idle_parking", idleOptions(vi::IdlePolicy::kSpinThenPark));
+        for (int i = 0; i < 20; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            queue->invoke([]{});
+        }
+        const vi::TaskQueueStats stats = queue->stats();
+        VI_EXPECT(stats.wakeups_ > 0);
+        VI_EXPECT(stats.spin_us_ > 0);
+        VI_EXPECT(stats.idle_us_ >= 10000);
+    }
+    for (int i = 0; i < 20; ++i) {
+        auto queue = vi::TaskQueue::create("idle_delete", idleOptions(vi::IdlePolicy::kBusyPoll));
+        if (i % 2 == 0) {
+            queue->postDelayedTask([]{}, std::chrono::microseconds(i * 10));
+        }
+    }
+}
+
+}
+
+VI_STRESS(idle_policy) {
+    for (auto policy : {vi::IdlePolicy::kBlock, vi::IdlePolicy::kSpinThenPark, vi::IdlePolicy::kBusyPoll}) {
+        checkPosts(policy);
+    }
+    checkParking();
+}
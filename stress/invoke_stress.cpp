@@ -0,0 +1,88 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_queue.h"
+#include "task_queue_base.h"
+
+namespace {
+
+// Threads invoke on a queue concurrently with posts from the queue itself,
+// and tasks of the queue invoke on it directly.
+void checkInvoke(const vi::TaskQueueOptions& options) {
+    const int kThreads = 4;
+    const int kCalls = 2000;
+
+    auto queue = vi::TaskQueue::create("invoke", options);
+    // Blocks its thread in the nested invoke(), which would take a worker
+    // from a pooled |queue|.
+    auto other = vi::TaskQueue::create("invoke_other");
+    int counter = 0;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&]{
+            for (int i = 0; i < kCalls; ++i) {
+                int value = queue->invoke([&]{
+                    VI_EXPECT(queue->isCurrent());
+                    // Runs inline rather than deadlocking.
+                    return queue->invoke([&]{ return ++counter; });
+                });
+                VI_EXPECT(value > 0);
+                if (i % 100 == 0) {
+                    // Nested through a second queue.
+                    std::unique_ptr<int> result = other->invoke([&]{
+                        return std::make_unique<int>(queue->invoke([&]{ return counter; }));
+                    });
+                    VI_EXPECT(result && *result > 0);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    queue->invoke([]{});
+    VI_EXPECT(queue->invoke([&]{ return counter; }) == kThreads * kCalls);
+}
+
+// Replies arrive on the reply queue, in posting order, with move-only
+// results.
+void checkReply(const vi::TaskQueueOptions& options) {
+    const int kReplies = 10000;
+
+    auto queue = vi::TaskQueue::create("reply_worker", options);
+    auto replies = vi::TaskQueue::create("reply", options);
+    std::vector<int> received;
+    vi::Event done;
+    for (int i = 0; i < kReplies; ++i) {
+        queue->postTaskAndReply([&queue, i]{
+            VI_EXPECT(queue->isCurrent());
+            return std::make_unique<int>(i);
+        }, replies.get(), [&, i](std::unique_ptr<int> result) {
+            VI_EXPECT(replies->isCurrent());
+            VI_EXPECT(result && *result == i);
+            received.push_back(i);
+        });
+    }
+    queue->postTaskAndReply([]{}, replies.get(), [&done]{ done.set(); });
+    done.wait(vi::Event::kForever);
+
+    VI_EXPECT(received.size() == kReplies);
+    for (int i = 0; i < int(received.size()); ++i) {
+        VI_EXPECT(received[i] == i);
+    }
+}
+
+}
+
+VI_STRESS(invoke_reply) {
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        vi::TaskQueueOptions options;
+        options.type_ = type;
+        checkInvoke(options);
+        checkReply(options);
+    }
+}
@@ -0,0 +1,219 @@
+#if defined(__linux__)
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_queue.h"
+
+namespace {
+
+vi::TaskQueueOptions ioOptions() {
+    vi::TaskQueueOptions options;
+    options.type_ = vi::TaskQueueType::kIO;
+    return options;
+}
+
+// Non-blocking socket pair, |fds[0]| is watched.
+struct SocketPair {
+    SocketPair() {
+        socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds_);
+    }
+
+    ~SocketPair() {
+        close(fds_[0]);
+        close(fds_[1]);
+    }
+
+    int fds_[2] = {-1, -1};
+};
+
+// Bytes written from another thread arrive in order through callbacks on
+// the queue, while tasks posted in between keep their FIFO order.
+void checkReadable() {
+    const int kMessages = 20000;
+
+    auto queue = vi::TaskQueue::create("io_readable", ioOptions());
+    SocketPair pair;
+    int received = 0;
+    int callbacks = 0;
+    vi::Event done;
+    auto watch = queue->watchFd(pair.fds_[0], vi::kFdReadable, [&](uint32_t events) {
+        VI_EXPECT(queue->isCurrent());
+        VI_EXPECT(events & vi::kFdReadable);
+        ++callbacks;
+        unsigned char buffer[4096];
+        ssize_t count = 0;
+        while ((count = read(pair.fds_[0], buffer, sizeof(buffer))) > 0) {
+            for (ssize_t i = 0; i < count; ++i) {
+                VI_EXPECT(buffer[i] == (unsigned char)(received & 0xff));
+                ++received;
+            }
+        }
+        if (received == kMessages) {
+            done.set();
+        }
+    });
+    VI_EXPECT(watch.valid());
+
+    int last = -1;
+    std::thread writer([&]{
+        for (int i = 0; i < kMessages; ++i) {
+            const unsigned char byte = (unsigned char)(i & 0xff);
+            while (write(pair.fds_[1], &byte, 1) != 1) {
+                std::this_thread::yield();
+            }
+            if (i % 16 == 0) {
+                queue->postTask([&last, i]{
+                    VI_EXPECT(i > last);
+                    last = i;
+                });
+            }
+        }
+    });
+    writer.join();
+    done.wait(vi::Event::kForever);
+    queue->invoke([]{});
+    VI_EXPECT(received == kMessages);
+    VI_EXPECT(callbacks > 0 && callbacks <= kMessages);
+    VI_EXPECT(last == (kMessages - 1) / 16 * 16);
+    watch.stop();
+}
+
+// Stopped watches run no more and their callbacks are destroyed, from
+// another thread right away and from the callback itself once it returns.
+void checkStop() {
+    auto queue = vi::TaskQueue::create("io_stop", ioOptions());
+    SocketPair pair;
+    auto token = std::make_shared<int>(0);
+    std::weak_ptr<int> watch = token;
+    std::atomic<int> calls(0);
+    auto handle = queue->watchFd(pair.fds_[0], vi::kFdReadable, [&calls, token]{ ++calls; });
+    token.reset();
+    handle.stop();
+    VI_EXPECT(watch.expired());
+    const char byte = 1;
+    VI_EXPECT(write(pair.fds_[1], &byte, 1) == 1);
+    queue->invoke([]{});
+    VI_EXPECT(calls.load() == 0);
+
+    // Never reads, so only stop() keeps the level triggered callback from
+    // running again.
+    vi::FdWatchHandle self;
+    vi::Event stopped;
+    token = std::make_shared<int>(0);
+    watch = token;
+    queue->invoke([&]{
+        self = queue->watchFd(pair.fds_[0], vi::kFdReadable, [&, token]{
+            ++calls;
+            self.stop();
+            stopped.set();
+        });
+    });
+    token.reset();
+    stopped.wait(vi::Event::kForever);
+    queue->invoke([]{});
+    VI_EXPECT(calls.load() == 1);
+    VI_EXPECT(watch.expired());
+
+    // The same descriptor can be watched again after stop().
+    vi::Event again;
+    auto next = queue->watchFd(pair.fds_[0], vi::kFdReadable, [&again]{ again.set(); });
+    VI_EXPECT(next.valid());
+    // But not twice at once.
+    VI_EXPECT(!queue->watchFd(pair.fds_[0], vi::kFdReadable, []{}).valid());
+    again.wait(vi::Event::kForever);
+    next.stop();
+}
+
+// An edge triggered watch runs once per change, not for as long as the
+// descriptor stays readable.
+void checkEdgeTriggered() {
+    auto queue = vi::TaskQueue::create("io_edge", ioOptions());
+    SocketPair pair;
+    std::atomic<int> calls(0);
+    auto handle = queue->watchFd(pair.fds_[0], vi::kFdReadable | vi::kFdEdgeTriggered, [&calls]{ ++calls; });
+    const char byte = 1;
+    VI_EXPECT(write(pair.fds_[1], &byte, 1) == 1);
+    while (calls.load() == 0) {
+        std::this_thread::yield();
+    }
+    for (int i = 0; i < 100; ++i) {
+        queue->invoke([]{});
+    }
+    VI_EXPECT(calls.load() == 1);
+    VI_EXPECT(write(pair.fds_[1], &byte, 1) == 1);
+    while (calls.load() == 1) {
+        std::this_thread::yield();
+    }
+    handle.stop();
+}
+
+// Delayed tasks fire through the timerfd, and a busy descriptor does not
+// hold them back.
+void checkTimers() {
+    auto queue = vi::TaskQueue::create("io_timers", ioOptions());
+    SocketPair pair;
+    const char byte = 1;
+    VI_EXPECT(write(pair.fds_[1], &byte, 1) == 1);
+    // Ready all the time.
+    auto busy = queue->watchFd(pair.fds_[0], vi::kFdReadable, []{});
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::chrono::steady_clock::duration> fired(20);
+    std::atomic<int> count(0);
+    vi::Event done;
+    for (int i = 0; i < int(fired.size()); ++i) {
+        queue->postDelayedTask([&, i]{
+            fired[i] = std::chrono::steady_clock::now() - start;
+            if (++count == int(fired.size())) {
+                done.set();
+            }
+        }, std::chrono::milliseconds(1 + i));
+    }
+    done.wait(vi::Event::kForever);
+    busy.stop();
+    for (int i = 0; i < int(fired.size()); ++i) {
+        // The core clock truncates to microseconds.
+        VI_EXPECT(fired[i] >= std::chrono::milliseconds(1 + i) - std::chrono::microseconds(1));
+    }
+}
+
+// Other queue types cannot watch, and deleting a queue destroys the
+// callbacks of its watches.
+void checkLifetime() {
+    SocketPair pair;
+    auto plain = vi::TaskQueue::create("io_plain");
+    VI_EXPECT(!plain->watchFd(pair.fds_[0], vi::kFdReadable, []{}).valid());
+
+    auto token = std::make_shared<int>(0);
+    std::weak_ptr<int> watch = token;
+    vi::FdWatchHandle handle;
+    {
+        auto queue = vi::TaskQueue::create("io_lifetime", ioOptions());
+        handle = queue->watchFd(pair.fds_[0], vi::kFdWritable, [token]{});
+        token.reset();
+        queue->invoke([]{});
+    }
+    VI_EXPECT(watch.expired());
+    // Outliving the queue is fine.
+    handle.stop();
+}
+
+}
+
+VI_STRESS(io_queue) {
+    checkReadable();
+    checkStop();
+    checkEdgeTriggered();
+    checkTimers();
+    checkLifetime();
+}
+
+#endif
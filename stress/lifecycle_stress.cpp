@@ -0,0 +1,85 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_queue.h"
+#include "task_queue_manager.h"
+#include "thread_pool.h"
+
+VI_STRESS(pooled_churn) {
+    vi::ThreadPool pool(4);
+    vi::TaskQueueOptions options;
+    options.type_ = vi::TaskQueueType::kPooled;
+    options.thread_pool_ = &pool;
+
+    // Queues are deleted idle, with pending and delayed tasks, and from a
+    // task of another queue while they may be running on a different worker.
+    std::atomic<int> destroyed(0);
+    for (int round = 0; round < 300; ++round) {
+        auto queue = vi::TaskQueue::create("churn", options);
+        auto other = vi::TaskQueue::create("other", options).release();
+        auto token = std::shared_ptr<int>(new int(0), [&destroyed](int* p){
+            delete p;
+            destroyed.fetch_add(1, std::memory_order_relaxed);
+        });
+        for (int i = 0; i < 20; ++i) {
+            queue->postTask([]{});
+            other->postTask([token]{});
+            other->postDelayedTask([token]{}, 1);
+        }
+        token.reset();
+        vi::Event deleted;
+        queue->postTask([other, &deleted]{
+            delete other;
+            deleted.set();
+        });
+        deleted.wait(vi::Event::kForever);
+    }
+    VI_EXPECT(destroyed.load() == 300);
+}
+
+VI_STRESS(manager_churn) {
+    vi::TaskQueueOptions pooled;
+    pooled.type_ = vi::TaskQueueType::kPooled;
+
+    // Posting by handle races with the queue being created and destroyed;
+    // every post either fails or its task runs.
+    auto handle = TQMgr->handle("stress_churn");
+    std::atomic<bool> stop(false);
+    std::atomic<long> posted(0);
+    std::atomic<long> ran(0);
+    std::vector<std::thread> posters;
+    for (int t = 0; t < 3; ++t) {
+        posters.emplace_back([&]{
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (TQMgr->postTask(handle, [&ran]{ ran.fetch_add(1, std::memory_order_relaxed); })) {
+                    posted.fetch_add(1, std::memory_order_relaxed);
+                }
+                TQMgr->hasQueue("stress_churn");
+            }
+        });
+    }
+    std::thread namer([]{
+        for (int i = 0; i < 1000; ++i) {
+            VI_EXPECT(TQMgr->handle("stress_name" + std::to_string(i)).valid());
+        }
+    });
+
+    for (int round = 0; round < 100; ++round) {
+        TQMgr->create({"stress_churn"}, round % 2 ? pooled : vi::TaskQueueOptions());
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        TQMgr->destroy({"stress_churn"});
+    }
+    stop.store(true);
+    for (auto& poster : posters) {
+        poster.join();
+    }
+    namer.join();
+
+    // Destroying a queue runs or drops its pending tasks, it never keeps them.
+    VI_EXPECT(ran.load() <= posted.load());
+    VI_EXPECT(!TQMgr->hasQueue("stress_churn"));
+}
@@ -0,0 +1,123 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_queue.h"
+#include "task_queue_base.h"
+
+namespace {
+
+const int kProducers = 4;
+
+const int kPostsPerProducer = 20000;
+
+// Several producers post into one queue. Every task checks that it is the
+// only one running, that the queue is current and that the tasks of its
+// producer run in the order they were posted; delayed tasks and tasks
+// reposted from inside the queue are mixed in.
+void checkFifo(const vi::TaskQueueOptions& options) {
+    auto queue = vi::TaskQueue::create("fifo", options);
+
+    std::vector<int> last(kProducers, -1);
+    std::atomic<int> inside(0);
+    std::atomic<int> remaining(kProducers * (kPostsPerProducer + kPostsPerProducer / 10 + kPostsPerProducer / 100));
+    vi::Event done;
+    auto count = [&remaining, &done]{
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            done.set();
+        }
+    };
+
+    vi::TaskQueue* taskQueue = queue.get();
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p]{
+            for (int i = 0; i < kPostsPerProducer; ++i) {
+                taskQueue->postTask([&, p, i]{
+                    VI_EXPECT(inside.fetch_add(1, std::memory_order_acquire) == 0);
+                    VI_EXPECT(taskQueue->isCurrent());
+                    VI_EXPECT(last[p] < i);
+                    last[p] = i;
+                    if (i % 10 == 0) {
+                        vi::TaskQueueBase::current()->postTask(vi::Task(count));
+                    }
+                    inside.fetch_sub(1, std::memory_order_release);
+                    count();
+                });
+                if (i % 100 == 0) {
+                    taskQueue->postDelayedTask(count, std::chrono::microseconds(i % 500));
+                }
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    done.wait(vi::Event::kForever);
+}
+
+// Delayed tasks posted with shuffled delays run in the order of their fire
+// times, never before, and interleave with immediate tasks. The queue takes
+// the fire time somewhere inside postDelayedTask(), so each one is known to
+// lie between the clock read before and after the call.
+void checkDelayed(const vi::TaskQueueOptions& options) {
+    using Clock = std::chrono::steady_clock;
+    const int kTasks = 300;
+    const int kMaxDelayMs = 60;
+    // The queue truncates its clock to microseconds.
+    const auto kResolution = std::chrono::microseconds(1);
+
+    auto queue = vi::TaskQueue::create("delayed", options);
+    std::vector<Clock::time_point> earliest(kTasks);
+    std::vector<Clock::time_point> latest(kTasks);
+    std::vector<int> ran;
+    vi::Event done;
+    for (int i = 0; i < kTasks; ++i) {
+        const auto delay = std::chrono::milliseconds((i * 37) % kMaxDelayMs);
+        earliest[i] = Clock::now() + delay;
+        queue->postDelayedTask([&, i, kResolution]{
+            VI_EXPECT(Clock::now() + kResolution >= earliest[i]);
+            ran.push_back(i);
+            if (ran.size() == kTasks) {
+                done.set();
+            }
+        }, delay);
+        latest[i] = Clock::now() + delay;
+        queue->postTask([]{});
+    }
+    done.wait(vi::Event::kForever);
+
+    for (size_t n = 1; n < ran.size(); ++n) {
+        VI_EXPECT(earliest[ran[n - 1]] <= latest[ran[n]] + kResolution);
+    }
+}
+
+vi::TaskQueueOptions options(vi::TaskQueueType type, bool lockFree, vi::DelayedQueueType delayedType) {
+    vi::TaskQueueOptions options;
+    options.type_ = type;
+    options.lock_free_submission_ = lockFree;
+    options.delayed_queue_type_ = delayedType;
+    return options;
+}
+
+}
+
+VI_STRESS(fifo_thread) {
+    checkFifo(options(vi::TaskQueueType::kDedicatedThread, false, vi::DelayedQueueType::kOrderedMap));
+    checkFifo(options(vi::TaskQueueType::kDedicatedThread, true, vi::DelayedQueueType::kTimingWheel));
+}
+
+VI_STRESS(fifo_pooled) {
+    checkFifo(options(vi::TaskQueueType::kPooled, false, vi::DelayedQueueType::kOrderedMap));
+    checkFifo(options(vi::TaskQueueType::kPooled, true, vi::DelayedQueueType::kTimingWheel));
+}
+
+VI_STRESS(delayed_order) {
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        for (auto delayedType : {vi::DelayedQueueType::kOrderedMap, vi::DelayedQueueType::kTimingWheel}) {
+            checkDelayed(options(type, false, delayedType));
+        }
+    }
+}
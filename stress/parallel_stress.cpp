@@ -0,0 +1,136 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "parallel.h"
+#include "stress.h"
+#include "task_queue.h"
+#include "thread_pool.h"
+
+namespace {
+
+const int kQueues = 3;
+
+struct Group {
+    Group() {
+        for (int i = 0; i < kQueues; ++i) {
+            owned_.push_back(vi::TaskQueue::create("parallel_" + std::to_string(i)));
+            queues_.push_back(owned_.back().get());
+        }
+    }
+
+    std::vector<std::unique_ptr<vi::TaskQueue>> owned_;
+
+    std::vector<vi::TaskQueue*> queues_;
+};
+
+// Every index of assorted ranges and grains is visited exactly once, by
+// per-index and per-chunk functions of uneven cost.
+template <class Executor>
+void checkCoverage(Executor executor) {
+    const size_t kSize = 5000;
+    std::vector<std::atomic<int>> hits(kSize);
+    const size_t ranges[][3] = {
+        {0, kSize, 0}, {0, kSize, 1}, {17, 4000, 7}, {0, kSize, kSize}, {100, 101, 0}, {5, 5, 3}, {0, kSize, 4999},
+    };
+    for (const auto& range : ranges) {
+        const size_t begin = range[0];
+        const size_t end = range[1];
+        for (auto& hit : hits) {
+            hit.store(0, std::memory_order_relaxed);
+        }
+        vi::parallelFor(executor, begin, end, range[2], [&hits](size_t i) {
+            // Uneven cost, so that chunks finish out of order.
+            if (i % 97 == 0) {
+                std::this_thread::yield();
+            }
+            hits[i].fetch_add(1, std::memory_order_relaxed);
+        });
+        for (size_t i = 0; i < kSize; ++i) {
+            VI_EXPECT(hits[i].load(std::memory_order_relaxed) == (i >= begin && i < end ? 1 : 0));
+        }
+
+        std::atomic<size_t> sum(0);
+        std::atomic<size_t> chunks(0);
+        const size_t grain = range[2];
+        vi::parallelFor(executor, begin, end, grain, [&](size_t chunkBegin, size_t chunkEnd) {
+            VI_EXPECT(chunkBegin < chunkEnd);
+            VI_EXPECT(grain == 0 || chunkEnd - chunkBegin <= grain);
+            size_t local = 0;
+            for (size_t i = chunkBegin; i < chunkEnd; ++i) {
+                local += i;
+            }
+            sum += local;
+            ++chunks;
+        });
+        size_t expected = 0;
+        for (size_t i = begin; i < end; ++i) {
+            expected += i;
+        }
+        VI_EXPECT(sum.load() == expected);
+        VI_EXPECT(grain == 0 || chunks.load() == (end - begin + grain - 1) / grain);
+    }
+
+    std::atomic<int> forked(0);
+    vi::forkJoin(executor, [&]{ forked += 1; }, [&]{ forked += 10; }, [&]{ return forked += 100; });
+    VI_EXPECT(forked.load() == 111);
+}
+
+// With every queue of the group busy the caller does all the work, and
+// helpers that start afterwards find nothing to do.
+void checkBusyGroup() {
+    Group group;
+    vi::Event open(/*manual_reset=*/true, /*initially_signaled=*/false);
+    std::vector<std::unique_ptr<vi::Event>> entered;
+    for (vi::TaskQueue* queue : group.queues_) {
+        entered.push_back(std::make_unique<vi::Event>());
+        vi::Event* event = entered.back().get();
+        queue->postTask([event, &open]{
+            event->set();
+            open.wait(vi::Event::kForever);
+        });
+        event->wait(vi::Event::kForever);
+    }
+    const std::thread::id caller = std::this_thread::get_id();
+    std::atomic<int> elsewhere(0);
+    vi::parallelFor(group.queues_, 0, 1000, 10, [&](size_t) {
+        if (std::this_thread::get_id() != caller) {
+            ++elsewhere;
+        }
+    });
+    VI_EXPECT(elsewhere.load() == 0);
+    open.set();
+    for (vi::TaskQueue* queue : group.queues_) {
+        queue->invoke([]{});
+    }
+}
+
+// parallelFor() from a task of the group, nested once more from inside
+// the loop, completes.
+void checkNested() {
+    Group group;
+    std::atomic<int> inner(0);
+    group.queues_[0]->invoke([&]{
+        vi::parallelFor(group.queues_, 0, 8, 1, [&](size_t) {
+            vi::parallelFor(group.queues_, 0, 100, 0, [&](size_t) { ++inner; });
+        });
+    });
+    VI_EXPECT(inner.load() == 800);
+}
+
+}
+
+VI_STRESS(parallel_for) {
+    {
+        Group group;
+        checkCoverage(group.queues_);
+    }
+    {
+        vi::ThreadPool pool(kQueues);
+        checkCoverage(&pool);
+    }
+    checkCoverage(vi::ThreadPool::shared());
+    checkBusyGroup();
+    checkNested();
+}
@@ -0,0 +1,108 @@
+#if defined(__linux__)
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <memory>
+#include <string>
+#include "stress.h"
+#include "task_queue.h"
+#include "task_queue_manager.h"
+#include "thread_pool.h"
+
+namespace {
+
+std::string threadName() {
+    char name[16] = {};
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    return name;
+}
+
+int cpuCount() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+    return CPU_COUNT(&set);
+}
+
+// A dedicated queue runs with its name, on the first CPU of node 0 only,
+// and with the lower priority.
+void checkDedicated() {
+    vi::TaskQueueOptions options;
+    options.thread_placement_.cpus_ = {0};
+    options.thread_placement_.numa_node_ = 0;
+    options.thread_placement_.policy_ = vi::SchedulingPolicy::kBatch;
+    options.thread_placement_.nice_ = 5;
+    auto queue = vi::TaskQueue::create("placement_queue_name", options);
+
+    queue->invoke([]{
+        // Cut to 15 characters.
+        VI_EXPECT(threadName() == "placement_queue");
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        VI_EXPECT(sched_getaffinity(0, sizeof(set), &set) == 0);
+        VI_EXPECT(CPU_COUNT(&set) == 1 && CPU_ISSET(0, &set));
+        VI_EXPECT(sched_getscheduler(0) == SCHED_BATCH);
+        VI_EXPECT(getpriority(PRIO_PROCESS, 0) == 5);
+    });
+
+    // Defaults leave the thread alone but for the name.
+    auto plain = vi::TaskQueue::create("placement_plain");
+    const int cpus = cpuCount();
+    plain->invoke([cpus]{
+        VI_EXPECT(threadName() == "placement_plain");
+        VI_EXPECT(cpuCount() == cpus);
+        VI_EXPECT(getpriority(PRIO_PROCESS, 0) == 0);
+    });
+
+    // The cut does not split a UTF-8 character: "\u00e4" takes two bytes,
+    // the third of which would straddle the limit.
+    auto utf8 = vi::TaskQueue::create("placement_\u00e4\u00e4\u00e4");
+    utf8->invoke([]{
+        VI_EXPECT(threadName() == "placement_\u00e4\u00e4");
+    });
+}
+
+// Workers of a pool carry the placement and are numbered.
+void checkPool() {
+    vi::ThreadPlacement placement;
+    placement.name_ = "placed";
+    placement.nice_ = 3;
+    vi::ThreadPool pool(2, placement);
+    vi::TaskQueueOptions options;
+    options.type_ = vi::TaskQueueType::kPooled;
+    options.thread_pool_ = &pool;
+    auto queue = vi::TaskQueue::create("placement_pooled", options);
+    queue->invoke([]{
+        const std::string name = threadName();
+        VI_EXPECT(name == "placed-0" || name == "placed-1");
+        VI_EXPECT(getpriority(PRIO_PROCESS, 0) == 3);
+    });
+}
+
+// Queues created together by the manager name their threads after
+// themselves, unless the options give an explicit name.
+void checkManagerNames() {
+    vi::TaskQueueOptions options;
+    options.thread_placement_.nice_ = 1;
+    TQMgr->create({"placement_m1", "placement_m2"}, options);
+    TQ("placement_m1")->invoke([]{ VI_EXPECT(threadName() == "placement_m1"); });
+    TQ("placement_m2")->invoke([]{ VI_EXPECT(threadName() == "placement_m2"); });
+    TQMgr->destroy({"placement_m1", "placement_m2"});
+
+    options.thread_placement_.name_ = "placement_batch";
+    TQMgr->create({"placement_m1", "placement_m2"}, options);
+    TQ("placement_m1")->invoke([]{ VI_EXPECT(threadName() == "placement_batch"); });
+    TQ("placement_m2")->invoke([]{ VI_EXPECT(threadName() == "placement_batch"); });
+    TQMgr->destroy({"placement_m1", "placement_m2"});
+}
+
+}
+
+VI_STRESS(thread_placement) {
+    checkDedicated();
+    checkPool();
+    checkManagerNames();
+}
+
+#endif
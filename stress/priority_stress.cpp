@@ -0,0 +1,91 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_queue.h"
+
+namespace {
+
+const int kProducers = 3;
+
+const int kPostsPerProducer = 10000;
+
+// Producers post into all lanes while the queue is blocked, then the queue
+// is released. Each lane must stay FIFO per producer, high priority tasks
+// must all run before any normal one, and low priority tasks must get their
+// share before the other lanes are drained.
+void checkLanes(const vi::TaskQueueOptions& options) {
+    auto queue = vi::TaskQueue::create("priority", options);
+
+    vi::Event blocked;
+    vi::Event release;
+    queue->postTask([&]{
+        blocked.set();
+        release.wait(vi::Event::kForever);
+    });
+    blocked.wait(vi::Event::kForever);
+
+    const vi::TaskPriority priorities[] = {vi::TaskPriority::kHigh, vi::TaskPriority::kNormal, vi::TaskPriority::kLow};
+    std::vector<std::vector<int>> last(vi::kTaskPriorityCount, std::vector<int>(kProducers, -1));
+    const int normalTasks = kProducers * (kPostsPerProducer / vi::kTaskPriorityCount);
+    int ranNormal = 0;
+    int ranLowBeforeNormalDone = 0;
+    std::atomic<int> remaining(kProducers * kPostsPerProducer);
+    vi::Event done;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p]{
+            for (int i = 0; i < kPostsPerProducer; ++i) {
+                const int laneIndex = i % vi::kTaskPriorityCount;
+                queue->postTask([&, p, i, laneIndex]{
+                    VI_EXPECT(last[laneIndex][p] < i);
+                    last[laneIndex][p] = i;
+                    switch (priorities[laneIndex]) {
+                    case vi::TaskPriority::kHigh:
+                        VI_EXPECT(ranNormal == 0);
+                        break;
+                    case vi::TaskPriority::kNormal:
+                        ++ranNormal;
+                        break;
+                    case vi::TaskPriority::kLow:
+                        ranLowBeforeNormalDone += ranNormal < normalTasks;
+                        break;
+                    }
+                    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        done.set();
+                    }
+                }, priorities[laneIndex]);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    release.set();
+    done.wait(vi::Event::kForever);
+
+    if (options.low_priority_starvation_limit_) {
+        VI_EXPECT(ranLowBeforeNormalDone > 0);
+    }
+    else {
+        VI_EXPECT(ranLowBeforeNormalDone == 0);
+    }
+}
+
+}
+
+VI_STRESS(priority_lanes) {
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        for (bool lockFree : {false, true}) {
+            for (uint32_t limit : {0u, 16u}) {
+                vi::TaskQueueOptions options;
+                options.type_ = type;
+                options.lock_free_submission_ = lockFree;
+                options.low_priority_starvation_limit_ = limit;
+                checkLanes(options);
+            }
+        }
+    }
+}
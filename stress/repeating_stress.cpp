@@ -0,0 +1,135 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_queue.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// A repeating task keeps to its absolute schedule although every run takes
+// a good part of the period, and stops from the outside with its closure
+// destroyed.
+void checkSchedule(const vi::TaskQueueOptions& options) {
+    const auto kPeriod = std::chrono::milliseconds(4);
+    const int kRuns = 50;
+
+    auto queue = vi::TaskQueue::create("repeating", options);
+    auto alive = std::make_shared<int>(0);
+    std::weak_ptr<int> watch = alive;
+    std::vector<Clock::time_point> runs;
+    vi::Event done;
+    const auto start = Clock::now();
+    auto handle = queue->postRepeatingTask([&runs, &done, alive, kRuns]{
+        runs.push_back(Clock::now());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (runs.size() == kRuns) {
+            done.set();
+        }
+    }, kPeriod);
+    alive.reset();
+    done.wait(vi::Event::kForever);
+    handle.stop();
+
+    // Give the queue time to drop a run that was in progress.
+    vi::Event idle;
+    queue->postTask([&idle]{ idle.set(); });
+    idle.wait(vi::Event::kForever);
+    VI_EXPECT(watch.expired());
+
+    for (int n = 0; n < kRuns; ++n) {
+        VI_EXPECT(runs[n] >= start + kPeriod * (n + 1));
+    }
+    // Without drift compensation the last run would be at least kRuns times
+    // the 1 ms run time late. Allow for a slow machine, though.
+    VI_EXPECT(runs.back() < start + kPeriod * kRuns + std::chrono::milliseconds(kRuns / 2));
+
+    auto stats = queue->stats();
+    VI_EXPECT(stats.delayed_ == 0);
+}
+
+// The closure returns its next interval and stops itself.
+void checkReturnedInterval(const vi::TaskQueueOptions& options) {
+    auto queue = vi::TaskQueue::create("repeating_interval", options);
+    std::atomic<int> runs(0);
+    vi::Event done;
+    queue->postRepeatingTask([&]() -> std::chrono::microseconds {
+        if (++runs == 20) {
+            done.set();
+            return vi::kStopRepeating;
+        }
+        return std::chrono::microseconds(runs * 100);
+    }, std::chrono::microseconds(100));
+    done.wait(vi::Event::kForever);
+
+    vi::Event idle;
+    queue->postDelayedTask([&idle]{ idle.set(); }, 10);
+    idle.wait(vi::Event::kForever);
+    VI_EXPECT(runs.load() == 20);
+}
+
+// Many repeating tasks are stopped from other threads, from their own
+// closure and from other tasks of the queue while they run or wait.
+void checkStopRace(const vi::TaskQueueOptions& options) {
+    const int kTasks = 200;
+
+    auto queue = vi::TaskQueue::create("repeating_stop", options);
+    std::vector<vi::RepeatingTaskHandle> handles(kTasks);
+    std::atomic<int> destroyed(0);
+    for (int i = 0; i < kTasks; ++i) {
+        auto token = std::shared_ptr<int>(new int(i), [&destroyed](int* p){
+            delete p;
+            destroyed.fetch_add(1, std::memory_order_relaxed);
+        });
+        handles[i] = queue->postRepeatingTask([token]{}, std::chrono::microseconds(50 + i % 100));
+    }
+
+    std::vector<std::thread> stoppers;
+    for (int t = 0; t < 2; ++t) {
+        stoppers.emplace_back([&, t]{
+            for (int i = t; i < kTasks / 2; i += 2) {
+                handles[i].stop();
+                std::this_thread::yield();
+            }
+        });
+    }
+    vi::Event stopped;
+    queue->postTask([&]{
+        for (int i = kTasks / 2; i < kTasks; ++i) {
+            handles[i].stop();
+        }
+        stopped.set();
+    });
+    stopped.wait(vi::Event::kForever);
+    for (auto& stopper : stoppers) {
+        stopper.join();
+    }
+
+    vi::Event idle;
+    queue->postTask([&idle]{ idle.set(); });
+    idle.wait(vi::Event::kForever);
+    VI_EXPECT(destroyed.load() == kTasks);
+
+    // Handles outlive the queue.
+    auto handle = queue->postRepeatingTask([]{}, std::chrono::milliseconds(1));
+    queue.reset();
+    handle.stop();
+}
+
+}
+
+VI_STRESS(repeating_task) {
+    for (auto type : {vi::TaskQueueType::kDedicatedThread, vi::TaskQueueType::kPooled}) {
+        for (auto delayedType : {vi::DelayedQueueType::kOrderedMap, vi::DelayedQueueType::kTimingWheel}) {
+            vi::TaskQueueOptions options;
+            options.type_ = type;
+            options.delayed_queue_type_ = delayedType;
+            checkSchedule(options);
+            checkReturnedInterval(options);
+            checkStopRace(options);
+        }
+    }
+}
@@ -0,0 +1,181 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "event.h"
+#include "simulated_clock.h"
+#include "stress.h"
+#include "task_queue_manager.h"
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// A day of timers on manager queues in simulated-time mode: delayed tasks
+// run exactly at their deadline and in deadline order, a repeating task
+// keeps its period, and the whole day takes moments.
+void checkDay(vi::DelayedQueueType type) {
+    const int kTimers = 20000;
+
+    vi::SimulatedClock clock;
+    TQMgr->setSimulatedClock(&clock);
+    vi::TaskQueueOptions options;
+    options.delayed_queue_type_ = type;
+    TQMgr->create({"sim_timers", "sim_ticks"}, options);
+    VI_EXPECT(TQMgr->simulatedClock() == &clock);
+
+    std::mt19937 random(11);
+    int64_t last = -1;
+    int fired = 0;
+    for (int i = 0; i < kTimers; ++i) {
+        const int64_t delayUs = int64_t(random() % 86400) * 1000000 + random() % 1000000;
+        TQ("sim_timers")->postDelayedTask([&, delayUs]{
+            VI_EXPECT(TQ("sim_timers")->isCurrent());
+            VI_EXPECT(clock.microseconds() == delayUs);
+            VI_EXPECT(delayUs >= last);
+            last = delayUs;
+            ++fired;
+        }, std::chrono::microseconds(delayUs));
+    }
+    int ticks = 0;
+    auto repeating = TQ("sim_ticks")->postRepeatingTask([&]{
+        ++ticks;
+        VI_EXPECT(clock.now() == ticks * std::chrono::microseconds(5min));
+    }, 5min);
+
+    const auto start = std::chrono::steady_clock::now();
+    clock.runFor(24h);
+    VI_EXPECT(std::chrono::steady_clock::now() - start < 20s);
+    VI_EXPECT(clock.now() == std::chrono::microseconds(24h));
+    VI_EXPECT(fired == kTimers);
+    VI_EXPECT(ticks == 24 * 12);
+    VI_EXPECT(clock.tasksRun() == uint64_t(kTimers + ticks));
+
+    repeating.stop();
+    clock.runUntilIdle();
+    VI_EXPECT(ticks == 24 * 12);
+
+    TQMgr->destroy({"sim_timers", "sim_ticks"});
+    TQMgr->setSimulatedClock(nullptr);
+}
+
+// Tasks that post to each other with and without delays, cancel and
+// debounce produce the same history on every run.
+std::vector<std::tuple<int, int, int64_t>> history() {
+    vi::SimulatedClock clock(1h);
+    vi::TaskQueueOptions options;
+    options.type_ = vi::TaskQueueType::kSimulated;
+    options.simulated_clock_ = &clock;
+    std::vector<std::unique_ptr<vi::TaskQueue>> queues;
+    for (int q = 0; q < 3; ++q) {
+        queues.push_back(vi::TaskQueue::create("sim_history_" + std::to_string(q), options));
+    }
+
+    std::vector<std::tuple<int, int, int64_t>> events;
+    std::mt19937 random(5);
+    std::function<void(int, int)> step = [&](int q, int depth) {
+        events.emplace_back(q, depth, clock.microseconds());
+        if (depth == 6) {
+            return;
+        }
+        for (int i = 0; i < 2; ++i) {
+            const int target = int(random() % 3);
+            const auto delay = std::chrono::milliseconds(random() % 3 * 10);
+            if (random() % 4 == 0) {
+                queues[target]->postTask([&, target, depth]{ step(target, depth + 1); }, vi::TaskPriority::kHigh);
+            }
+            else {
+                queues[target]->postDelayedTask([&, target, depth]{ step(target, depth + 1); }, delay);
+            }
+        }
+        auto handle = queues[q]->postDelayedTask([&]{ VI_EXPECT(false); }, 1s);
+        handle.cancel();
+        queues[q]->postDebouncedTask(7, [&, q]{ events.emplace_back(q, -1, clock.microseconds()); }, 50ms);
+    };
+    queues[0]->postTask([&]{ step(0, 0); });
+    clock.runUntilIdle();
+    VI_EXPECT(clock.now() > std::chrono::microseconds(1h));
+    return events;
+}
+
+// Deleting a queue waits for the task the driver is running on it. Tasks
+// still pending in a deleted queue never run.
+void checkDelete() {
+    vi::SimulatedClock clock;
+    vi::TaskQueueOptions options;
+    options.type_ = vi::TaskQueueType::kSimulated;
+    options.simulated_clock_ = &clock;
+    auto doomed = vi::TaskQueue::create("sim_doomed", options);
+    auto other = vi::TaskQueue::create("sim_other", options);
+
+    vi::Event entered;
+    std::atomic<bool> finished(false);
+    std::atomic<int> others(0);
+    doomed->postTask([&]{
+        entered.set();
+        std::this_thread::sleep_for(5ms);
+        finished = true;
+    });
+    other->postDelayedTask([&]{ ++others; }, 2s);
+
+    std::thread deleter([&]{
+        entered.wait(vi::Event::kForever);
+        doomed.reset();
+        VI_EXPECT(finished.load());
+    });
+    clock.runUntilIdle();
+    deleter.join();
+    VI_EXPECT(others.load() == 1);
+    VI_EXPECT(clock.now() == std::chrono::microseconds(2s));
+
+    auto probe = std::make_shared<int>(0);
+    std::weak_ptr<int> alive = probe;
+    other->postDelayedTask([probe]{ VI_EXPECT(false); }, 1s);
+    other->postTask([probe]{ VI_EXPECT(false); });
+    probe.reset();
+    VI_EXPECT(!alive.expired());
+    other.reset();
+    VI_EXPECT(alive.expired());
+    clock.runUntilIdle();
+    VI_EXPECT(clock.now() == std::chrono::microseconds(2s));
+}
+
+// Delayed tasks of a simulated queue report their queueing delay on the
+// virtual clock their deadlines are on: they run right at the deadline, so
+// the delay is 0 however far apart virtual and real time are.
+void checkStats() {
+    const int kTimers = 1000;
+
+    vi::SimulatedClock clock;
+    vi::TaskQueueOptions options;
+    options.type_ = vi::TaskQueueType::kSimulated;
+    options.simulated_clock_ = &clock;
+    options.metrics_sample_interval_ = 1;
+    auto queue = vi::TaskQueue::create("sim_stats", options);
+    for (int i = 0; i < kTimers; ++i) {
+        queue->postDelayedTask([]{}, std::chrono::minutes(i));
+    }
+    clock.runUntilIdle();
+
+    const auto stats = queue->stats();
+    VI_EXPECT(stats.run_ == uint64_t(kTimers));
+    VI_EXPECT(stats.queueing_delay_.count_ == uint64_t(kTimers));
+    VI_EXPECT(stats.queueing_delay_.max_ns_ == 0);
+}
+
+}
+
+VI_STRESS(simulated_time) {
+    checkDay(vi::DelayedQueueType::kOrderedMap);
+    checkDay(vi::DelayedQueueType::kTimingWheel);
+    const auto first = history();
+    VI_EXPECT(first.size() > 100);
+    VI_EXPECT(history() == first);
+    checkDelete();
+    checkStats();
+}
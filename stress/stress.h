@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+namespace vi {
+namespace stress {
+
+using ScenarioFunction = void (*)();
+
+struct Scenario {
+    const char* name_;
+    ScenarioFunction function_;
+};
+
+// All scenarios registered with VI_STRESS, in registration order.
+std::vector<Scenario>& scenarios();
+
+class ScenarioRegistrar {
+public:
+    ScenarioRegistrar(const char* name, ScenarioFunction function) {
+        scenarios().push_back(Scenario{name, function});
+    }
+};
+
+// Records a failed expectation of the running scenario. Thread safe, so that
+// tasks running on any queue may report.
+void fail(const char* file, int line, const char* expression);
+
+}
+}
+
+// Defines and registers a scenario that stress_main.cpp can run by name.
+#define VI_STRESS(name) \
+    static void name(); \
+    static vi::stress::ScenarioRegistrar name##_registrar(#name, &name); \
+    static void name()
+
+// Fails the running scenario, but keeps it going, unless |condition| holds.
+#define VI_EXPECT(condition) \
+    do { \
+        if (!(condition)) { \
+            vi::stress::fail(__FILE__, __LINE__, #condition); \
+        } \
+    } while (0)
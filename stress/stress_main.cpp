@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include "stress.h"
+
+namespace vi {
+namespace stress {
+
+namespace {
+
+std::atomic<int> _failures(0);
+
+// Only the first few failures of a scenario are printed.
+const int kMaxReportedFailures = 10;
+
+}  // namespace
+
+std::vector<Scenario>& scenarios() {
+    static std::vector<Scenario> _scenarios;
+    return _scenarios;
+}
+
+void fail(const char* file, int line, const char* expression) {
+    static std::mutex mutex;
+    if (_failures.fetch_add(1, std::memory_order_relaxed) < kMaxReportedFailures) {
+        std::lock_guard<std::mutex> lock(mutex);
+        fprintf(stderr, "%s:%d: expected %s\n", file, line, expression);
+    }
+}
+
+}
+}
+
+// Usage: TaskQueueStress [--repeat=<n>] [--list] [scenario-name...]
+// Runs every registered scenario, or the named ones, |n| times and exits
+// with 1 if any expectation failed, so that it can gate a build. Running it
+// with sanitizers (-fsanitize=thread or address) is where it pays off.
+int main(int argc, char* argv[])
+{
+    int repeat = 1;
+    std::vector<const char*> names;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--repeat=", 9) == 0) {
+            repeat = atoi(argv[i] + 9);
+        }
+        else if (strcmp(argv[i], "--list") == 0) {
+            for (const auto& scenario : vi::stress::scenarios()) {
+                printf("%s\n", scenario.name_);
+            }
+            return 0;
+        }
+        else {
+            names.push_back(argv[i]);
+        }
+    }
+
+    int ran = 0;
+    int failed = 0;
+    for (const auto& scenario : vi::stress::scenarios()) {
+        bool selected = names.empty();
+        for (size_t i = 0; i < names.size() && !selected; ++i) {
+            selected = strcmp(names[i], scenario.name_) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+        for (int round = 0; round < repeat; ++round) {
+            printf("%-28s ", scenario.name_);
+            fflush(stdout);
+            vi::stress::_failures.store(0);
+            auto start = std::chrono::steady_clock::now();
+            scenario.function_();
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            const int failures = vi::stress::_failures.load();
+            printf("%s (%.0f ms)\n", failures ? "FAILED" : "ok", ms);
+            failed += failures != 0;
+            ++ran;
+        }
+    }
+
+    if (ran == 0) {
+        fprintf(stderr, "no matching scenario, available:\n");
+        for (const auto& scenario : vi::stress::scenarios()) {
+            fprintf(stderr, "  %s\n", scenario.name_);
+        }
+        return 1;
+    }
+
+    printf("%d of %d runs failed\n", failed, ran);
+    return failed ? 1 : 0;
+}
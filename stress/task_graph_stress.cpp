@@ -0,0 +1,200 @@
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_graph.h"
+#include "task_queue_manager.h"
+
+namespace {
+
+// Stage A on io, B and C on codec, D on net after both B and C, run frame
+// after frame. Every node runs on its queue, after its dependencies and
+// once per frame.
+void checkPipeline() {
+    const int kFrames = 2000;
+    TQMgr->create({"graph_io", "graph_codec", "graph_net"});
+
+    std::atomic<int> a(-1);
+    std::atomic<int> b(-1);
+    std::atomic<int> c(-1);
+    std::atomic<int> d(-1);
+    int frame = 0;
+    int completed = 0;
+
+    vi::TaskGraph graph;
+    const auto stageA = graph.addNode("graph_io", [&]{
+        VI_EXPECT(TQ("graph_io")->isCurrent());
+        VI_EXPECT(a.load() == frame - 1);
+        a = frame;
+    });
+    const auto stageB = graph.addNode("graph_codec", [&]{
+        VI_EXPECT(TQ("graph_codec")->isCurrent());
+        VI_EXPECT(a.load() == frame);
+        b = frame;
+    });
+    const auto stageC = graph.addNode(TQMgr->handle("graph_codec"), [&]{
+        VI_EXPECT(a.load() == frame);
+        c = frame;
+    });
+    const auto stageD = graph.addNode("graph_net", [&]{
+        VI_EXPECT(TQ("graph_net")->isCurrent());
+        VI_EXPECT(b.load() == frame && c.load() == frame);
+        d = frame;
+    });
+    graph.addEdge(stageA, stageB);
+    graph.addEdge(stageA, stageC);
+    graph.addEdge(stageB, stageD);
+    graph.addEdge(stageC, stageD);
+    graph.onComplete([&]{
+        VI_EXPECT(d.load() == frame);
+        ++completed;
+    });
+
+    for (frame = 0; frame < kFrames; ++frame) {
+        VI_EXPECT(graph.run());
+        graph.wait();
+        VI_EXPECT(d.load() == frame);
+        VI_EXPECT(graph.skipped() == 0);
+    }
+    VI_EXPECT(completed == kFrames);
+    TQMgr->destroy({"graph_io", "graph_codec", "graph_net"});
+}
+
+// A wide random graph over several queues: every node starts after all of
+// its dependencies finished in the same run.
+void checkRandom() {
+    const int kQueues = 4;
+    const int kNodes = 300;
+    const int kFrames = 200;
+
+    std::vector<std::string> names;
+    for (int i = 0; i < kQueues; ++i) {
+        names.push_back("graph_random_" + std::to_string(i));
+    }
+    TQMgr->create(names);
+
+    std::vector<std::atomic<int>> finished(kNodes);
+    std::vector<std::vector<int>> dependencies(kNodes);
+    for (auto& value : finished) {
+        value.store(-1);
+    }
+    int frame = 0;
+
+    std::mt19937 random(7);
+    vi::TaskGraph graph;
+    for (int node = 0; node < kNodes; ++node) {
+        graph.addNode(names[random() % kQueues], [&, node]{
+            for (int dependency : dependencies[node]) {
+                VI_EXPECT(finished[dependency].load(std::memory_order_relaxed) == frame);
+            }
+            VI_EXPECT(finished[node].load(std::memory_order_relaxed) == frame - 1);
+            finished[node].store(frame, std::memory_order_relaxed);
+        });
+        // Edges only point forward, so there is no cycle.
+        const int edges = node == 0 ? 0 : int(random() % 4);
+        for (int e = 0; e < edges; ++e) {
+            const int before = int(random() % node);
+            dependencies[node].push_back(before);
+            graph.addEdge(before, node);
+        }
+    }
+
+    for (frame = 0; frame < kFrames; ++frame) {
+        VI_EXPECT(graph.run());
+        graph.wait();
+    }
+    for (auto& value : finished) {
+        VI_EXPECT(value.load() == kFrames - 1);
+    }
+    TQMgr->destroy(names);
+}
+
+// Cycles are refused, a second run() waits its turn, and nodes whose queue
+// is missing or goes away are skipped while their dependents still run.
+void checkMisuse() {
+    TQMgr->create({"graph_misuse", "graph_doomed"});
+
+    {
+        vi::TaskGraph graph;
+        const auto a = graph.addNode("graph_misuse", []{});
+        const auto b = graph.addNode("graph_misuse", []{});
+        const auto c = graph.addNode("graph_misuse", []{});
+        graph.addEdge(a, b);
+        graph.addEdge(b, c);
+        graph.addEdge(c, b);
+        VI_EXPECT(!graph.run());
+    }
+
+    {
+        vi::Event release;
+        std::atomic<int> runs(0);
+        vi::TaskGraph graph;
+        graph.addNode("graph_misuse", [&]{
+            release.wait(vi::Event::kForever);
+            ++runs;
+        });
+        VI_EXPECT(graph.run());
+        VI_EXPECT(!graph.run());
+        release.set();
+        graph.wait();
+        VI_EXPECT(runs.load() == 1);
+        VI_EXPECT(graph.run());
+        release.set();
+        graph.wait();
+        VI_EXPECT(runs.load() == 2);
+    }
+
+    {
+        std::atomic<int> dependents(0);
+        vi::TaskGraph graph;
+        const auto missing = graph.addNode("graph_missing", [&]{ VI_EXPECT(false); });
+        const auto after = graph.addNode("graph_misuse", [&]{ ++dependents; });
+        graph.addEdge(missing, after);
+        VI_EXPECT(graph.run());
+        graph.wait();
+        VI_EXPECT(graph.skipped() == 1);
+        VI_EXPECT(dependents.load() == 1);
+    }
+
+    {
+        // The node waits behind a blocked task while its queue is deleted.
+        // Depending on timing it runs first or is destroyed with the queue.
+        vi::Event open;
+        vi::Event entered;
+        TQ("graph_doomed")->postTask([&]{
+            entered.set();
+            open.wait(vi::Event::kForever);
+        });
+        entered.wait(vi::Event::kForever);
+        std::atomic<int> ran(0);
+        std::atomic<int> dependents(0);
+        vi::TaskGraph graph;
+        const auto doomed = graph.addNode("graph_doomed", [&]{ ++ran; });
+        const auto after = graph.addNode("graph_misuse", [&]{ ++dependents; });
+        graph.addEdge(doomed, after);
+        VI_EXPECT(graph.run());
+        std::thread opener([&]{
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            open.set();
+        });
+        TQMgr->destroy({"graph_doomed"});
+        opener.join();
+        graph.wait();
+        VI_EXPECT(ran.load() + int(graph.skipped()) == 1);
+        VI_EXPECT(dependents.load() == 1);
+    }
+
+    TQMgr->destroy({"graph_misuse"});
+}
+
+}
+
+VI_STRESS(task_graph) {
+    checkPipeline();
+    checkRandom();
+    checkMisuse();
+}
@@ -0,0 +1,272 @@
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "stress.h"
+#include "task_graph.h"
+#include "task_queue.h"
+#include "task_queue_manager.h"
+#include "trace_log.h"
+
+namespace {
+
+// One "X" event of TraceLog::toJson(), which writes one event per line.
+struct ParsedEvent {
+    std::string name_;
+    std::string from_;
+    std::string flow_;
+    bool flow_out_ {false};
+    bool flow_in_ {false};
+};
+
+std::string field(const std::string& line, const std::string& key) {
+    const std::string prefix = "\"" + key + "\":\"";
+    const size_t begin = line.find(prefix);
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    const size_t end = line.find('"', begin + prefix.size());
+    return line.substr(begin + prefix.size(), end - begin - prefix.size());
+}
+
+std::vector<ParsedEvent> parse(const std::string& json) {
+    std::vector<ParsedEvent> events;
+    size_t begin = 0;
+    while (begin < json.size()) {
+        size_t end = json.find('\n', begin);
+        if (end == std::string::npos) {
+            end = json.size();
+        }
+        const std::string line = json.substr(begin, end - begin);
+        begin = end + 1;
+        if (line.find("\"ph\":\"X\"") == std::string::npos) {
+            continue;
+        }
+        ParsedEvent event;
+        event.name_ = field(line, "name");
+        event.from_ = field(line, "from");
+        event.flow_ = field(line, "bind_id");
+        event.flow_out_ = line.find("\"flow_out\":true") != std::string::npos;
+        event.flow_in_ = line.find("\"flow_in\":true") != std::string::npos;
+        events.push_back(event);
+    }
+    return events;
+}
+
+std::string here(int line) {
+    return std::string(__FILE__) + ":" + std::to_string(line);
+}
+
+// Nothing is recorded while tracing is off.
+void checkDisabled() {
+    vi::TraceLog::clear();
+    auto queue = vi::TaskQueue::create("trace_disabled");
+    for (int i = 0; i < 1000; ++i) {
+        queue->postTask([]{});
+    }
+    queue->postDelayedTask([]{}, std::chrono::microseconds(10));
+    queue->invoke([]{});
+    VI_EXPECT(parse(vi::TraceLog::toJson()).empty());
+}
+
+// Posts from several threads to a dedicated and a pooled queue, among them
+// cross-queue posts, replies and delayed and repeating tasks, record a post
+// and a run per task, tied together by their flow id and carrying the post
+// site.
+void checkFlows() {
+    const int kThreads = 4;
+    const int kPosts = 500;
+
+    vi::TraceLog::clear();
+    vi::TraceLog::start();
+    auto dedicated = vi::TaskQueue::create("trace_dedicated");
+    vi::TaskQueueOptions options;
+    options.type_ = vi::TaskQueueType::kPooled;
+    auto pooled = vi::TaskQueue::create("trace_pooled", options);
+
+    std::atomic<int> runs(0);
+    auto hop = [&]{ ++runs; };
+    const int hopLine = __LINE__ + 1;
+    auto work = [&]{ ++runs; pooled->postTask(hop); };
+
+    std::vector<std::thread> threads;
+    // The lines of the three posts in the loop below.
+    const int postLine = __LINE__ + 6;
+    const int delayedLine = postLine + 1;
+    const int replyLine = postLine + 2;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&]{
+            for (int i = 0; i < kPosts; ++i) {
+                dedicated->postTask(work);
+                dedicated->postDelayedTask(hop, std::chrono::microseconds(i % 50));
+                dedicated->postTaskAndReply([]{ return 1; }, pooled.get(), [&runs](int one) { runs += one; });
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    vi::Event repeated;
+    int repeats = 0;
+    const int repeatingLine = __LINE__ + 1;
+    auto handle = dedicated->postRepeatingTask([&]{ if (++repeats == 3) { repeated.set(); return vi::kStopRepeating; } return std::chrono::microseconds(100); }, std::chrono::microseconds(100));
+    repeated.wait(vi::Event::kForever);
+
+    // No run may end after stop(). The serial queues finish a run before
+    // the next starts, so the first sync waits for all runs before it.
+    while (runs.load() < kThreads * kPosts * 4) {
+        std::this_thread::yield();
+    }
+    const int syncLine = __LINE__ + 1;
+    auto sync = [&]{ dedicated->invoke([]{}); pooled->invoke([]{}); };
+    sync();
+    sync();
+    vi::TraceLog::stop();
+    VI_EXPECT(runs.load() == kThreads * kPosts * 4);
+
+    const auto events = parse(vi::TraceLog::toJson());
+    std::map<std::string, const ParsedEvent*> posts;
+    std::map<std::string, int> postsFrom;
+    std::map<std::string, int> runsFrom;
+    int unpairedSyncs = 0;
+    for (const auto& event : events) {
+        if (event.flow_out_) {
+            VI_EXPECT(!event.flow_.empty());
+            VI_EXPECT(posts.emplace(event.flow_, &event).second);
+            VI_EXPECT(event.name_ == "post to trace_dedicated" || event.name_ == "post to trace_pooled");
+            ++postsFrom[event.from_];
+        }
+    }
+    for (const auto& event : events) {
+        if (event.flow_out_) {
+            continue;
+        }
+        VI_EXPECT(event.name_ == "trace_dedicated" || event.name_ == "trace_pooled");
+        ++runsFrom[event.from_];
+        if (!event.flow_in_) {
+            // Only the later runs of a repeating task have no flow.
+            VI_EXPECT(event.from_ == here(repeatingLine));
+            continue;
+        }
+        auto post = posts.find(event.flow_);
+        VI_EXPECT(post != posts.end());
+        if (post != posts.end()) {
+            VI_EXPECT(post->second->from_ == event.from_);
+            VI_EXPECT(post->second->name_ == "post to " + event.name_);
+            posts.erase(post);
+        }
+    }
+    for (const auto& post : posts) {
+        // The run of the last sync ends after the caller went on.
+        VI_EXPECT(post.second->from_ == here(syncLine));
+        ++unpairedSyncs;
+    }
+    VI_EXPECT(unpairedSyncs <= 2);
+
+    VI_EXPECT(postsFrom[here(postLine)] == kThreads * kPosts);
+    VI_EXPECT(postsFrom[here(hopLine)] == kThreads * kPosts);
+    VI_EXPECT(postsFrom[here(delayedLine)] == kThreads * kPosts);
+    // The task and its reply.
+    VI_EXPECT(postsFrom[here(replyLine)] == kThreads * kPosts * 2);
+    VI_EXPECT(runsFrom[here(replyLine)] == kThreads * kPosts * 2);
+    VI_EXPECT(postsFrom[here(repeatingLine)] == 1);
+    VI_EXPECT(runsFrom[here(repeatingLine)] == 3);
+    VI_EXPECT(postsFrom[here(syncLine)] == 4);
+
+    const std::string json = vi::TraceLog::toJson();
+    VI_EXPECT(json.find("\"function\":\"checkFlows\"") != std::string::npos);
+    VI_EXPECT(json.find("\"thread_name\"") != std::string::npos);
+}
+
+// Posts through a TaskQueueManager::Handle, to an unbounded and to a
+// bounded queue, and the posts of a TaskGraph node carry the site of the
+// call rather than the manager's.
+void checkHandles() {
+    vi::TraceLog::clear();
+    vi::TraceLog::start();
+    vi::TaskQueueOptions bounded;
+    bounded.max_pending_tasks_ = 1024;
+    TQMgr->create({"trace_handle"});
+    TQMgr->create({"trace_handle_bounded"}, bounded);
+    auto handle = TQMgr->handle("trace_handle");
+    auto boundedHandle = TQMgr->handle("trace_handle_bounded");
+
+    const int postLine = __LINE__ + 1;
+    VI_EXPECT(TQMgr->postTask(handle, []{}));
+    const int boundedLine = __LINE__ + 1;
+    VI_EXPECT(TQMgr->postTask(boundedHandle, []{}, vi::TaskPriority::kHigh));
+
+    vi::TaskGraph graph;
+    const int nodeLine = __LINE__ + 1;
+    graph.addNode(handle, []{});
+    VI_EXPECT(graph.run());
+    graph.wait();
+    TQMgr->queue(handle)->invoke([]{});
+    TQMgr->queue(boundedHandle)->invoke([]{});
+    vi::TraceLog::stop();
+
+    std::map<std::string, int> postsFrom;
+    for (const auto& event : parse(vi::TraceLog::toJson())) {
+        if (event.flow_out_) {
+            ++postsFrom[event.from_];
+        }
+    }
+    VI_EXPECT(postsFrom[here(postLine)] == 1);
+    VI_EXPECT(postsFrom[here(boundedLine)] == 1);
+    VI_EXPECT(postsFrom[here(nodeLine)] == 1);
+    for (const auto& post : postsFrom) {
+        VI_EXPECT(post.first.find("task_queue_manager.h") == std::string::npos);
+        VI_EXPECT(post.first.find("task_graph.cpp") == std::string::npos);
+    }
+
+    TQMgr->destroy({"trace_handle", "trace_handle_bounded"});
+}
+
+// The ring of a thread keeps the latest events.
+void checkWrap() {
+    const int kEvents = 16;
+
+    vi::TraceLog::clear();
+    vi::TraceLog::start(kEvents);
+    auto queue = vi::TaskQueue::create("trace_wrap");
+    for (int i = 0; i < kEvents * 10; ++i) {
+        queue->postTask([]{});
+    }
+    const int lastLine = __LINE__ + 1;
+    queue->postTask([]{});
+    queue->invoke([]{});
+    vi::TraceLog::stop();
+
+    int posts = 0;
+    int runs = 0;
+    bool last = false;
+    for (const auto& event : parse(vi::TraceLog::toJson())) {
+        if (event.flow_out_) {
+            ++posts;
+            last = last || event.from_ == here(lastLine);
+        }
+        else {
+            ++runs;
+        }
+    }
+    VI_EXPECT(posts == kEvents);
+    VI_EXPECT(runs <= kEvents);
+    VI_EXPECT(last);
+
+    vi::TraceLog::start();
+    vi::TraceLog::stop();
+    vi::TraceLog::clear();
+}
+
+}
+
+VI_STRESS(trace_events) {
+    checkDisabled();
+    checkFlows();
+    checkHandles();
+    checkWrap();
+}
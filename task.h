@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "block_pool.h"
+#include "queued_task.h"
+
+namespace vi {
+
+// Move-only, type-erased unit of work as stored by the task queues.
+//
+// Closures of up to |kInlineSize| bytes are stored inline, so wrapping a
+// typical lambda does not allocate. Bigger closures are placed in a block of
+// the BlockPool passed at construction (see TaskQueueBase::closurePool()) and
+// only fall back to the heap when no pool is given or the closure exceeds the
+// pool's block size. A std::unique_ptr<QueuedTask> is held by pointer and
+// keeps its usual ownership semantics.
+class Task {
+public:
+    static constexpr size_t kInlineSize = 48;
+
+    Task() = default;
+
+    explicit Task(std::unique_ptr<QueuedTask> task) {
+        if (task) {
+            new (storage_) QueuedTask*(task.release());
+            ops_ = &kQueuedTaskOps;
+        }
+    }
+
+    template <typename Closure, typename std::enable_if<!std::is_same<typename std::decay<Closure>::type, Task>::value
+                                                        && !std::is_convertible<Closure, std::unique_ptr<QueuedTask>>::value>::type* = nullptr>
+    explicit Task(Closure&& closure, BlockPool* pool = nullptr) {
+        using Function = typename std::decay<Closure>::type;
+        if constexpr (fitsInline<Function>()) {
+            new (storage_) Function(std::forward<Closure>(closure));
+            ops_ = &InlineOps<Function>::kOps;
+        }
+        else {
+            OutOfLine* out = new (storage_) OutOfLine();
+            if (pool && sizeof(Function) <= pool->blockSize()) {
+                out->pool_ = pool;
+                out->closure_ = pool->allocate();
+            }
+            else {
+                out->closure_ = ::operator new(sizeof(Function));
+            }
+            new (out->closure_) Function(std::forward<Closure>(closure));
+            ops_ = &OutOfLineOps<Function>::kOps;
+        }
+    }
+
+    Task(Task&& other) noexcept {
+        moveFrom(other);
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    ~Task() {
+        reset();
+    }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    // Runs the task and releases it, leaving this Task empty. A QueuedTask
+    // that returns false from run() is released without being deleted.
+    void run() {
+        const Ops* ops = ops_;
+        ops_ = nullptr;
+        ops->run_(storage_);
+    }
+
+    // Runs the task but keeps it, for tasks that run more than once such as
+    // repeating tasks. A QueuedTask stays owned whatever run() returns.
+    void invoke() {
+        ops_->invoke_(storage_);
+    }
+
+    // Bytes the closure occupies outside of the Task, for estimating the
+    // memory held by a queue. The size of a QueuedTask subclass is unknown
+    // and counts as 0.
+    size_t heapSize() const {
+        return ops_ ? ops_->heap_size_ : 0;
+    }
+
+    // Destroys the task without running it.
+    void reset() {
+        if (ops_) {
+            const Ops* ops = ops_;
+            ops_ = nullptr;
+            ops->destroy_(storage_);
+        }
+    }
+
+private:
+    struct Ops {
+        // Runs and destroys the task held in |storage|.
+        void (*run_)(void* storage);
+        // Runs the task held in |storage| and keeps it.
+        void (*invoke_)(void* storage);
+        // Move constructs the task into |to| and destroys |from|.
+        void (*relocate_)(void* from, void* to);
+        void (*destroy_)(void* storage);
+        // See heapSize().
+        size_t heap_size_;
+    };
+
+    struct OutOfLine {
+        void* closure_ {nullptr};
+        BlockPool* pool_ {nullptr};
+    };
+
+    template <typename T>
+    static void relocateTrivially(void* from, void* to) {
+        new (to) T(*static_cast<T*>(from));
+    }
+
+    template <typename Function>
+    static constexpr bool fitsInline() {
+        return sizeof(Function) <= kInlineSize
+                && alignof(Function) <= alignof(std::max_align_t)
+                && std::is_nothrow_move_constructible<Function>::value;
+    }
+
+    template <typename Function>
+    struct InlineOps {
+        static void run(void* storage) {
+            Function* function = static_cast<Function*>(storage);
+            (*function)();
+            function->~Function();
+        }
+        static void invoke(void* storage) {
+            (*static_cast<Function*>(storage))();
+        }
+        static void relocate(void* from, void* to) {
+            Function* function = static_cast<Function*>(from);
+            new (to) Function(std::move(*function));
+            function->~Function();
+        }
+        static void destroy(void* storage) {
+            static_cast<Function*>(storage)->~Function();
+        }
+        static constexpr Ops kOps = {&run, &invoke, &relocate, &destroy, 0};
+    };
+
+    template <typename Function>
+    struct OutOfLineOps {
+        static void run(void* storage) {
+            OutOfLine* out = static_cast<OutOfLine*>(storage);
+            (*static_cast<Function*>(out->closure_))();
+            destroy(storage);
+        }
+        static void invoke(void* storage) {
+            (*static_cast<Function*>(static_cast<OutOfLine*>(storage)->closure_))();
+        }
+        static void destroy(void* storage) {
+            OutOfLine* out = static_cast<OutOfLine*>(storage);
+            static_cast<Function*>(out->closure_)->~Function();
+            if (out->pool_) {
+                out->pool_->deallocate(out->closure_);
+            }
+            else {
+                ::operator delete(out->closure_);
+            }
+        }
+        static constexpr Ops kOps = {&run, &invoke, &relocateTrivially<OutOfLine>, &destroy, sizeof(Function)};
+    };
+
+    static void runQueuedTask(void* storage) {
+        QueuedTask* task = *static_cast<QueuedTask**>(storage);
+        if (task->run()) {
+            delete task;
+        }
+    }
+
+    static void invokeQueuedTask(void* storage) {
+        (*static_cast<QueuedTask**>(storage))->run();
+    }
+
+    static void destroyQueuedTask(void* storage) {
+        delete *static_cast<QueuedTask**>(storage);
+    }
+
+    static constexpr Ops kQueuedTaskOps = {&runQueuedTask, &invokeQueuedTask, &relocateTrivially<QueuedTask*>, &destroyQueuedTask, 0};
+
+    void moveFrom(Task& other) {
+        if (other.ops_) {
+            other.ops_->relocate_(other.storage_, storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+
+    const Ops* ops_ {nullptr};
+};
+
+}
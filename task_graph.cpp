@@ -0,0 +1,124 @@
+#include "task_graph.h"
+#include <assert.h>
+
+namespace vi {
+
+TaskGraph::~TaskGraph() {
+    wait();
+}
+
+TaskGraph::NodeTask::~NodeTask() {
+    if (graph_) {
+        graph_->skipped_.fetch_add(1, std::memory_order_relaxed);
+        graph_->finish(node_);
+    }
+}
+
+void TaskGraph::NodeTask::operator()() {
+    TaskGraph* graph = std::exchange(graph_, nullptr);
+    graph->nodes_[node_].task_.invoke();
+    graph->finish(node_);
+}
+
+TaskGraph::NodeId TaskGraph::addTaskNode(TaskQueueManager::Handle queue, Task task, const Location& from) {
+    assert(idle_.wait(0, Event::kForever));
+    nodes_.emplace_back(queue, std::move(task), from);
+    changed_ = true;
+    return NodeId(nodes_.size() - 1);
+}
+
+void TaskGraph::addEdge(NodeId before, NodeId after) {
+    assert(idle_.wait(0, Event::kForever));
+    assert(before < nodes_.size() && after < nodes_.size());
+    nodes_[before].successors_.push_back(after);
+    ++nodes_[after].dependencies_;
+    changed_ = true;
+}
+
+void TaskGraph::setCompletion(Task task) {
+    assert(idle_.wait(0, Event::kForever));
+    completion_ = std::move(task);
+}
+
+bool TaskGraph::prepare() {
+    if (!changed_) {
+        return acyclic_;
+    }
+    changed_ = false;
+
+    // Kahn's algorithm: every node is reached once all its dependencies
+    // were, which leaves out exactly the nodes on or behind a cycle.
+    roots_.clear();
+    std::vector<uint32_t> remaining(nodes_.size());
+    std::vector<NodeId> ready;
+    for (NodeId node = 0; node < nodes_.size(); ++node) {
+        remaining[node] = nodes_[node].dependencies_;
+        if (remaining[node] == 0) {
+            roots_.push_back(node);
+            ready.push_back(node);
+        }
+    }
+    size_t reached = 0;
+    while (!ready.empty()) {
+        const NodeId node = ready.back();
+        ready.pop_back();
+        ++reached;
+        for (NodeId successor : nodes_[node].successors_) {
+            if (--remaining[successor] == 0) {
+                ready.push_back(successor);
+            }
+        }
+    }
+    acyclic_ = reached == nodes_.size();
+    return acyclic_;
+}
+
+bool TaskGraph::run() {
+    if (!idle_.wait(0, Event::kForever) || !prepare()) {
+        return false;
+    }
+    if (nodes_.empty()) {
+        if (completion_) {
+            completion_.invoke();
+        }
+        return true;
+    }
+
+    idle_.reset();
+    skipped_.store(0, std::memory_order_relaxed);
+    for (Node& node : nodes_) {
+        node.remaining_.store(node.dependencies_, std::memory_order_relaxed);
+    }
+    // Released to the nodes by the posts below.
+    pending_.store(uint32_t(nodes_.size()), std::memory_order_relaxed);
+    for (NodeId root : roots_) {
+        dispatch(root);
+    }
+    return true;
+}
+
+void TaskGraph::wait() {
+    idle_.wait(Event::kForever, Event::kForever);
+}
+
+void TaskGraph::dispatch(NodeId node) {
+    // A NodeTask that cannot be posted finishes the node as skipped.
+    TQMgr->postTask(nodes_[node].queue_, NodeTask(this, node), nodes_[node].from_);
+}
+
+void TaskGraph::finish(NodeId node) {
+    for (NodeId successor : nodes_[node].successors_) {
+        if (nodes_[successor].remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            dispatch(successor);
+        }
+    }
+    if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        if (completion_) {
+            completion_.invoke();
+        }
+        // The graph may be run again or destroyed from here on.
+        idle_.set();
+    }
+}
+
+}
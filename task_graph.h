@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "event.h"
+#include "location.h"
+#include "task.h"
+#include "task_queue_manager.h"
+
+namespace vi {
+
+// Graph of tasks bound to TaskQueueManager queues, with edges for the
+// order in which they must run.
+//
+//   vi::TaskGraph graph;
+//   auto a = graph.addNode("io", [&]{ read(); });
+//   auto b = graph.addNode("codec", [&]{ decodeAudio(); });
+//   auto c = graph.addNode("codec", [&]{ decodeVideo(); });
+//   auto d = graph.addNode("net", [&]{ send(); });
+//   graph.addEdge(a, b);
+//   graph.addEdge(a, c);
+//   graph.addEdge(b, d);
+//   graph.addEdge(c, d);
+//   for (each frame) {
+//       graph.run();
+//       graph.wait();
+//   }
+//
+// run() posts the nodes without dependencies. Whichever thread finishes
+// the last dependency of a node posts it to its queue right away, so there
+// is no coordinating thread. The graph is built once and run any number
+// of times: a run resets one counter per node and posts tasks that fit
+// into a Task inline, so it does not allocate. Closures are kept for all
+// runs, like those of repeating tasks.
+//
+// A node whose queue does not exist when it is due, or is deleted before
+// the node ran, is skipped and its dependents run anyway, see skipped().
+// The graph must not be changed or destroyed while it runs.
+class TaskGraph {
+public:
+    using NodeId = uint32_t;
+
+    TaskGraph() = default;
+
+    // Waits for a run in progress.
+    ~TaskGraph();
+
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    // Adds a node that runs |closure| on the queue named |queue|. The queue
+    // only has to exist while the graph runs. TraceLog records the posts of
+    // the node as coming from |from|.
+    template <class Closure>
+    NodeId addNode(TaskQueueManager::Handle queue, Closure&& closure, const Location& from = Location::current()) {
+        return addTaskNode(queue, Task(std::forward<Closure>(closure)), from);
+    }
+
+    template <class Closure>
+    NodeId addNode(std::string_view queue, Closure&& closure, const Location& from = Location::current()) {
+        return addTaskNode(TQMgr->handle(queue), Task(std::forward<Closure>(closure)), from);
+    }
+
+    // Makes |after| wait for |before| to finish.
+    void addEdge(NodeId before, NodeId after);
+
+    // Sets |closure| to run at the end of every run, on the thread that
+    // finished the last node, before wait() returns.
+    template <class Closure>
+    void onComplete(Closure&& closure) {
+        setCompletion(Task(std::forward<Closure>(closure)));
+    }
+
+    // Starts a run. Returns false if the previous run has not finished or
+    // the edges form a cycle.
+    bool run();
+
+    // Blocks until the current run, if any, finished.
+    void wait();
+
+    size_t size() const { return nodes_.size(); }
+
+    // Nodes skipped in the current or last run because their queue did
+    // not exist.
+    uint32_t skipped() const { return skipped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Node {
+        Node(TaskQueueManager::Handle queue, Task task, const Location& from) : queue_(queue), task_(std::move(task)), from_(from) {}
+
+        const TaskQueueManager::Handle queue_;
+
+        Task task_;
+
+        const Location from_;
+
+        std::vector<NodeId> successors_;
+
+        uint32_t dependencies_ {0};
+
+        // Dependencies yet to finish in the current run.
+        std::atomic<uint32_t> remaining_ {0};
+    };
+
+    // The task posted for a node. Finishes the node as skipped when it is
+    // destroyed without running.
+    class NodeTask {
+    public:
+        NodeTask(TaskGraph* graph, NodeId node) : graph_(graph), node_(node) {}
+
+        NodeTask(NodeTask&& other) noexcept
+            : graph_(std::exchange(other.graph_, nullptr)), node_(other.node_) {}
+
+        ~NodeTask();
+
+        void operator()();
+
+    private:
+        TaskGraph* graph_;
+
+        const NodeId node_;
+    };
+
+    NodeId addTaskNode(TaskQueueManager::Handle queue, Task task, const Location& from);
+
+    void setCompletion(Task task);
+
+    // Finds the nodes without dependencies and checks for cycles.
+    bool prepare();
+
+    void dispatch(NodeId node);
+
+    void finish(NodeId node);
+
+    // Deque for the atomics, which cannot move.
+    std::deque<Node> nodes_;
+
+    std::vector<NodeId> roots_;
+
+    // |roots_| is out of date.
+    bool changed_ {true};
+
+    // The edges form no cycle, valid unless |changed_|.
+    bool acyclic_ {false};
+
+    Task completion_;
+
+    // Nodes of the current run yet to finish.
+    std::atomic<uint32_t> pending_ {0};
+
+    std::atomic<uint32_t> skipped_ {0};
+
+    // Signaled while the graph is not running.
+    Event idle_ {/*manual_reset=*/true, /*initially_signaled=*/true};
+};
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+namespace vi {
+
+// Lane of a task within its queue. Tasks of the same priority run in FIFO
+// order. Whenever a queue picks its next task it takes, in this order:
+//
+//   1. a low priority task that was passed over too often, see
+//      TaskQueueOptions::low_priority_starvation_limit_,
+//   2. the oldest high priority task,
+//   3. the oldest of the normal priority tasks and the delayed tasks that are
+//      due, by posting order,
+//   4. the oldest low priority task.
+//
+// Delayed tasks thus behave like normal priority tasks posted at the time of
+// the postDelayedTask() call that become eligible at their fire time.
+enum class TaskPriority {
+    kHigh,
+    kNormal,
+    kLow,
+};
+
+constexpr int kTaskPriorityCount = 3;
+
+}
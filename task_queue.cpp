@@ -1,9 +1,52 @@
 #include "task_queue.h"
 #include "task_queue_base.h"
+#include "task_queue_io.h"
+#include "task_queue_pooled.h"
+#include "task_queue_simulated.h"
 #include "task_queue_std.h"
 
 namespace vi {
 
+namespace {
+
+// Records the run of |task_|, and of the post it came from while tracing
+// was on. Repeating tasks and fd callbacks run through invoke(), so only
+// their first run carries the flow of the post.
+class TracedTask {
+public:
+    TracedTask(Task task, const char* queue, uint64_t flow, const Location& from, bool once)
+        : task_(std::move(task)), queue_(queue), flow_(flow), from_(from), once_(once) {}
+
+    void operator()() {
+        const int64_t start = TraceLog::nanoseconds();
+        if (once_) {
+            task_.run();
+        }
+        else {
+            task_.invoke();
+        }
+        TraceLog::run(queue_, std::exchange(flow_, 0), from_, start);
+    }
+
+private:
+    Task task_;
+
+    const char* const queue_;
+
+    uint64_t flow_;
+
+    const Location from_;
+
+    const bool once_;
+};
+
+void traceTask(Task& task, const char* queue, BlockPool* pool, const Location& from, bool once) {
+    const uint64_t flow = TraceLog::post(queue, from);
+    task = Task(TracedTask(std::move(task), queue, flow, from, once), pool);
+}
+
+}
+
 TaskQueue::TaskQueue(std::unique_ptr<TaskQueueBase, TaskQueueDeleter> taskQueue)
     : impl_(taskQueue.release()) {}
 
@@ -19,16 +62,159 @@ bool TaskQueue::isCurrent() const {
     return impl_->isCurrent();
 }
 
-void TaskQueue::postTask(std::unique_ptr<QueuedTask> task) {
+void TaskQueue::postTask(std::unique_ptr<QueuedTask> task, const Location& from) {
+    if (TraceLog::enabled()) {
+        return postTask(Task(std::move(task)), from);
+    }
+    return impl_->postTask(std::move(task));
+}
+
+void TaskQueue::postTask(Task task, const Location& from) {
+    if (TraceLog::enabled()) {
+        trace(task, from);
+    }
     return impl_->postTask(std::move(task));
 }
 
-void TaskQueue::postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t milliseconds) {
+void TaskQueue::postTask(std::unique_ptr<QueuedTask> task, TaskPriority priority, const Location& from) {
+    return postTask(Task(std::move(task)), priority, from);
+}
+
+void TaskQueue::postTask(Task task, TaskPriority priority, const Location& from) {
+    if (TraceLog::enabled()) {
+        trace(task, from);
+    }
+    return impl_->postTask(std::move(task), priority);
+}
+
+PostResult TaskQueue::tryPostTask(std::unique_ptr<QueuedTask> task, TaskPriority priority, const Location& from) {
+    return tryPostTask(Task(std::move(task)), priority, from);
+}
+
+PostResult TaskQueue::tryPostTask(Task task, TaskPriority priority, const Location& from) {
+    if (TraceLog::enabled()) {
+        trace(task, from);
+    }
+    return impl_->tryPostTask(std::move(task), priority);
+}
+
+PostResult TaskQueue::postCoalescedTask(uint64_t key, Task task, std::chrono::microseconds delay, const Location& from) {
+    if (TraceLog::enabled()) {
+        trace(task, from);
+    }
+    return impl_->postCoalescedTask(key, std::move(task), delay);
+}
+
+FdWatchHandle TaskQueue::watchFd(int fd, uint32_t events, Task task, std::shared_ptr<FdWatchState> state, const Location& from) {
+    if (TraceLog::enabled()) {
+        trace(task, from, false);
+    }
+    return impl_->watchFd(fd, events, std::move(task), std::move(state));
+}
+
+DelayedTaskHandle TaskQueue::postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t milliseconds, const Location& from) {
+    if (TraceLog::enabled()) {
+        return postDelayedTask(Task(std::move(task)), std::chrono::microseconds(std::chrono::milliseconds(milliseconds)), from);
+    }
     return impl_->postDelayedTask(std::move(task), milliseconds);
 }
 
-std::unique_ptr<TaskQueue> TaskQueue::create(std::string_view name) {
-    return std::make_unique<TaskQueue>(std::unique_ptr<TaskQueueBase, TaskQueueDeleter>(new TaskQueueSTD(name)));
+DelayedTaskHandle TaskQueue::postDelayedTask(Task task, std::chrono::microseconds delay, const Location& from) {
+    if (TraceLog::enabled()) {
+        trace(task, from);
+    }
+    return impl_->postDelayedTask(std::move(task), delay);
+}
+
+RepeatingTaskHandle TaskQueue::postRepeatingTask(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay, const Location& from) {
+    if (TraceLog::enabled()) {
+        trace(task, from, false);
+    }
+    return impl_->postRepeatingTask(std::move(task), std::move(state), delay);
+}
+
+void TaskQueue::postTasks(std::vector<Task> tasks, const Location& from) {
+    if (TraceLog::enabled()) {
+        for (auto& task : tasks) {
+            trace(task, from);
+        }
+    }
+    return impl_->postTasks(std::move(tasks));
+}
+
+void TaskQueue::postDelayedTasks(std::vector<std::pair<Task, std::chrono::microseconds>> tasks, const Location& from) {
+    if (TraceLog::enabled()) {
+        for (auto& task : tasks) {
+            trace(task.first, from);
+        }
+    }
+    return impl_->postDelayedTasks(std::move(tasks));
+}
+
+TaskQueueStats TaskQueue::stats() const {
+    return impl_->stats();
+}
+
+bool TaskQueue::bounded() const {
+    return impl_->bounded();
+}
+
+BlockPool* TaskQueue::closurePool() {
+    return impl_->closurePool();
+}
+
+void TaskQueue::postReply(TaskQueueBase* queue, Task task, const Location& from) {
+    if (TraceLog::enabled()) {
+        traceTask(task, TraceLog::intern(queue->name()), queue->closurePool(), from, true);
+    }
+    queue->postTask(std::move(task));
+}
+
+BlockPool* TaskQueue::replyPool(TaskQueueBase* queue) {
+    return queue->closurePool();
+}
+
+DelayedTaskHandle TaskQueue::postDelayedTaskMicroseconds(std::unique_ptr<QueuedTask> task, std::chrono::microseconds delay, const Location& from) {
+    if (TraceLog::enabled()) {
+        return postDelayedTask(Task(std::move(task)), delay, from);
+    }
+    return impl_->postDelayedTask(std::move(task), delay);
+}
+
+void TaskQueue::trace(Task& task, const Location& from, bool once) {
+    traceTask(task, traceName(), impl_->closurePool(), from, once);
+}
+
+const char* TaskQueue::traceName() const {
+    const char* name = trace_name_.load(std::memory_order_acquire);
+    if (!name) {
+        // Racing threads intern the same copy.
+        name = TraceLog::intern(impl_->name());
+        trace_name_.store(name, std::memory_order_release);
+    }
+    return name;
+}
+
+std::unique_ptr<TaskQueue> TaskQueue::create(std::string_view name, const TaskQueueOptions& options) {
+    TaskQueueBase* impl = nullptr;
+    switch (options.type_) {
+    case TaskQueueType::kPooled:
+        impl = new TaskQueuePooled(name, options);
+        break;
+    case TaskQueueType::kSimulated:
+        impl = new TaskQueueSimulated(name, options);
+        break;
+#if defined(__linux__)
+    case TaskQueueType::kIO:
+        impl = new TaskQueueIO(name, options);
+        break;
+#endif
+    case TaskQueueType::kDedicatedThread:
+    default:
+        impl = new TaskQueueSTD(name, options);
+        break;
+    }
+    return std::make_unique<TaskQueue>(std::unique_ptr<TaskQueueBase, TaskQueueDeleter>(impl));
 }
 
 }
@@ -2,9 +2,26 @@
 
 #include <stdint.h>
 
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <optional>
 #include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "delayed_task_handle.h"
+#include "event.h"
+#include "fd_watch.h"
+#include "location.h"
 #include "queued_task.h"
+#include "repeating_task.h"
+#include "task.h"
+#include "task_priority.h"
+#include "task_queue_options.h"
+#include "task_queue_stats.h"
+#include "trace_log.h"
 
 
 namespace vi {
@@ -27,7 +44,8 @@ namespace vi {
 //     ...
 //
 //   2) Posting a custom task on a timer.  The task posts itself again after
-//      every running:
+//      every running (postRepeatingTask() does the same without drift and
+//      without a round trip through the queue for every period):
 //
 //     class TimerTask : public QueuedTask {
 //      public:
@@ -64,7 +82,7 @@ public:
     explicit TaskQueue(std::unique_ptr<TaskQueueBase, TaskQueueDeleter> taskQueue);
     ~TaskQueue();
 
-    static std::unique_ptr<TaskQueue> create(std::string_view name);
+    static std::unique_ptr<TaskQueue> create(std::string_view name, const TaskQueueOptions& options = TaskQueueOptions());
 
     // Used for DCHECKing the current queue.
     bool isCurrent() const;
@@ -72,41 +90,320 @@ public:
     // Returns non-owning pointer to the task queue implementation.
     TaskQueueBase* get() { return impl_; }
 
-    // TODO(tommi): For better debuggability, implement RTC_FROM_HERE.
+    // See TaskQueueBase::stats().
+    TaskQueueStats stats() const;
+
+    // See TaskQueueBase::bounded().
+    bool bounded() const;
+
+    // Every post takes the Location of its caller as the last argument,
+    // which TraceLog records with the post and the run while tracing is on.
+    // Pass VI_FROM_HERE or a Location of your own to attribute the post to
+    // somewhere else, e.g. the caller of a helper that posts.
 
     // Ownership of the task is passed to PostTask.
-    void postTask(std::unique_ptr<QueuedTask> task);
+    void postTask(std::unique_ptr<QueuedTask> task, const Location& from = Location::current());
+
+    void postTask(Task task, const Location& from = Location::current());
+
+    // Posts into the lane of |priority|: a kHigh task overtakes every pending
+    // task of lower priority, which keeps control messages from queueing
+    // behind bulk work. See TaskPriority for the exact rules.
+    void postTask(std::unique_ptr<QueuedTask> task, TaskPriority priority, const Location& from = Location::current());
+
+    void postTask(Task task, TaskPriority priority, const Location& from = Location::current());
+
+    // Posts like postTask() but reports what a bounded queue did with the
+    // task, see TaskQueueOptions::max_pending_tasks_. postTask() applies the
+    // same overflow policy and ignores the result. A task that is not
+    // posted is destroyed without running; wrap it with ToQueuedTask(closure,
+    // cleanup) to release resources that a closure alone does not own.
+    PostResult tryPostTask(std::unique_ptr<QueuedTask> task, TaskPriority priority = TaskPriority::kNormal, const Location& from = Location::current());
+
+    PostResult tryPostTask(Task task, TaskPriority priority = TaskPriority::kNormal, const Location& from = Location::current());
 
     // Schedules a task to execute a specified number of milliseconds from when
     // the call is made. The precision should be considered as "best effort"
     // and in some cases, such as on Windows when all high precision timers have
     // been used up, can be off by as much as 15 millseconds (although 8 would be
     // more likely). This can be mitigated by limiting the use of delayed tasks.
-    void postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t milliseconds);
+    // The returned handle cancels the task, see DelayedTaskHandle::cancel().
+    DelayedTaskHandle postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t milliseconds, const Location& from = Location::current());
 
+    // Schedules a task to execute after |delay| as measured by the monotonic
+    // clock, with microsecond precision on queues that support it. Use this
+    // for short periodic work (e.g. pacing) where millisecond rounding and
+    // wall-clock jumps are not acceptable.
+    template <class Rep, class Period>
+    DelayedTaskHandle postDelayedTask(std::unique_ptr<QueuedTask> task, std::chrono::duration<Rep, Period> delay, const Location& from = Location::current()) {
+        return postDelayedTaskMicroseconds(std::move(task), std::chrono::ceil<std::chrono::microseconds>(delay), from);
+    }
+
+    // Returns a handle that cancels the task if it has not run yet, see
+    // DelayedTaskHandle::cancel(). Cancelling frees the closure right away,
+    // which suits timeouts that are usually cancelled well before they fire.
+    DelayedTaskHandle postDelayedTask(Task task, std::chrono::microseconds delay, const Location& from = Location::current());
+
+    // Posts a whole batch with a single lock acquisition and a single wakeup
+    // of the worker. The tasks get consecutive positions in the FIFO order
+    // on every queue type TaskQueue::create() makes, see
+    // TaskQueueBase::postTasks().
+    void postTasks(std::vector<Task> tasks, const Location& from = Location::current());
+
+    void postDelayedTasks(std::vector<std::pair<Task, std::chrono::microseconds>> tasks, const Location& from = Location::current());
+
+    // Wraps |closure| into a Task backed by this queue's closure pool, for
+    // building batches.
+    template <class Closure>
+    Task makeTask(Closure&& closure) {
+        return Task(std::forward<Closure>(closure), closurePool());
+    }
 
     // std::enable_if is used here to make sure that calls to PostTask() with
     // std::unique_ptr<SomeClassDerivedFromQueuedTask> would not end up being
     // caught by this template.
+    //
+    // Closures are wrapped into a Task, which stores small closures inline and
+    // bigger ones in the queue's closure pool, so posting a lambda normally
+    // does not allocate.
+    template <class Closure, typename std::enable_if<!std::is_convertible<Closure, std::unique_ptr<QueuedTask>>::value>::type* = nullptr>
+    void postTask(Closure&& closure, const Location& from = Location::current()) {
+        postTask(Task(std::forward<Closure>(closure), closurePool()), from);
+    }
+
     template <class Closure, typename std::enable_if<!std::is_convertible<Closure, std::unique_ptr<QueuedTask>>::value>::type* = nullptr>
-    void postTask(Closure&& closure) {
-        postTask(ToQueuedTask(std::forward<Closure>(closure)));
+    void postTask(Closure&& closure, TaskPriority priority, const Location& from = Location::current()) {
+        postTask(Task(std::forward<Closure>(closure), closurePool()), priority, from);
+    }
+
+    template <class Closure, typename std::enable_if<!std::is_convertible<Closure, std::unique_ptr<QueuedTask>>::value
+                                                     && !std::is_same<typename std::decay<Closure>::type, Task>::value>::type* = nullptr>
+    PostResult tryPostTask(Closure&& closure, TaskPriority priority = TaskPriority::kNormal, const Location& from = Location::current()) {
+        return tryPostTask(Task(std::forward<Closure>(closure), closurePool()), priority, from);
+    }
+
+    // Posts |closure| under |key| unless a task posted under |key| is still
+    // pending, in which case |closure| takes its place and kReplaced is
+    // returned: a storm of posts for the same key runs once, with the last
+    // closure, in the queue position of the first post. Replaced closures
+    // are destroyed without running. Once the task started, the next post
+    // queues it again. Keys are per queue, e.g. an id or the address of the
+    // object to refresh, and cost a hash lookup. A Task or QueuedTask may
+    // be passed instead of a closure.
+    template <class Closure>
+    PostResult postCoalescedTask(uint64_t key, Closure&& closure, const Location& from = Location::current()) {
+        return postCoalescedTask(key, Task(std::forward<Closure>(closure), closurePool()), std::chrono::microseconds(0), from);
+    }
+
+    // Like postCoalescedTask(), but the task runs |delay| after the last
+    // post under |key|: every post within the delay replaces the pending
+    // closure and starts the delay over. Posts that keep coming faster than
+    // |delay| hold the task back for as long as they do. Using a key for
+    // both calls is allowed; a coalesced post then keeps the pending delay.
+    template <class Closure, class Rep, class Period>
+    PostResult postDebouncedTask(uint64_t key, Closure&& closure, std::chrono::duration<Rep, Period> delay, const Location& from = Location::current()) {
+        return postCoalescedTask(key, Task(std::forward<Closure>(closure), closurePool()), std::chrono::ceil<std::chrono::microseconds>(delay), from);
     }
 
     // See documentation above for performance expectations.
     template <class Closure, typename std::enable_if<!std::is_convertible<Closure, std::unique_ptr<QueuedTask>>::value>::type* = nullptr>
-    void postDelayedTask(Closure&& closure, uint32_t milliseconds) {
-        postDelayedTask(ToQueuedTask(std::forward<Closure>(closure)),  milliseconds);
+    DelayedTaskHandle postDelayedTask(Closure&& closure, uint32_t milliseconds, const Location& from = Location::current()) {
+        return postDelayedTask(Task(std::forward<Closure>(closure), closurePool()), std::chrono::microseconds(std::chrono::milliseconds(milliseconds)), from);
+    }
+
+    template <class Closure, class Rep, class Period, typename std::enable_if<!std::is_convertible<Closure, std::unique_ptr<QueuedTask>>::value>::type* = nullptr>
+    DelayedTaskHandle postDelayedTask(Closure&& closure, std::chrono::duration<Rep, Period> delay, const Location& from = Location::current()) {
+        return postDelayedTask(Task(std::forward<Closure>(closure), closurePool()), std::chrono::ceil<std::chrono::microseconds>(delay), from);
+    }
+
+    // Runs |closure| every |period|, the first time one period from now.
+    // Deadlines are absolute: the n-th run is due n periods after the post
+    // no matter how long the runs take. A late run is made up for right
+    // away, but deadlines missed by a whole period are skipped. The task
+    // keeps its closure and, with the timing wheel or the ordered map, its
+    // timer entry for all runs.
+    //
+    // |closure| may return a std::chrono::duration, which replaces the
+    // period from the deadline of this run to the next one, or
+    // kStopRepeating to end. The returned handle stops the task from any
+    // thread.
+    template <class Closure, class Rep, class Period>
+    RepeatingTaskHandle postRepeatingTask(Closure&& closure, std::chrono::duration<Rep, Period> period, const Location& from = Location::current()) {
+        return postRepeatingTask(std::forward<Closure>(closure), period, period, from);
+    }
+
+    // Same as above with the first run after |delay|.
+    template <class Closure, class Rep, class Period, class DelayRep, class DelayPeriod>
+    RepeatingTaskHandle postRepeatingTask(Closure&& closure, std::chrono::duration<Rep, Period> period, std::chrono::duration<DelayRep, DelayPeriod> delay,
+                                          const Location& from = Location::current()) {
+        auto state = std::make_shared<RepeatingTaskState>();
+        state->interval_us_ = std::chrono::ceil<std::chrono::microseconds>(period).count();
+        Task task([state, closure = std::forward<Closure>(closure)]() mutable {
+            if constexpr (std::is_void<decltype(closure())>::value) {
+                closure();
+            }
+            else {
+                state->interval_us_ = std::chrono::ceil<std::chrono::microseconds>(closure()).count();
+            }
+        }, closurePool());
+        return postRepeatingTask(std::move(task), std::move(state), std::chrono::ceil<std::chrono::microseconds>(delay), from);
     }
 
+    // Calls |closure| on this queue whenever |fd| is ready for |events|, a
+    // combination of FdEvents, until the returned handle is stopped. Watches
+    // are level triggered unless kFdEdgeTriggered is given: the closure is
+    // called again after every round of tasks for as long as |fd| stays
+    // ready. |closure| may take the uint32_t FdEvents that are ready, which
+    // may include kFdError and kFdHangUp. Tasks and callbacks take turns, so
+    // neither can starve the other. Only kIO queues watch descriptors; the
+    // others, and a kIO queue that fails to add |fd|, e.g. because it is
+    // watched already, return an invalid handle.
+    template <class Closure>
+    FdWatchHandle watchFd(int fd, uint32_t events, Closure&& closure, const Location& from = Location::current()) {
+        auto state = std::make_shared<FdWatchState>();
+        state->fd_ = fd;
+        // The queue keeps |state| alive for as long as it keeps the task.
+        Task task([ready = &state->ready_events_, closure = std::forward<Closure>(closure)]() mutable {
+            if constexpr (std::is_invocable<decltype(closure)&, uint32_t>::value) {
+                closure(*ready);
+            }
+            else {
+                closure();
+            }
+        }, closurePool());
+        return watchFd(fd, events, std::move(task), std::move(state), from);
+    }
+
+    // Runs |closure| on this queue and returns its result, blocking the
+    // calling thread until it has run. The posted task only refers to the
+    // closure, the result and an Event on the caller's stack, so the call
+    // does not allocate. Called from a task of this queue, |closure| runs
+    // right away instead of deadlocking; two queues invoking each other
+    // still deadlock, and so does a pooled queue invoking on another queue
+    // of its ThreadPool when no other worker is free. A bounded queue that
+    // turns the task away or drops it gets it posted again. The queue must
+    // not be deleted while a call waits.
+    template <class Closure>
+    auto invoke(Closure&& closure, const Location& from = Location::current()) -> decltype(closure()) {
+        using Result = decltype(closure());
+        static_assert(!std::is_reference<Result>::value, "invoke() returns by value");
+        if (isCurrent()) {
+            return closure();
+        }
+        if constexpr (std::is_void<Result>::value) {
+            invokeAndWait([&closure]{ closure(); }, from);
+        }
+        else {
+            std::optional<Result> result;
+            invokeAndWait([&closure, &result]{ result.emplace(closure()); }, from);
+            return std::move(*result);
+        }
+    }
+
+    // Runs |task| on this queue, then posts |reply| to |replyQueue|. When
+    // |task| returns a value it is moved into the reply task and from there
+    // into |reply|, so there is no shared state to allocate. |replyQueue|
+    // must outlive the task.
+    template <class TaskClosure, class ReplyClosure>
+    void postTaskAndReply(TaskClosure&& task, TaskQueueBase* replyQueue, ReplyClosure&& reply, const Location& from = Location::current()) {
+        postTask([task = std::forward<TaskClosure>(task), replyQueue, reply = std::forward<ReplyClosure>(reply), from]() mutable {
+            if constexpr (std::is_void<decltype(task())>::value) {
+                task();
+                postReply(replyQueue, Task(std::move(reply), replyPool(replyQueue)), from);
+            }
+            else {
+                postReply(replyQueue, Task([reply = std::move(reply), result = task()]() mutable {
+                    reply(std::move(result));
+                }, replyPool(replyQueue)), from);
+            }
+        }, from);
+    }
+
+    template <class TaskClosure, class ReplyClosure>
+    void postTaskAndReply(TaskClosure&& task, TaskQueue* replyQueue, ReplyClosure&& reply, const Location& from = Location::current()) {
+        postTaskAndReply(std::forward<TaskClosure>(task), replyQueue->get(), std::forward<ReplyClosure>(reply), from);
+    }
 
 private:
+    // Task posted by invoke(). Signals |done_| when it is destroyed, whether
+    // it ran or was turned away by a bounded queue.
+    template <class Function>
+    class InvokeTask {
+    public:
+        InvokeTask(Function* function, Event* done, bool* ran) : function_(function), done_(done), ran_(ran) {}
+
+        InvokeTask(InvokeTask&& other) noexcept
+            : function_(other.function_), done_(std::exchange(other.done_, nullptr)), ran_(other.ran_) {}
+
+        ~InvokeTask() {
+            if (done_) {
+                done_->set();
+            }
+        }
+
+        void operator()() {
+            (*function_)();
+            *ran_ = true;
+        }
+
+    private:
+        Function* const function_;
+
+        Event* done_;
+
+        bool* const ran_;
+    };
+
+    template <class Function>
+    void invokeAndWait(Function function, const Location& from) {
+        Event done;
+        bool ran = false;
+        while (true) {
+            tryPostTask(Task(InvokeTask<Function>(&function, &done, &ran)), TaskPriority::kNormal, from);
+            done.wait(Event::kForever);
+            if (ran) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    BlockPool* closurePool();
+
+    PostResult postCoalescedTask(uint64_t key, Task task, std::chrono::microseconds delay, const Location& from);
+
+    FdWatchHandle watchFd(int fd, uint32_t events, Task task, std::shared_ptr<FdWatchState> state, const Location& from);
+
+    // For postTaskAndReply(), which only sees TaskQueueBase declared.
+    static void postReply(TaskQueueBase* queue, Task task, const Location& from);
+
+    static BlockPool* replyPool(TaskQueueBase* queue);
+
+    RepeatingTaskHandle postRepeatingTask(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay, const Location& from);
+
+    DelayedTaskHandle postDelayedTaskMicroseconds(std::unique_ptr<QueuedTask> task, std::chrono::microseconds delay, const Location& from);
+
+    // Wraps |task| to record its post and run while tracing is on. |once|
+    // is false for tasks that run more than once, which get no flow.
+    void trace(Task& task, const Location& from, bool once = true);
+
+    const char* traceName() const;
+
     TaskQueue& operator=(const TaskQueue&) = delete;
     TaskQueue(const TaskQueue&) = delete;
 
 private:
     TaskQueueBase* const impl_;
 
+    // Interned name of |impl_| for TraceLog, looked up on first use.
+    mutable std::atomic<const char*> trace_name_ {nullptr};
+
+    friend class TaskQueueManager;
+
+    // Posts of TaskQueueManager::postTask() that run outside of their read
+    // section. The manager does not delete the queue while there are any.
+    std::atomic<uint32_t> manager_pins_ {0};
+
 };
 
 }
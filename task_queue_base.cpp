@@ -1,4 +1,6 @@
 #include "task_queue_base.h"
+#include <algorithm>
+#include <limits>
 #include <thread>
 
 namespace vi {
@@ -7,12 +9,111 @@ namespace {
 
 thread_local TaskQueueBase* _current = nullptr;
 
+// Adapts a Task to the QueuedTask interface for queues that only accept
+// QueuedTasks.
+class TaskAdapter final : public QueuedTask {
+public:
+    explicit TaskAdapter(Task task) : task_(std::move(task)) {}
+
+private:
+    bool run() override {
+        task_.run();
+        return true;
+    }
+
+    Task task_;
+};
+
+// Repeating task for queues without native support: reposts itself as a
+// delayed task after every run.
+class RepostingTask final : public QueuedTask {
+public:
+    RepostingTask(Task task, std::shared_ptr<RepeatingTaskState> state)
+        : task_(std::move(task))
+        , state_(std::move(state)) {}
+
+private:
+    bool run() override {
+        if (state_->stopped_.load(std::memory_order_acquire)) {
+            return true;
+        }
+        task_.invoke();
+        const int64_t interval = state_->interval_us_;
+        if (interval == kStopRepeating.count() || state_->stopped_.load(std::memory_order_acquire)) {
+            return true;
+        }
+        TaskQueueBase::current()->postDelayedTask(std::unique_ptr<QueuedTask>(this), std::chrono::microseconds(std::max<int64_t>(interval, 0)));
+        return false;
+    }
+
+    Task task_;
+
+    std::shared_ptr<RepeatingTaskState> state_;
+};
+
 }  // namespace
 
 TaskQueueBase* TaskQueueBase::current() {
     return _current;
 }
 
+DelayedTaskHandle TaskQueueBase::postDelayedTask(std::unique_ptr<QueuedTask> task, std::chrono::microseconds delay) {
+    const int64_t ms = std::chrono::ceil<std::chrono::milliseconds>(delay).count();
+    return postDelayedTask(std::move(task), static_cast<uint32_t>(std::clamp<int64_t>(ms, 0, std::numeric_limits<uint32_t>::max())));
+}
+
+void TaskQueueBase::postTask(Task task) {
+    postTask(std::make_unique<TaskAdapter>(std::move(task)));
+}
+
+void TaskQueueBase::postTask(Task task, TaskPriority) {
+    postTask(std::move(task));
+}
+
+PostResult TaskQueueBase::tryPostTask(Task task, TaskPriority priority) {
+    postTask(std::move(task), priority);
+    return PostResult::kPosted;
+}
+
+PostResult TaskQueueBase::postCoalescedTask(uint64_t, Task task, std::chrono::microseconds delay) {
+    if (delay.count() > 0) {
+        postDelayedTask(std::move(task), delay);
+        return PostResult::kPosted;
+    }
+    return tryPostTask(std::move(task), TaskPriority::kNormal);
+}
+
+DelayedTaskHandle TaskQueueBase::postDelayedTask(Task task, std::chrono::microseconds delay) {
+    return postDelayedTask(std::make_unique<TaskAdapter>(std::move(task)), delay);
+}
+
+RepeatingTaskHandle TaskQueueBase::postRepeatingTask(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay) {
+    postDelayedTask(std::make_unique<RepostingTask>(std::move(task), state), delay);
+    return RepeatingTaskHandle(nullptr, std::move(state));
+}
+
+FdWatchHandle TaskQueueBase::watchFd(int, uint32_t, Task, std::shared_ptr<FdWatchState>) {
+    return FdWatchHandle();
+}
+
+void TaskQueueBase::postTasks(std::vector<Task> tasks) {
+    for (auto& task : tasks) {
+        postTask(std::move(task));
+    }
+}
+
+void TaskQueueBase::postDelayedTasks(std::vector<std::pair<Task, std::chrono::microseconds>> tasks) {
+    for (auto& task : tasks) {
+        postDelayedTask(std::move(task.first), task.second);
+    }
+}
+
+TaskQueueStats TaskQueueBase::stats() const {
+    TaskQueueStats result;
+    result.name_ = name();
+    return result;
+}
+
 TaskQueueBase::CurrentTaskQueueSetter::CurrentTaskQueueSetter(TaskQueueBase* taskQueue)
     : _previous(_current) {
     _current = taskQueue;
@@ -1,13 +1,24 @@
 #pragma once
 
+#include <stdint.h>
+#include <chrono>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+#include "delayed_task_handle.h"
+#include "fd_watch.h"
 #include "queued_task.h"
+#include "repeating_task.h"
+#include "task.h"
+#include "task_priority.h"
+#include "task_queue_options.h"
+#include "task_queue_stats.h"
 
 namespace vi {
 
 // Asynchronously executes tasks in a way that guarantees that they're executed
-// in FIFO order and that tasks never overlap. Tasks may always execute on the
+// in FIFO order, per TaskPriority, and that tasks never overlap. Tasks may always execute on the
 // same worker thread and they may not. To DCHECK that tasks are executing on a
 // known task queue, use IsCurrent().
 class TaskQueueBase {
@@ -36,8 +47,78 @@ public:
     // Schedules a task to execute a specified number of milliseconds from when
     // the call is made. The precision should be considered as "best effort"
     // and in some cases, such as on Windows when all high precision timers have
-    // been used up, can be off by as much as 15 millseconds.
-    virtual void postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t milliseconds) = 0;
+    // been used up, can be off by as much as 15 millseconds. Returns a handle
+    // to cancel the task with, an empty one if the queue cannot cancel.
+    virtual DelayedTaskHandle postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t milliseconds) = 0;
+
+    // Same as above with microsecond resolution. The delay is measured on the
+    // monotonic clock, so wall-clock adjustments do not move the fire time.
+    // The default implementation rounds the delay up to whole milliseconds
+    // for queues without a high precision timer.
+    virtual DelayedTaskHandle postDelayedTask(std::unique_ptr<QueuedTask> task, std::chrono::microseconds delay);
+
+    // Task based variants of the above, used by TaskQueue for closures.
+    // Queues that store Tasks natively avoid a heap allocation per post; the
+    // default implementations wrap the Task into a QueuedTask.
+    virtual void postTask(Task task);
+
+    // Returns a handle to cancel the delayed task with. The default
+    // implementation wraps |task| and returns the handle of the QueuedTask
+    // variant.
+    virtual DelayedTaskHandle postDelayedTask(Task task, std::chrono::microseconds delay);
+
+    // Runs |task| after |delay| and from then on every |state->interval_us_|
+    // until stopped, see TaskQueue::postRepeatingTask(). The default
+    // implementation reposts the task after every run, relative to the end
+    // of the run.
+    virtual RepeatingTaskHandle postRepeatingTask(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay);
+
+    // Schedules |task| in the lane of |priority|, see TaskPriority. Queues
+    // without lanes run every task in FIFO order, which the default
+    // implementation does by ignoring |priority|.
+    virtual void postTask(Task task, TaskPriority priority);
+
+    // Like postTask(task, priority), but reports whether a bounded queue
+    // took the task, see OverflowPolicy. Queues without limits always
+    // return kPosted, which is what the default implementation does.
+    virtual PostResult tryPostTask(Task task, TaskPriority priority);
+
+    // Schedules |task| under |key| after |delay|, or replaces the task that
+    // is still pending under |key| and returns kReplaced, see
+    // TaskQueue::postCoalescedTask(). The default implementation does not
+    // coalesce and posts every task.
+    virtual PostResult postCoalescedTask(uint64_t key, Task task, std::chrono::microseconds delay);
+
+    // Invokes |task| on the queue whenever |fd| is ready for |events|, see
+    // TaskQueue::watchFd(), until stopped through the returned handle. Only
+    // queues that wait on file descriptors support it; the default
+    // implementation destroys |task| and returns an invalid handle.
+    virtual FdWatchHandle watchFd(int fd, uint32_t events, Task task, std::shared_ptr<FdWatchState> state);
+
+    // Schedules every task of |tasks| in order. Queues may take their lock
+    // and wake their worker only once for the whole batch. The queues built
+    // on TaskQueueCore also keep the batch together, as if postTask() had
+    // been called for each task without any other post in between. The
+    // default implementation simply loops over postTask(), so posts of other
+    // threads may end up between the tasks.
+    virtual void postTasks(std::vector<Task> tasks);
+
+    // Batch version of postDelayedTask(). Tasks that end up with the same fire
+    // time run in the order they have in |tasks|.
+    virtual void postDelayedTasks(std::vector<std::pair<Task, std::chrono::microseconds>> tasks);
+
+    // Pool for closures too big for Task's inline storage, or nullptr to use
+    // the heap. The pool must outlive every task posted to this queue.
+    virtual BlockPool* closurePool() { return nullptr; }
+
+    // True if the queue has a limit, see TaskQueueOptions::max_pending_tasks_,
+    // so that a post may block or destroy the task it turns away. The
+    // default implementation has none.
+    virtual bool bounded() const { return false; }
+
+    // Snapshot of the queue's counters, may be called from any thread. The
+    // default implementation only fills in the name.
+    virtual TaskQueueStats stats() const;
 
     // Returns the task queue that is running the current thread.
     // Returns nullptr if this thread is not associated with any task queue.
@@ -0,0 +1,589 @@
+#include "task_queue_core.h"
+#include <algorithm>
+#include <utility>
+
+namespace vi {
+
+namespace {
+
+// Closures up to this size are taken from the per-queue pool when they do
+// not fit inline into a Task.
+const size_t kPooledClosureSize = 256;
+
+// Nodes of coalesced task entries kept for reuse.
+const size_t kMaxSpareCoalescedNodes = 64;
+
+uint64_t sampleMask(uint32_t interval) {
+    if (interval == 0) {
+        return ~uint64_t(0);
+    }
+    uint64_t mask = 0;
+    while (mask + 1 < interval) {
+        mask = (mask << 1) | 1;
+    }
+    return mask;
+}
+
+}  // namespace
+
+class TaskQueueCore::Canceler final : public DelayedTaskCanceler {
+public:
+    explicit Canceler(TaskQueueCore* core) : core_(core) {}
+
+    bool cancel(const DelayedEntryTimeout& timeout, uint64_t id) override {
+        // The removed task is destroyed while the core is known to be alive,
+        // since its closure may live in the core's pool. Recursive, because
+        // the destructors of what the closure captured may cancel more tasks.
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        if (!core_) {
+            return false;
+        }
+        Task task = core_->cancelDelayed(timeout, id);
+        return static_cast<bool>(task);
+    }
+
+    void stop(RepeatingTaskState& state) override {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        if (!core_) {
+            return;
+        }
+        Task task = core_->stopRepeating(state);
+    }
+
+    void detach() {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        core_ = nullptr;
+    }
+
+private:
+    std::recursive_mutex mutex_;
+
+    TaskQueueCore* core_;
+};
+
+class TaskQueueCore::CoalescedRun {
+public:
+    CoalescedRun(TaskQueueCore* core, uint64_t key) : core_(core), key_(key) {}
+
+    CoalescedRun(CoalescedRun&& other) noexcept : core_(std::exchange(other.core_, nullptr)), key_(other.key_) {}
+
+    ~CoalescedRun() {
+        if (core_) {
+            core_->abandonCoalesced(key_);
+        }
+    }
+
+    void operator()() {
+        std::exchange(core_, nullptr)->runCoalesced(key_);
+    }
+
+private:
+    TaskQueueCore* core_;
+
+    const uint64_t key_;
+};
+
+TaskQueueCore::TaskQueueCore(const TaskQueueOptions& options)
+    : clock_(options.type_ == TaskQueueType::kSimulated ? options.simulated_clock_ : nullptr)
+    , closure_pool_(kPooledClosureSize)
+    , incoming_pool_(sizeof(IncomingTask))
+    , lock_free_submission_(options.lock_free_submission_)
+    , low_priority_starvation_limit_(options.low_priority_starvation_limit_)
+    , delayed_queue_(DelayedTaskQueue::create(options.delayed_queue_type_))
+    , canceler_(std::make_shared<Canceler>(this))
+    , max_pending_tasks_(options.max_pending_tasks_)
+    , max_pending_bytes_(options.max_pending_bytes_)
+    , overflow_policy_(options.overflow_policy_)
+    , sample_mask_(sampleMask(options.metrics_sample_interval_)) {
+}
+
+TaskQueueCore::~TaskQueueCore() {
+    // Handles that outlive the queue fail to cancel from now on.
+    canceler_->detach();
+
+    // Tasks that were still in flight in the submission queue are deleted
+    // together with |pending_queues_|.
+    std::unique_lock<std::mutex> lock(pending_mutex_);
+    drainIncomingTasks();
+}
+
+PostResult TaskQueueCore::push(Task task, TaskPriority priority, bool mayBlock) {
+    if (bounded()) {
+        const PostResult result = admit(1, pendingBytes(task), priority, mayBlock);
+        if (result != PostResult::kPosted) {
+            return result;
+        }
+    }
+
+    if (lock_free_submission_) {
+        auto incoming = new (incoming_pool_.allocate()) IncomingTask();
+        incoming->order_ = thread_posting_order_.fetch_add(1, std::memory_order_relaxed);
+        incoming->posted_at_ns_ = postTime(incoming->order_);
+        incoming->priority_ = priority;
+        incoming->task_ = std::move(task);
+        incoming_queue_.push(incoming);
+    }
+    else {
+        std::unique_lock<std::mutex> lock(pending_mutex_);
+        OrderId order = thread_posting_order_.fetch_add(1, std::memory_order_relaxed);
+
+        lane(priority).push(PendingTask{order, postTime(order), std::move(task)});
+    }
+    return PostResult::kPosted;
+}
+
+PostResult TaskQueueCore::admit(uint64_t count, uint64_t bytes, TaskPriority priority, bool mayBlock) {
+    if (reserve(count, bytes)) {
+        return PostResult::kPosted;
+    }
+
+    switch (overflow_policy_) {
+    case OverflowPolicy::kBlock:
+        if (!mayBlock) {
+            pending_tasks_.fetch_add(count, std::memory_order_seq_cst);
+            pending_bytes_.fetch_add(bytes, std::memory_order_seq_cst);
+            return PostResult::kPosted;
+        }
+        {
+            std::unique_lock<std::mutex> lock(space_mutex_);
+            space_waiters_.fetch_add(1, std::memory_order_seq_cst);
+            space_condition_.wait(lock, [this, count, bytes]{ return reserve(count, bytes); });
+            space_waiters_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return PostResult::kPosted;
+    case OverflowPolicy::kFail:
+        rejected_count_.fetch_add(count, std::memory_order_relaxed);
+        return PostResult::kRejected;
+    case OverflowPolicy::kDropOldest:
+        while (Task dropped = dropOldest(priority)) {
+            // Destroyed here, outside of |pending_mutex_|, since its cleanup
+            // may post again.
+            dropped.reset();
+            if (reserve(count, bytes)) {
+                return PostResult::kPosted;
+            }
+        }
+        break;
+    case OverflowPolicy::kDropNewest:
+        break;
+    }
+    rejected_count_.fetch_add(count, std::memory_order_relaxed);
+    return PostResult::kDropped;
+}
+
+bool TaskQueueCore::reserve(uint64_t count, uint64_t bytes) {
+    // Loads are sequentially consistent to pair with release(): a blocked
+    // producer either sees the room it frees or is seen waiting.
+    uint64_t tasks = pending_tasks_.load(std::memory_order_seq_cst);
+    do {
+        if (tasks != 0 && max_pending_tasks_ != 0 && tasks + count > max_pending_tasks_) {
+            return false;
+        }
+    } while (!pending_tasks_.compare_exchange_weak(tasks, tasks + count, std::memory_order_seq_cst, std::memory_order_seq_cst));
+
+    uint64_t used = pending_bytes_.load(std::memory_order_seq_cst);
+    do {
+        if (tasks != 0 && max_pending_bytes_ != 0 && used + bytes > max_pending_bytes_) {
+            // No need to wake anyone: the queue is not empty, so whoever
+            // failed meanwhile is woken when a task is taken.
+            pending_tasks_.fetch_sub(count, std::memory_order_seq_cst);
+            return false;
+        }
+    } while (!pending_bytes_.compare_exchange_weak(used, used + bytes, std::memory_order_seq_cst, std::memory_order_seq_cst));
+    return true;
+}
+
+void TaskQueueCore::release(uint64_t count, uint64_t bytes) {
+    pending_tasks_.fetch_sub(count, std::memory_order_seq_cst);
+    pending_bytes_.fetch_sub(bytes, std::memory_order_seq_cst);
+    if (space_waiters_.load(std::memory_order_seq_cst) != 0) {
+        std::lock_guard<std::mutex> lock(space_mutex_);
+        space_condition_.notify_all();
+    }
+}
+
+Task TaskQueueCore::dropOldest(TaskPriority priority) {
+    std::unique_lock<std::mutex> lock(pending_mutex_);
+    if (lock_free_submission_) {
+        drainIncomingTasks();
+    }
+    for (int index = kTaskPriorityCount - 1; index >= static_cast<int>(priority); --index) {
+        auto& lane = pending_queues_[index];
+        if (lane.size() > 0) {
+            Task task = std::move(lane.front().task_);
+            lane.pop();
+            dropped_count_.store(dropped_count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            release(1, pendingBytes(task));
+            return task;
+        }
+    }
+    return Task();
+}
+
+DelayedTaskHandle TaskQueueCore::pushDelayed(Task task, std::chrono::microseconds delay) {
+    auto fire_at = nowUs() + std::max<int64_t>(delay.count(), 0);
+
+    DelayedEntryTimeout timeout;
+    timeout.next_fire_at_us_ = fire_at;
+
+    std::unique_lock<std::mutex> lock(pending_mutex_);
+    timeout.order_ = thread_posting_order_.fetch_add(1, std::memory_order_relaxed) + 1;
+    const uint64_t id = delayed_queue_->push(timeout, std::move(task));
+    delayed_count_.store(delayed_queue_->size(), std::memory_order_relaxed);
+    return DelayedTaskHandle(canceler_, timeout, id);
+}
+
+Task TaskQueueCore::cancelDelayed(const DelayedEntryTimeout& timeout, uint64_t id) {
+    std::unique_lock<std::mutex> lock(pending_mutex_);
+    Task task = delayed_queue_->erase(timeout, id);
+    if (task) {
+        cancelled_count_.store(cancelled_count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        delayed_count_.store(delayed_queue_->size(), std::memory_order_relaxed);
+    }
+    return task;
+}
+
+RepeatingTaskHandle TaskQueueCore::pushRepeating(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay) {
+    const int64_t deadline = nowUs() + std::max<int64_t>(delay.count(), 0);
+
+    std::unique_lock<std::mutex> lock(pending_mutex_);
+    state->deadline_us_ = deadline;
+    pushRepeatingLocked(std::move(task), *state);
+    return RepeatingTaskHandle(canceler_, std::move(state));
+}
+
+void TaskQueueCore::pushRepeatingLocked(Task task, RepeatingTaskState& state) {
+    // Every run counts as a post of its own, which keeps the posted, run
+    // and pending counters consistent.
+    state.timeout_.next_fire_at_us_ = state.deadline_us_;
+    state.timeout_.order_ = thread_posting_order_.fetch_add(1, std::memory_order_relaxed) + 1;
+    state.timeout_.repeating_ = &state;
+    state.id_ = delayed_queue_->push(state.timeout_, std::move(task));
+    state.queued_ = true;
+    delayed_count_.store(delayed_queue_->size(), std::memory_order_relaxed);
+}
+
+void TaskQueueCore::runRepeating(Task task) {
+    RepeatingTaskState& state = *repeating_;
+    repeating_ = nullptr;
+
+    task.invoke();
+    if (dequeued_at_ns_) {
+        run_time_.record(nanoseconds() - dequeued_at_ns_);
+    }
+
+    const int64_t interval = state.interval_us_;
+    if (interval == kStopRepeating.count() || state.stopped_.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    // Deadlines advance from the previous deadline rather than from the end
+    // of the run, so the schedule does not drift. A late run is followed by
+    // the next one right away, but deadlines that are a whole interval in
+    // the past are skipped rather than run back to back.
+    int64_t deadline = state.deadline_us_ + std::max<int64_t>(interval, 0);
+    const int64_t now = nowUs();
+    if (interval > 0 && now - deadline >= interval) {
+        deadline += (now - deadline) / interval * interval;
+    }
+
+    std::unique_lock<std::mutex> lock(pending_mutex_);
+    // Checked again under the mutex, which stopRepeating() takes after
+    // setting the flag.
+    if (state.stopped_.load(std::memory_order_relaxed)) {
+        lock.unlock();
+        return;
+    }
+    state.deadline_us_ = deadline;
+    pushRepeatingLocked(std::move(task), state);
+}
+
+Task TaskQueueCore::stopRepeating(RepeatingTaskState& state) {
+    std::unique_lock<std::mutex> lock(pending_mutex_);
+    if (!state.queued_) {
+        // Running right now; runRepeating() checks |stopped_| under
+        // |pending_mutex_| after the run and drops it.
+        return Task();
+    }
+    state.queued_ = false;
+    Task task = delayed_queue_->erase(state.timeout_, state.id_);
+    if (task) {
+        cancelled_count_.store(cancelled_count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        delayed_count_.store(delayed_queue_->size(), std::memory_order_relaxed);
+    }
+    return task;
+}
+
+PostResult TaskQueueCore::pushBatch(std::vector<Task> tasks, bool mayBlock) {
+    if (bounded()) {
+        uint64_t bytes = 0;
+        for (const auto& task : tasks) {
+            bytes += pendingBytes(task);
+        }
+        const PostResult result = admit(tasks.size(), bytes, TaskPriority::kNormal, mayBlock);
+        if (result != PostResult::kPosted) {
+            return result;
+        }
+    }
+
+    // One clock read serves the whole batch.
+    const int64_t postedAt = sample_mask_ != kNoSamples ? nanoseconds() : 0;
+    if (lock_free_submission_) {
+        // Link the batch up front and publish it with a single exchange.
+        OrderId order = thread_posting_order_.fetch_add(tasks.size(), std::memory_order_relaxed);
+        IncomingTask* first = nullptr;
+        IncomingTask* last = nullptr;
+        for (auto& task : tasks) {
+            auto incoming = new (incoming_pool_.allocate()) IncomingTask();
+            incoming->posted_at_ns_ = sampled(order) ? postedAt : 0;
+            incoming->order_ = order++;
+            incoming->task_ = std::move(task);
+            if (last) {
+                last->next_.store(incoming, std::memory_order_relaxed);
+            }
+            else {
+                first = incoming;
+            }
+            last = incoming;
+        }
+        if (first) {
+            incoming_queue_.push(first, last);
+        }
+    }
+    else {
+        std::unique_lock<std::mutex> lock(pending_mutex_);
+        OrderId order = thread_posting_order_.fetch_add(tasks.size(), std::memory_order_relaxed);
+        for (auto& task : tasks) {
+            lane(TaskPriority::kNormal).push(PendingTask{order, sampled(order) ? postedAt : 0, std::move(task)});
+            ++order;
+        }
+    }
+    return PostResult::kPosted;
+}
+
+void TaskQueueCore::pushDelayedBatch(std::vector<std::pair<Task, std::chrono::microseconds>> tasks) {
+    const auto now = nowUs();
+
+    std::unique_lock<std::mutex> lock(pending_mutex_);
+    OrderId order = thread_posting_order_.fetch_add(tasks.size(), std::memory_order_relaxed) + 1;
+    for (auto& task : tasks) {
+        DelayedEntryTimeout timeout;
+        timeout.next_fire_at_us_ = now + std::max<int64_t>(task.second.count(), 0);
+        timeout.order_ = order++;
+        delayed_queue_->push(timeout, std::move(task.first));
+    }
+    delayed_count_.store(delayed_queue_->size(), std::memory_order_relaxed);
+}
+
+PostResult TaskQueueCore::pushCoalesced(uint64_t key, Task task, std::chrono::microseconds delay, bool mayBlock) {
+    const int64_t due = delay.count() > 0 ? nowUs() + delay.count() : 0;
+    {
+        std::unique_lock<std::mutex> lock(coalesced_mutex_);
+        auto it = coalesced_tasks_.find(key);
+        if (it != coalesced_tasks_.end()) {
+            std::swap(it->second.task_, task);
+            if (due != 0) {
+                it->second.due_us_ = due;
+            }
+            coalesced_count_.fetch_add(1, std::memory_order_relaxed);
+            lock.unlock();
+            // |task| now holds the replaced one, destroyed outside of the
+            // lock since its destructor may post again.
+            return PostResult::kReplaced;
+        }
+        if (spare_coalesced_nodes_.empty()) {
+            coalesced_tasks_.emplace(key, CoalescedTask{std::move(task), due});
+        }
+        else {
+            auto node = std::move(spare_coalesced_nodes_.back());
+            spare_coalesced_nodes_.pop_back();
+            node.key() = key;
+            node.mapped().task_ = std::move(task);
+            node.mapped().due_us_ = due;
+            coalesced_tasks_.insert(std::move(node));
+        }
+    }
+
+    // If a bounded queue turns the run away, destroying it removes the entry.
+    Task run(CoalescedRun(this, key));
+    if (delay.count() > 0) {
+        pushDelayed(std::move(run), delay);
+        return PostResult::kPosted;
+    }
+    return push(std::move(run), TaskPriority::kNormal, mayBlock);
+}
+
+void TaskQueueCore::runCoalesced(uint64_t key) {
+    Task task;
+    int64_t wait_us = 0;
+    {
+        std::lock_guard<std::mutex> lock(coalesced_mutex_);
+        auto it = coalesced_tasks_.find(key);
+        if (it == coalesced_tasks_.end()) {
+            return;
+        }
+        const int64_t due = it->second.due_us_;
+        const int64_t now = due != 0 ? nowUs() : 0;
+        if (due > now) {
+            wait_us = due - now;
+        }
+        else {
+            task = eraseCoalesced(it);
+        }
+    }
+
+    if (wait_us > 0) {
+        // Replaced within the debounce delay. Runs on the queue's thread,
+        // which looks at the delayed tasks before it sleeps again.
+        pushDelayed(Task(CoalescedRun(this, key)), std::chrono::microseconds(wait_us));
+        return;
+    }
+    // A post with the same key from now on queues a new entry, which runs
+    // after this one.
+    task.run();
+}
+
+void TaskQueueCore::abandonCoalesced(uint64_t key) {
+    Task task;
+    std::lock_guard<std::mutex> lock(coalesced_mutex_);
+    auto it = coalesced_tasks_.find(key);
+    if (it != coalesced_tasks_.end()) {
+        task = eraseCoalesced(it);
+    }
+    // Unlocked before |task| is destroyed.
+}
+
+Task TaskQueueCore::eraseCoalesced(CoalescedMap::iterator it) {
+    Task task = std::move(it->second.task_);
+    auto node = coalesced_tasks_.extract(it);
+    if (spare_coalesced_nodes_.size() < kMaxSpareCoalescedNodes) {
+        spare_coalesced_nodes_.push_back(std::move(node));
+    }
+    return task;
+}
+
+Task TaskQueueCore::next(int64_t now, int64_t& sleepUntilUs) {
+    sleepUntilUs = 0;
+
+    std::unique_lock<std::mutex> lock(pending_mutex_);
+
+    if (lock_free_submission_) {
+        drainIncomingTasks();
+    }
+
+    const DelayedEntryTimeout* delay_info = nullptr;
+    if (!delayed_queue_->empty()) {
+        delay_info = delayed_queue_->front(now);
+        if (!delay_info) {
+            sleepUntilUs = delayed_queue_->nextFireTime();
+        }
+    }
+
+    auto& low = lane(TaskPriority::kLow);
+    const bool lowWaiting = low.size() > 0;
+    if (lowWaiting && low_priority_starvation_limit_ && low_priority_skips_ >= low_priority_starvation_limit_) {
+        low_priority_skips_ = 0;
+        return take(low);
+    }
+
+    Task task;
+    auto& high = lane(TaskPriority::kHigh);
+    auto& normal = lane(TaskPriority::kNormal);
+    if (high.size() > 0) {
+        task = take(high);
+    }
+    else if (normal.size() > 0 && (!delay_info || normal.front().order_ < delay_info->order_)) {
+        task = take(normal);
+    }
+    else if (delay_info) {
+        // A delayed task has waited since its fire time, which is on the
+        // clock of nowUs(): virtual time for kSimulated queues, so the
+        // delay is measured there too.
+        willRun(0);
+        if (sampled(delay_info->order_)) {
+            dequeued_at_ns_ = nanoseconds();
+            queueing_delay_.record((nowUs() - delay_info->next_fire_at_us_) * 1000);
+        }
+        if (delay_info->repeating_) {
+            repeating_ = delay_info->repeating_;
+            repeating_->queued_ = false;
+        }
+        task = delayed_queue_->pop();
+        delayed_count_.store(delayed_queue_->size(), std::memory_order_relaxed);
+    }
+    else if (lowWaiting) {
+        low_priority_skips_ = 0;
+        return take(low);
+    }
+    else {
+        return Task();
+    }
+
+    if (lowWaiting) {
+        ++low_priority_skips_;
+    }
+    return task;
+}
+
+Task TaskQueueCore::take(RingBuffer<PendingTask>& lane) {
+    auto& entry = lane.front();
+    willRun(entry.posted_at_ns_);
+    Task task = std::move(entry.task_);
+    lane.pop();
+    if (bounded()) {
+        release(1, pendingBytes(task));
+    }
+    return task;
+}
+
+void TaskQueueCore::willRun(int64_t postedAtNs) {
+    const uint64_t run = run_count_.load(std::memory_order_relaxed);
+    const uint64_t pending = thread_posting_order_.load(std::memory_order_relaxed) - run -
+                             cancelled_count_.load(std::memory_order_relaxed) - dropped_count_.load(std::memory_order_relaxed);
+    if (pending > max_pending_.load(std::memory_order_relaxed)) {
+        max_pending_.store(pending, std::memory_order_relaxed);
+    }
+    run_count_.store(run + 1, std::memory_order_relaxed);
+
+    repeating_ = nullptr;
+    dequeued_at_ns_ = 0;
+    if (postedAtNs) {
+        dequeued_at_ns_ = nanoseconds();
+        queueing_delay_.record(dequeued_at_ns_ - postedAtNs);
+    }
+}
+
+void TaskQueueCore::stats(TaskQueueStats& stats) const {
+    stats.run_ = run_count_.load(std::memory_order_relaxed);
+    stats.cancelled_ = cancelled_count_.load(std::memory_order_relaxed);
+    stats.dropped_ = dropped_count_.load(std::memory_order_relaxed);
+    stats.rejected_ = rejected_count_.load(std::memory_order_relaxed);
+    stats.coalesced_ = coalesced_count_.load(std::memory_order_relaxed);
+    stats.posted_ = std::max(thread_posting_order_.load(std::memory_order_relaxed), stats.run_ + stats.cancelled_ + stats.dropped_);
+    stats.pending_ = stats.posted_ - stats.run_ - stats.cancelled_ - stats.dropped_;
+    stats.pending_bytes_ = pending_bytes_.load(std::memory_order_relaxed);
+    stats.delayed_ = std::min<uint64_t>(delayed_count_.load(std::memory_order_relaxed), stats.pending_);
+    stats.max_pending_ = max_pending_.load(std::memory_order_relaxed);
+    if (sample_mask_ != kNoSamples) {
+        stats.queueing_delay_ = queueing_delay_.snapshot();
+        stats.run_time_ = run_time_.snapshot();
+    }
+}
+
+void TaskQueueCore::drainIncomingTasks() {
+    while (IncomingTask* incoming = incoming_queue_.pop()) {
+        lane(incoming->priority_).push(PendingTask{incoming->order_, incoming->posted_at_ns_, std::move(incoming->task_)});
+        incoming->~IncomingTask();
+        incoming_pool_.deallocate(incoming);
+    }
+}
+
+int64_t TaskQueueCore::nanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t TaskQueueCore::microseconds() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
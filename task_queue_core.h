@@ -0,0 +1,322 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "block_pool.h"
+#include "delayed_task_handle.h"
+#include "delayed_task_queue.h"
+#include "latency_histogram.h"
+#include "mpsc_queue.h"
+#include "repeating_task.h"
+#include "ring_buffer.h"
+#include "simulated_clock.h"
+#include "task.h"
+#include "task_priority.h"
+#include "task_queue_options.h"
+#include "task_queue_stats.h"
+
+namespace vi {
+
+// Pending and delayed tasks of a single task queue together with the rules
+// that pick the next task to run. The task queue implementations only add
+// the threading on top: any thread may push, while next() is called by
+// whichever thread currently runs the queue's tasks, one at a time.
+class TaskQueueCore {
+public:
+    explicit TaskQueueCore(const TaskQueueOptions& options);
+    ~TaskQueueCore();
+
+    TaskQueueCore(const TaskQueueCore&) = delete;
+    TaskQueueCore& operator=(const TaskQueueCore&) = delete;
+
+    // Queues |task| unless the queue is full, see OverflowPolicy. A task
+    // that is turned away is destroyed without running. |mayBlock| is
+    // false for posts from the queue's own tasks, which kBlock lets exceed
+    // the limits rather than deadlock.
+    PostResult push(Task task, TaskPriority priority = TaskPriority::kNormal, bool mayBlock = true);
+
+    DelayedTaskHandle pushDelayed(Task task, std::chrono::microseconds delay);
+
+    // Adds the repeating task |task| with its first deadline |delay| from
+    // now. |state->interval_us_| must be set. See run() for the rest.
+    RepeatingTaskHandle pushRepeating(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay);
+
+    // Like push() for all of |tasks| at once: the batch is accepted or
+    // turned away as a whole.
+    PostResult pushBatch(std::vector<Task> tasks, bool mayBlock = true);
+
+    void pushDelayedBatch(std::vector<std::pair<Task, std::chrono::microseconds>> tasks);
+
+    // Queues |task| under |key| to run after |delay|, or takes the place of
+    // the task already pending under |key| and returns kReplaced. A
+    // replacement with a non-zero |delay| also holds the task back until
+    // |delay| from now, which makes it a trailing edge debounce. Keys are looked up
+    // in a hash table and an entry is queued once however often it is
+    // replaced, so a bounded queue counts it as a single task. Returns
+    // kPosted when a new entry was queued, which needs a wakeup.
+    PostResult pushCoalesced(uint64_t key, Task task, std::chrono::microseconds delay, bool mayBlock = true);
+
+    // Returns the task to run at time |now| following the rules
+    // of TaskPriority, or an empty Task if nothing is due. |sleepUntilUs|
+    // receives the next fire time of the delayed tasks if none of them is
+    // due, 0 otherwise.
+    Task next(int64_t now, int64_t& sleepUntilUs);
+
+    // Runs |task|, which was returned by next(), and records its run time if
+    // it is sampled. A repeating task goes back into the delayed queue
+    // afterwards, as the same entry where the backend allows.
+    void run(Task task) {
+        if (repeating_) {
+            runRepeating(std::move(task));
+            return;
+        }
+        if (!dequeued_at_ns_) {
+            task.run();
+            return;
+        }
+        task.run();
+        run_time_.record(nanoseconds() - dequeued_at_ns_);
+    }
+
+    // Fills in the counters and histograms of |stats|, but not the name.
+    // May be called from any thread.
+    void stats(TaskQueueStats& stats) const;
+
+    BlockPool* closurePool() { return &closure_pool_; }
+
+    // True if the options set a limit on the pending tasks.
+    bool bounded() const { return max_pending_tasks_ != 0 || max_pending_bytes_ != 0; }
+
+    // Current time of the monotonic clock in microseconds. Deadlines of
+    // kSimulated queues are on the time of their SimulatedClock instead.
+    static int64_t microseconds();
+
+    static int64_t nanoseconds();
+
+private:
+    using OrderId = uint64_t;
+
+    // DelayedTaskCanceler of the queue, detached when the core is destroyed.
+    class Canceler;
+
+    // Node of the lock-free submission queue, see |incoming_queue_|. Nodes
+    // live in |incoming_pool_|.
+    struct IncomingTask {
+        std::atomic<IncomingTask*> next_{nullptr};
+        OrderId order_{};
+        int64_t posted_at_ns_{};
+        TaskPriority priority_{TaskPriority::kNormal};
+        Task task_;
+    };
+
+    struct PendingTask {
+        OrderId order_{};
+        // Monotonic post time for sampled tasks, 0 otherwise.
+        int64_t posted_at_ns_{};
+        Task task_;
+    };
+
+    // Time the deadlines of delayed tasks are measured on.
+    int64_t nowUs() const { return clock_ ? clock_->microseconds() : microseconds(); }
+
+    bool sampled(OrderId order) const {
+        return sample_mask_ != kNoSamples && (order & sample_mask_) == 0;
+    }
+
+    int64_t postTime(OrderId order) const { return sampled(order) ? nanoseconds() : 0; }
+
+    // Bookkeeping for a task that next() is about to return. |postedAtNs| is
+    // 0 for tasks that are not sampled.
+    void willRun(int64_t postedAtNs);
+
+    // Pops the front task of |lane| for next().
+    Task take(RingBuffer<PendingTask>& lane);
+
+    RingBuffer<PendingTask>& lane(TaskPriority priority) { return pending_queues_[static_cast<int>(priority)]; }
+
+    // Removes a delayed task for Canceler and returns it for destruction
+    // outside of |pending_mutex_|.
+    Task cancelDelayed(const DelayedEntryTimeout& timeout, uint64_t id);
+
+    // run() for repeating tasks: runs |task| without consuming it, then
+    // schedules it for its next deadline or destroys it if it was stopped.
+    void runRepeating(Task task);
+
+    // Links a repeating task into |delayed_queue_| at |state.deadline_us_|.
+    // Must be called with |pending_mutex_| held.
+    void pushRepeatingLocked(Task task, RepeatingTaskState& state);
+
+    // Removes a stopped repeating task for Canceler if it is queued.
+    Task stopRepeating(RepeatingTaskState& state);
+
+    // Task queued for an entry of |coalesced_tasks_|, see pushCoalesced().
+    class CoalescedRun;
+
+    struct CoalescedTask {
+        Task task_;
+        // Monotonic time before which the task must not run, 0 for none.
+        int64_t due_us_ {0};
+    };
+
+    using CoalescedMap = std::unordered_map<uint64_t, CoalescedTask>;
+
+    // Runs the task of |key| for CoalescedRun, or queues the run again if
+    // a replacement moved the fire time.
+    void runCoalesced(uint64_t key);
+
+    // Removes the entry of |key| when its CoalescedRun is destroyed without
+    // running, e.g. turned away by a bounded queue or left at destruction.
+    void abandonCoalesced(uint64_t key);
+
+    // Takes the entry of |it| out of |coalesced_tasks_| and returns its task.
+    // Must be called with |coalesced_mutex_| held.
+    Task eraseCoalesced(CoalescedMap::iterator it);
+
+    // Moves every task that is visible in |incoming_queue_| to the back of
+    // its lane. Must be called with |pending_mutex_| held.
+    void drainIncomingTasks();
+
+    // Estimated memory held by |task| while it is pending.
+    static uint64_t pendingBytes(const Task& task) { return sizeof(PendingTask) + task.heapSize(); }
+
+    // Makes room for |count| tasks of |bytes| in a bounded queue following
+    // the overflow policy. Returns kPosted once the room is reserved.
+    PostResult admit(uint64_t count, uint64_t bytes, TaskPriority priority, bool mayBlock);
+
+    // Reserves room for |count| tasks of |bytes| if it is within the limits
+    // or the queue is empty.
+    bool reserve(uint64_t count, uint64_t bytes);
+
+    // Returns room taken by reserve() and wakes blocked producers.
+    void release(uint64_t count, uint64_t bytes);
+
+    // Removes the oldest pending task of |priority| or lower, starting with
+    // the lowest priority lane, for OverflowPolicy::kDropOldest. Returns an
+    // empty Task if there is none.
+    Task dropOldest(TaskPriority priority);
+
+private:
+    // Set for kSimulated queues, see nowUs().
+    const SimulatedClock* const clock_;
+
+    // Storage for closures that do not fit into a Task and for the nodes of
+    // |incoming_queue_|. Declared before the queues so that it outlives the
+    // tasks they hold.
+    BlockPool closure_pool_;
+
+    BlockPool incoming_pool_;
+
+    // Tasks posted with a key, see pushCoalesced(). Exactly one CoalescedRun
+    // is queued for every entry. Declared before the queues, since the runs
+    // they still hold look up their entries when destroyed.
+    std::mutex coalesced_mutex_;
+
+    CoalescedMap coalesced_tasks_;
+
+    // Nodes of entries that ran, kept to insert new keys without allocating.
+    std::vector<CoalescedMap::node_type> spare_coalesced_nodes_;
+
+    // Posts that replaced a pending task, see TaskQueueStats::coalesced_.
+    std::atomic<uint64_t> coalesced_count_ {0};
+
+    std::mutex pending_mutex_;
+
+    // Holds the next order to use for the next task to be
+    // put into one of the pending queues. Atomic because lock-free
+    // submission assigns orders without holding |pending_mutex_|.
+    std::atomic<OrderId> thread_posting_order_ {};
+
+    // Set once at construction, see TaskQueueOptions::lock_free_submission_.
+    const bool lock_free_submission_;
+
+    // Pending tasks by TaskPriority, each lane in FIFO order.
+    RingBuffer<PendingTask> pending_queues_[kTaskPriorityCount];
+
+    // See TaskQueueOptions::low_priority_starvation_limit_.
+    const uint32_t low_priority_starvation_limit_;
+
+    // Tasks next() picked while the low lane was waiting. Only touched with
+    // |pending_mutex_| held.
+    uint32_t low_priority_skips_ {0};
+
+    // With lock-free submission, push() appends here without taking
+    // |pending_mutex_|; next() moves the tasks over to their lanes before it
+    // picks a task. Since producers take their order before
+    // pushing, FIFO ordering against |delayed_queue_| is kept for every post
+    // that has returned.
+    MpscQueue<IncomingTask> incoming_queue_;
+
+    // The list of all pending tasks that need to be processed at a future
+    // time based upon a delay. On the off change the delayed task should
+    // happen at exactly the same time interval as another task then the
+    // task is processed based on FIFO ordering. The backend is selected by
+    // TaskQueueOptions::delayed_queue_type_.
+    std::unique_ptr<DelayedTaskQueue> delayed_queue_;
+
+    // Size of |delayed_queue_|, readable without |pending_mutex_|.
+    std::atomic<uint64_t> delayed_count_ {0};
+
+    // Shared with the DelayedTaskHandles returned by pushDelayed().
+    const std::shared_ptr<Canceler> canceler_;
+
+    // Delayed tasks removed through a DelayedTaskHandle. Written with
+    // |pending_mutex_| held.
+    std::atomic<uint64_t> cancelled_count_ {0};
+
+    // Limits, see TaskQueueOptions::max_pending_tasks_.
+    const uint64_t max_pending_tasks_;
+
+    const uint64_t max_pending_bytes_;
+
+    const OverflowPolicy overflow_policy_;
+
+    // Room taken in a bounded queue by the tasks that are not delayed,
+    // including those still in |incoming_queue_|. Not tracked for queues
+    // without limits.
+    std::atomic<uint64_t> pending_tasks_ {0};
+
+    std::atomic<uint64_t> pending_bytes_ {0};
+
+    // Producers blocked by OverflowPolicy::kBlock wait on |space_condition_|.
+    // release() only takes |space_mutex_| if |space_waiters_| is non-zero.
+    std::atomic<uint32_t> space_waiters_ {0};
+
+    std::mutex space_mutex_;
+
+    std::condition_variable space_condition_;
+
+    std::atomic<uint64_t> dropped_count_ {0};
+
+    std::atomic<uint64_t> rejected_count_ {0};
+
+    // Metrics. |thread_posting_order_| doubles as the number of posted tasks.
+    // The rest is written by whoever calls next() and run() only, so relaxed
+    // loads and stores are enough. Timings are sampled by order, see
+    // TaskQueueOptions::metrics_sample_interval_.
+    static constexpr OrderId kNoSamples = ~OrderId(0);
+
+    const OrderId sample_mask_;
+
+    std::atomic<uint64_t> run_count_ {0};
+
+    std::atomic<uint64_t> max_pending_ {0};
+
+    LatencyHistogram queueing_delay_;
+
+    LatencyHistogram run_time_;
+
+    // When next() handed out the last task if it is sampled, otherwise 0.
+    int64_t dequeued_at_ns_ {0};
+
+    // State of the last task next() handed out if it is a repeating one.
+    RepeatingTaskState* repeating_ {nullptr};
+};
+
+}
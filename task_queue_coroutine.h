@@ -0,0 +1,345 @@
+#pragma once
+
+// C++20 coroutine support. Opt-in: the header is empty unless the compiler
+// implements coroutines, which for the qmake projects means building with
+// CONFIG+=coroutines. VI_TASK_QUEUE_COROUTINES tells whether it is available.
+//
+//   vi::CoTask<Frame> decode(Packet packet) {
+//       co_await vi::resumeOn(TQ("codec"));
+//       Frame frame = decodePacket(packet);
+//       co_await vi::sleepFor(std::chrono::milliseconds(5));
+//       co_return frame;
+//   }
+//
+//   vi::CoTask<> pipeline() {
+//       co_await vi::resumeOn(TQMgr->handle("io"));
+//       Packet packet = read();
+//       Frame frame = co_await decode(std::move(packet));
+//       co_await vi::resumeOn(TQMgr->handle("net"));
+//       send(frame);
+//   }
+//
+//   pipeline().start();
+//
+// Switching queues posts the coroutine handle itself as the task, which fits
+// into a Task inline, so a hop does not allocate. The coroutine frame is
+// allocated once per call as usual.
+//
+// A coroutine suspended on a queue resumes only by running a task of that
+// queue. If the queue is deleted first, the task is destroyed without
+// running and the coroutine never resumes, so do not delete queues that
+// coroutines are still switching to or sleeping on. A bounded queue that
+// turns the switch away makes co_await yield false instead, see
+// QueueSwitch; one with OverflowPolicy::kDropOldest may still drop the
+// resumption later to make room, which strands the coroutine the same way.
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#define VI_TASK_QUEUE_COROUTINES 1
+
+#include <assert.h>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "location.h"
+#include "rcu.h"
+#include "task.h"
+#include "task_priority.h"
+#include "task_queue.h"
+#include "task_queue_base.h"
+#include "task_queue_manager.h"
+
+namespace vi {
+
+namespace coroutine_internal {
+
+// The task posted for a suspended coroutine: nothing but its handle.
+struct Resume {
+    std::coroutine_handle<> handle_;
+
+    void operator()() const { handle_.resume(); }
+};
+
+static_assert(sizeof(Resume) <= Task::kInlineSize, "a resumption must not allocate");
+
+}
+
+// Awaitable returned by resumeOn(). Resumes the awaiting coroutine as a task
+// of the target queue, or right away if it already runs there. co_await
+// yields false, with the coroutine still on the thread that awaited, if a
+// bounded queue turns the task away, see OverflowPolicy. With kBlock the
+// switch waits for room instead, which on a kPooled queue holds a pool
+// worker for as long.
+class QueueSwitch {
+public:
+    QueueSwitch(TaskQueueBase* queue, TaskPriority priority) : queue_(queue), priority_(priority) {}
+
+    bool await_ready() const { return queue_->isCurrent(); }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        // As in NamedQueueSwitch, the awaiter may be gone once the task is
+        // posted.
+        posted_ = true;
+        if (queue_->tryPostTask(Task(coroutine_internal::Resume{handle}), priority_) != PostResult::kPosted) {
+            posted_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    bool await_resume() const { return posted_; }
+
+private:
+    TaskQueueBase* const queue_;
+
+    const TaskPriority priority_;
+
+    bool posted_ {true};
+};
+
+// Like QueueSwitch for a queue of TaskQueueManager. co_await yields false,
+// with the coroutine still on the thread that awaited, if there is no queue
+// under the name at the moment or it turns the task away.
+class NamedQueueSwitch {
+public:
+    NamedQueueSwitch(TaskQueueManager::Handle handle, TaskPriority priority, const Location& from) : handle_(handle), priority_(priority), from_(from) {}
+
+    bool await_ready() {
+        Rcu::ReadSection section;
+        TaskQueue* queue = TQMgr->queue(handle_);
+        found_ = queue != nullptr;
+        return !found_ || queue->isCurrent();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        // The coroutine may resume, and this awaiter go away, as soon as the
+        // task is posted.
+        found_ = true;
+        const Location from = from_;
+        PostResult result = PostResult::kRejected;
+        if (!TQMgr->tryPostTask(handle_, Task(coroutine_internal::Resume{handle}), priority_, result, from) || result != PostResult::kPosted) {
+            found_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    bool await_resume() const { return found_; }
+
+private:
+    const TaskQueueManager::Handle handle_;
+
+    const TaskPriority priority_;
+
+    // Post site for TraceLog.
+    const Location from_;
+
+    bool found_ {false};
+};
+
+// Awaitable returned by sleepFor(). Suspends the coroutine for |delay| on the
+// timer of the queue it runs on and resumes it there. Delayed tasks do not
+// count against the limits of a bounded queue and are never dropped, so
+// unlike a switch a sleep always resumes.
+class QueueSleep {
+public:
+    explicit QueueSleep(std::chrono::microseconds delay) : delay_(delay) {}
+
+    bool await_ready() const { return delay_.count() <= 0; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        TaskQueueBase* queue = TaskQueueBase::current();
+        assert(queue && "sleepFor() needs a coroutine running on a task queue");
+        queue->postDelayedTask(Task(coroutine_internal::Resume{handle}), delay_);
+    }
+
+    void await_resume() const {}
+
+private:
+    const std::chrono::microseconds delay_;
+};
+
+inline QueueSwitch resumeOn(TaskQueueBase* queue, TaskPriority priority = TaskPriority::kNormal) {
+    return QueueSwitch(queue, priority);
+}
+
+inline QueueSwitch resumeOn(TaskQueue* queue, TaskPriority priority = TaskPriority::kNormal) {
+    return QueueSwitch(queue->get(), priority);
+}
+
+// Resolves the queue when awaited, so the handle may be taken before the
+// queue exists. Prefer it over resumeOn(TQ(name)) on hot paths.
+inline NamedQueueSwitch resumeOn(TaskQueueManager::Handle handle, TaskPriority priority = TaskPriority::kNormal,
+                                 const Location& from = Location::current()) {
+    return NamedQueueSwitch(handle, priority, from);
+}
+
+template <class Rep, class Period>
+QueueSleep sleepFor(std::chrono::duration<Rep, Period> delay) {
+    return QueueSleep(std::chrono::ceil<std::chrono::microseconds>(delay));
+}
+
+template <typename T = void>
+class CoTask;
+
+namespace coroutine_internal {
+
+class PromiseBase {
+public:
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // Hands the thread over to the awaiting coroutine, if any, without
+    // growing the stack.
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            PromiseBase& promise = handle.promise();
+            if (promise.continuation_) {
+                return promise.continuation_;
+            }
+            if (promise.detached_) {
+                if (promise.exception_) {
+                    std::terminate();
+                }
+                handle.destroy();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { exception_ = std::current_exception(); }
+
+    void rethrow() {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+    }
+
+    std::coroutine_handle<> continuation_;
+
+    bool detached_ {false};
+
+    std::exception_ptr exception_;
+};
+
+template <typename T>
+class Promise : public PromiseBase {
+public:
+    CoTask<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U&& value) { value_.emplace(std::forward<U>(value)); }
+
+    T result() {
+        rethrow();
+        return std::move(*value_);
+    }
+
+private:
+    std::optional<T> value_;
+};
+
+template <>
+class Promise<void> : public PromiseBase {
+public:
+    CoTask<void> get_return_object() noexcept;
+
+    void return_void() {}
+
+    void result() { rethrow(); }
+};
+
+}
+
+// Lazily started coroutine producing a T. Nothing runs until the task is
+// either awaited by another coroutine or start()ed. An awaiting coroutine
+// continues on whichever queue the task finished on. Exceptions propagate
+// to the awaiting coroutine; one escaping a started task terminates.
+template <typename T>
+class [[nodiscard]] CoTask {
+public:
+    using promise_type = coroutine_internal::Promise<T>;
+
+    CoTask(CoTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+    CoTask& operator=(CoTask&& other) noexcept {
+        if (this != &other) {
+            reset();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+
+    ~CoTask() {
+        reset();
+    }
+
+    // Runs the coroutine on the calling thread up to its first suspension
+    // and lets it finish on its own. The coroutine frame is freed when it
+    // completes, and so is its result.
+    void start() && {
+        assert(handle_);
+        std::coroutine_handle<promise_type> handle = std::exchange(handle_, nullptr);
+        handle.promise().detached_ = true;
+        handle.resume();
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle_;
+
+            bool await_ready() const noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle_.promise().continuation_ = awaiting;
+                return handle_;
+            }
+
+            T await_resume() { return handle_.promise().result(); }
+        };
+        assert(handle_);
+        return Awaiter{handle_};
+    }
+
+private:
+    friend promise_type;
+
+    explicit CoTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    void reset() {
+        if (handle_) {
+            std::exchange(handle_, nullptr).destroy();
+        }
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace coroutine_internal {
+
+template <typename T>
+CoTask<T> Promise<T>::get_return_object() noexcept {
+    return CoTask<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline CoTask<void> Promise<void>::get_return_object() noexcept {
+    return CoTask<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+}
+
+}
+
+#endif
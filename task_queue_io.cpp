@@ -0,0 +1,347 @@
+#include "task_queue_io.h"
+
+#if defined(__linux__)
+
+#include <assert.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace vi {
+
+static_assert(uint32_t(kFdReadable) == EPOLLIN && uint32_t(kFdWritable) == EPOLLOUT && uint32_t(kFdError) == EPOLLERR
+              && uint32_t(kFdHangUp) == EPOLLHUP && uint32_t(kFdEdgeTriggered) == uint32_t(EPOLLET),
+              "FdEvents must match the epoll flags");
+
+namespace {
+
+// epoll data of the wakeup and the timer. Watch ids count up from 1.
+const uint64_t kWakeId = ~uint64_t(0);
+const uint64_t kTimerId = ~uint64_t(0) - 1;
+
+void addToEpoll(int epollFd, int fd, uint64_t id) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = id;
+    const int result = epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    assert(result == 0);
+    (void)result;
+}
+
+void drainFd(int fd) {
+    uint64_t value = 0;
+    while (read(fd, &value, sizeof(value)) == sizeof(value)) {
+    }
+}
+
+}  // namespace
+
+class TaskQueueIO::Canceler final : public FdWatchCanceler {
+public:
+    explicit Canceler(TaskQueueIO* queue) : queue_(queue) {}
+
+    void stop(FdWatchState& state) override {
+        // Recursive, because destroying the callback may stop more watches.
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        if (queue_) {
+            queue_->unwatch(state);
+        }
+    }
+
+    void detach() {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        queue_ = nullptr;
+    }
+
+private:
+    std::recursive_mutex mutex_;
+
+    TaskQueueIO* queue_;
+};
+
+TaskQueueIO::TaskQueueIO(std::string_view queueName, const TaskQueueOptions& options)
+    : started_(/*manual_reset=*/false, /*initially_signaled=*/false)
+    , epoll_fd_(epoll_create1(EPOLL_CLOEXEC))
+    , wake_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+    , timer_fd_(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK))
+    , canceler_(std::make_shared<Canceler>(this))
+    , core_(options)
+    , name_(queueName) {
+    assert(epoll_fd_ >= 0 && wake_fd_ >= 0 && timer_fd_ >= 0);
+    addToEpoll(epoll_fd_, wake_fd_, kWakeId);
+    addToEpoll(epoll_fd_, timer_fd_, kTimerId);
+
+    thread_ = std::thread([this, placement = options.thread_placement_]{
+        applyThreadPlacement(placement, name_);
+        CurrentTaskQueueSetter setCurrent(this);
+        this->processTasks();
+    });
+
+    started_.wait(vi::Event::kForever);
+}
+
+TaskQueueIO::~TaskQueueIO() {
+    // Handles that outlive the queue fail to stop from now on.
+    canceler_->detach();
+
+    // The callbacks may live in the closure pool of |core_|, which goes
+    // first otherwise.
+    std::unordered_map<uint64_t, Watch> watches;
+    {
+        std::lock_guard<std::mutex> lock(watch_mutex_);
+        watches.swap(watches_);
+    }
+    watches.clear();
+
+    close(timer_fd_);
+    close(wake_fd_);
+    close(epoll_fd_);
+}
+
+void TaskQueueIO::deleteThis() {
+    assert(isCurrent() == false);
+
+    thread_should_quit_.store(true, std::memory_order_release);
+
+    const uint64_t one = 1;
+    ssize_t written = write(wake_fd_, &one, sizeof(one));
+    (void)written;
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    delete this;
+}
+
+void TaskQueueIO::postTask(std::unique_ptr<QueuedTask> task) {
+    postTask(Task(std::move(task)));
+}
+
+void TaskQueueIO::postTask(Task task) {
+    tryPostTask(std::move(task), TaskPriority::kNormal);
+}
+
+void TaskQueueIO::postTask(Task task, TaskPriority priority) {
+    tryPostTask(std::move(task), priority);
+}
+
+PostResult TaskQueueIO::tryPostTask(Task task, TaskPriority priority) {
+    const PostResult result = core_.push(std::move(task), priority, !isCurrent());
+    if (result == PostResult::kPosted) {
+        notifyWake();
+    }
+    return result;
+}
+
+PostResult TaskQueueIO::postCoalescedTask(uint64_t key, Task task, std::chrono::microseconds delay) {
+    const PostResult result = core_.pushCoalesced(key, std::move(task), delay, !isCurrent());
+    if (result == PostResult::kPosted) {
+        notifyWake();
+    }
+    return result;
+}
+
+DelayedTaskHandle TaskQueueIO::postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t ms) {
+    return postDelayedTask(Task(std::move(task)), std::chrono::milliseconds(ms));
+}
+
+DelayedTaskHandle TaskQueueIO::postDelayedTask(std::unique_ptr<QueuedTask> task, std::chrono::microseconds duration) {
+    return postDelayedTask(Task(std::move(task)), duration);
+}
+
+DelayedTaskHandle TaskQueueIO::postDelayedTask(Task task, std::chrono::microseconds duration) {
+    auto handle = core_.pushDelayed(std::move(task), duration);
+
+    notifyWake();
+    return handle;
+}
+
+RepeatingTaskHandle TaskQueueIO::postRepeatingTask(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay) {
+    auto handle = core_.pushRepeating(std::move(task), std::move(state), delay);
+
+    notifyWake();
+    return handle;
+}
+
+void TaskQueueIO::postTasks(std::vector<Task> tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    if (core_.pushBatch(std::move(tasks), !isCurrent()) == PostResult::kPosted) {
+        notifyWake();
+    }
+}
+
+void TaskQueueIO::postDelayedTasks(std::vector<std::pair<Task, std::chrono::microseconds>> tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    core_.pushDelayedBatch(std::move(tasks));
+
+    notifyWake();
+}
+
+FdWatchHandle TaskQueueIO::watchFd(int fd, uint32_t events, Task task, std::shared_ptr<FdWatchState> state) {
+    uint64_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(watch_mutex_);
+        id = next_watch_id_++;
+        state->fd_ = fd;
+        state->id_ = id;
+        watches_.emplace(id, Watch{state, std::move(task)});
+    }
+
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = id;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+        Task callback;
+        std::lock_guard<std::mutex> lock(watch_mutex_);
+        auto it = watches_.find(id);
+        callback = std::move(it->second.callback_);
+        watches_.erase(it);
+        return FdWatchHandle();
+    }
+    return FdWatchHandle(canceler_, std::move(state));
+}
+
+void TaskQueueIO::unwatch(FdWatchState& state) {
+    Task callback;
+    std::lock_guard<std::mutex> lock(watch_mutex_);
+    auto it = watches_.find(state.id_);
+    if (it == watches_.end()) {
+        return;
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, state.fd_, nullptr);
+    // Empty if the callback is running; runWatch() destroys it then.
+    callback = std::move(it->second.callback_);
+    watches_.erase(it);
+    // Unlocked before |callback| is destroyed.
+}
+
+void TaskQueueIO::processTasks() {
+    started_.set();
+
+    int ran = 0;
+    while (!thread_should_quit_.load(std::memory_order_acquire)) {
+        int64_t sleepUntilUs = 0;
+        Task task = core_.next(TaskQueueCore::microseconds(), sleepUntilUs);
+
+        if (task) {
+            worker_sleeping_.store(false, std::memory_order_relaxed);
+            core_.run(std::move(task));
+            if (++ran == kMaxTasksPerPoll) {
+                // Serve the descriptors that are ready by now.
+                ran = 0;
+                poll(0);
+            }
+            continue;
+        }
+        ran = 0;
+
+        if (!worker_sleeping_.load(std::memory_order_relaxed)) {
+            // See TaskQueueSTD::processTasks().
+            worker_sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            continue;
+        }
+
+        armTimer(sleepUntilUs);
+        poll(-1);
+    }
+}
+
+void TaskQueueIO::poll(int timeoutMs) {
+    epoll_event events[kMaxEventsPerPoll];
+    const int count = epoll_wait(epoll_fd_, events, kMaxEventsPerPoll, timeoutMs);
+    for (int i = 0; i < count; ++i) {
+        const uint64_t id = events[i].data.u64;
+        if (id == kWakeId) {
+            drainFd(wake_fd_);
+        }
+        else if (id == kTimerId) {
+            drainFd(timer_fd_);
+            timer_armed_us_ = 0;
+        }
+        else {
+            runWatch(id, events[i].events);
+        }
+    }
+}
+
+void TaskQueueIO::runWatch(uint64_t id, uint32_t events) {
+    // Declared first so that it outlives the callback, which points into it.
+    std::shared_ptr<FdWatchState> state;
+    Task callback;
+    {
+        std::lock_guard<std::mutex> lock(watch_mutex_);
+        auto it = watches_.find(id);
+        if (it == watches_.end() || it->second.state_->stopped_.load(std::memory_order_acquire)) {
+            // Stopped after epoll_wait() returned.
+            return;
+        }
+        state = it->second.state_;
+        callback = std::move(it->second.callback_);
+    }
+
+    state->ready_events_ = events;
+    callback.invoke();
+
+    std::lock_guard<std::mutex> lock(watch_mutex_);
+    auto it = watches_.find(id);
+    if (it != watches_.end()) {
+        it->second.callback_ = std::move(callback);
+    }
+    // Otherwise the watch was stopped while the callback ran, and |callback|
+    // is destroyed here, after the lock is released.
+}
+
+void TaskQueueIO::armTimer(int64_t fireAtUs) {
+    if (fireAtUs == timer_armed_us_) {
+        return;
+    }
+    itimerspec spec{};
+    if (fireAtUs != 0) {
+        spec.it_value.tv_sec = fireAtUs / 1000000;
+        spec.it_value.tv_nsec = (fireAtUs % 1000000) * 1000;
+    }
+    timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+    timer_armed_us_ = fireAtUs;
+}
+
+void TaskQueueIO::notifyWake() {
+    // See TaskQueueSTD::notifyWake(); the eventfd takes the place of the
+    // Event the thread waits on there.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (worker_sleeping_.load(std::memory_order_relaxed)) {
+        const uint64_t one = 1;
+        ssize_t written = write(wake_fd_, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+BlockPool* TaskQueueIO::closurePool() {
+    return core_.closurePool();
+}
+
+bool TaskQueueIO::bounded() const {
+    return core_.bounded();
+}
+
+TaskQueueStats TaskQueueIO::stats() const {
+    TaskQueueStats result;
+    result.name_ = name_;
+    core_.stats(result);
+    return result;
+}
+
+const std::string& TaskQueueIO::name() const {
+    return name_;
+}
+
+}
+
+#endif
@@ -0,0 +1,147 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include "event.h"
+#include "fd_watch.h"
+#include "queued_task.h"
+#include "task_queue_base.h"
+#include "task_queue_core.h"
+#include "task_queue_options.h"
+
+namespace vi {
+
+// Task queue with a thread of its own that waits in epoll_wait() instead of
+// on an Event, so that it can run file descriptor callbacks as well, see
+// TaskQueue::watchFd(). Posts wake the thread through an eventfd and delayed
+// tasks through a timerfd armed for the earliest fire time. Otherwise it
+// behaves like TaskQueueSTD: tasks and callbacks run one at a time on the
+// same thread, in FIFO order per TaskPriority.
+//
+// After at most |kMaxTasksPerPoll| tasks the thread polls the descriptors
+// without waiting, so a busy queue still serves its I/O and vice versa.
+class TaskQueueIO final : public TaskQueueBase {
+public:
+    TaskQueueIO(std::string_view queueName, const TaskQueueOptions& options = TaskQueueOptions());
+    ~TaskQueueIO() override;
+
+    void deleteThis() override;
+
+    void postTask(std::unique_ptr<QueuedTask> task) override;
+
+    DelayedTaskHandle postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t milliseconds) override;
+
+    DelayedTaskHandle postDelayedTask(std::unique_ptr<QueuedTask> task, std::chrono::microseconds delay) override;
+
+    void postTask(Task task) override;
+
+    DelayedTaskHandle postDelayedTask(Task task, std::chrono::microseconds delay) override;
+
+    RepeatingTaskHandle postRepeatingTask(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay) override;
+
+    void postTask(Task task, TaskPriority priority) override;
+
+    PostResult tryPostTask(Task task, TaskPriority priority) override;
+
+    PostResult postCoalescedTask(uint64_t key, Task task, std::chrono::microseconds delay) override;
+
+    void postTasks(std::vector<Task> tasks) override;
+
+    void postDelayedTasks(std::vector<std::pair<Task, std::chrono::microseconds>> tasks) override;
+
+    FdWatchHandle watchFd(int fd, uint32_t events, Task task, std::shared_ptr<FdWatchState> state) override;
+
+    BlockPool* closurePool() override;
+
+    bool bounded() const override;
+
+    TaskQueueStats stats() const override;
+
+    const std::string& name() const override;
+
+private:
+    static const int kMaxTasksPerPoll = 64;
+
+    static const int kMaxEventsPerPoll = 64;
+
+    // FdWatchCanceler of the queue, detached when the queue is destroyed.
+    class Canceler;
+
+    struct Watch {
+        std::shared_ptr<FdWatchState> state_;
+        // Empty while the callback runs.
+        Task callback_;
+    };
+
+    void processTasks();
+
+    // Waits for descriptors, the wakeup or the timer for at most
+    // |timeoutMs|, -1 for no limit, and runs the callbacks of the ready
+    // descriptors.
+    void poll(int timeoutMs);
+
+    void runWatch(uint64_t id, uint32_t events);
+
+    // Arms |timer_fd_| for monotonic time |fireAtUs|, 0 to disarm.
+    void armTimer(int64_t fireAtUs);
+
+    // Removes |state| from the watched descriptors for Canceler.
+    void unwatch(FdWatchState& state);
+
+    void notifyWake();
+
+private:
+    // Indicates if the thread has started.
+    vi::Event started_;
+
+    int epoll_fd_ {-1};
+
+    // Written by notifyWake() while the thread waits.
+    int wake_fd_ {-1};
+
+    // Fires at the earliest delayed task, see armTimer().
+    int timer_fd_ {-1};
+
+    // Fire time |timer_fd_| is armed for, 0 if disarmed. Thread only.
+    int64_t timer_armed_us_ {0};
+
+    // True while the worker thread waits, or is about to wait, in
+    // epoll_wait(). See TaskQueueSTD::notifyWake().
+    std::atomic<bool> worker_sleeping_ {false};
+
+    // Contains the active worker thread assigned to processing tasks and
+    // descriptor callbacks.
+    std::thread thread_;
+
+    // Indicates if the worker thread needs to shutdown now.
+    std::atomic<bool> thread_should_quit_ {false};
+
+    // Watches by FdWatchState::id_, which epoll reports back; an id that
+    // is gone belongs to a watch stopped after epoll_wait() returned.
+    std::mutex watch_mutex_;
+
+    std::unordered_map<uint64_t, Watch> watches_;
+
+    uint64_t next_watch_id_ {1};
+
+    // Shared with the FdWatchHandles returned by watchFd().
+    const std::shared_ptr<Canceler> canceler_;
+
+    // Pending and delayed tasks, see TaskQueueCore.
+    TaskQueueCore core_;
+
+    std::string name_;
+};
+
+}
+
+#endif
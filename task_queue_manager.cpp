@@ -1,19 +1,18 @@
 #include "task_queue_manager.h"
+#include <assert.h>
+#include <thread>
 #include "task_queue.h"
 
 namespace vi {
 
 std::unique_ptr<TaskQueueManager>& TaskQueueManager::instance()
 {
-    static std::unique_ptr<TaskQueueManager> _instance = nullptr;
-    static std::once_flag ocf;
-    std::call_once(ocf, [](){
-        _instance.reset(new TaskQueueManager());
-    });
+    static std::unique_ptr<TaskQueueManager> _instance(new TaskQueueManager());
     return _instance;
 }
 
 TaskQueueManager::TaskQueueManager()
+    : m_names(new NameTable())
 {
 
 }
@@ -21,39 +20,180 @@ TaskQueueManager::TaskQueueManager()
 TaskQueueManager::~TaskQueueManager()
 {
     clear();
+    delete m_names.load(std::memory_order_relaxed);
+    for (auto& chunk : m_slots) {
+        delete[] chunk.load(std::memory_order_relaxed);
+    }
 }
 
-void TaskQueueManager::create(const std::vector<std::string>& nameList)
+void TaskQueueManager::create(const std::vector<std::string>& nameList, const TaskQueueOptions& options)
 {
     std::unique_lock<std::mutex> lock(m_mutex);
+    TaskQueueOptions queueOptions = options;
+    if (m_simulatedClock) {
+        queueOptions.type_ = TaskQueueType::kSimulated;
+        queueOptions.simulated_clock_ = m_simulatedClock;
+    }
+    internLocked(std::vector<std::string_view>(nameList.begin(), nameList.end()));
     for (const auto& name : nameList) {
-        if (!exist(name)) {
-            m_queueMap[name] = TaskQueue::create(name);
+        std::atomic<TaskQueue*>* queueSlot = slot(find(name));
+        if (!queueSlot->load(std::memory_order_relaxed)) {
+            queueSlot->store(TaskQueue::create(name, queueOptions).release(), std::memory_order_release);
         }
     }
 }
 
-void TaskQueueManager::clear()
+void TaskQueueManager::setSimulatedClock(SimulatedClock* clock)
 {
     std::unique_lock<std::mutex> lock(m_mutex);
-    m_queueMap.clear();
+    m_simulatedClock = clock;
 }
 
-bool TaskQueueManager::exist(const std::string& name)
+SimulatedClock* TaskQueueManager::simulatedClock()
 {
-    return (m_queueMap.find(name) != m_queueMap.end());
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_simulatedClock;
 }
 
-bool TaskQueueManager::hasQueue(const std::string& name)
+void TaskQueueManager::destroy(const std::vector<std::string>& nameList)
 {
-    std::unique_lock<std::mutex> lock(m_mutex);
-    return exist(name);
+    std::vector<TaskQueue*> queues;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (const auto& name : nameList) {
+            const uint32_t id = find(name);
+            if (id == Handle::kInvalidId) {
+                continue;
+            }
+            if (TaskQueue* taskQueue = slot(id)->exchange(nullptr, std::memory_order_acq_rel)) {
+                queues.push_back(taskQueue);
+            }
+        }
+    }
+    retire(std::move(queues));
 }
 
-TaskQueue* TaskQueueManager::queue(const std::string& name)
+void TaskQueueManager::clear()
 {
-    std::unique_lock<std::mutex> lock(m_mutex);
-    return exist(name) ? m_queueMap[name].get() : nullptr;
+    std::vector<TaskQueue*> queues;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (uint32_t id = 0; id < m_nextId; ++id) {
+            if (TaskQueue* taskQueue = slot(id)->exchange(nullptr, std::memory_order_acq_rel)) {
+                queues.push_back(taskQueue);
+            }
+        }
+    }
+    retire(std::move(queues));
+}
+
+void TaskQueueManager::retire(std::vector<TaskQueue*> queues)
+{
+    if (queues.empty()) {
+        return;
+    }
+    // Posts through postTask(Handle, ...) that found the queues are done
+    // after this, or have pinned them. Pinned posts only wait for room in
+    // the queue, which its thread keeps making. The queues are deleted
+    // without |m_mutex| held, so their last tasks may still use the manager.
+    Rcu::synchronize();
+    for (TaskQueue* taskQueue : queues) {
+        while (taskQueue->manager_pins_.load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+        delete taskQueue;
+    }
+}
+
+TaskQueueManager::Handle TaskQueueManager::handle(std::string_view name)
+{
+    uint32_t id = find(name);
+    if (id == Handle::kInvalidId) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        internLocked({name});
+        id = find(name);
+    }
+    return Handle(id);
+}
+
+uint32_t TaskQueueManager::find(std::string_view name) const
+{
+    Rcu::ReadSection section;
+    const NameTable* names = m_names.load(std::memory_order_acquire);
+    auto it = names->find(name);
+    return it != names->end() ? it->second : Handle::kInvalidId;
+}
+
+void TaskQueueManager::internLocked(const std::vector<std::string_view>& nameList)
+{
+    const NameTable* names = m_names.load(std::memory_order_relaxed);
+    std::unique_ptr<NameTable> copy;
+    for (const auto& name : nameList) {
+        if (names->find(name) != names->end() || (copy && copy->find(name) != copy->end())) {
+            continue;
+        }
+        const uint32_t id = m_nextId;
+        assert(id < kSlotsPerChunk * kMaxSlotChunks);
+        auto& chunk = m_slots[id / kSlotsPerChunk];
+        if (!chunk.load(std::memory_order_relaxed)) {
+            chunk.store(new std::atomic<TaskQueue*>[kSlotsPerChunk](), std::memory_order_release);
+        }
+        if (!copy) {
+            copy.reset(new NameTable(*names));
+        }
+        copy->emplace(std::string(name), id);
+        ++m_nextId;
+    }
+
+    if (copy) {
+        m_names.store(copy.release(), std::memory_order_release);
+        Rcu::synchronize();
+        delete names;
+    }
+}
+
+std::atomic<TaskQueue*>* TaskQueueManager::slot(uint32_t id) const
+{
+    return m_slots[id / kSlotsPerChunk].load(std::memory_order_acquire) + id % kSlotsPerChunk;
+}
+
+std::vector<TaskQueueStats> TaskQueueManager::stats()
+{
+    uint32_t count = 0;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        count = m_nextId;
+    }
+
+    std::vector<TaskQueueStats> result;
+    for (uint32_t id = 0; id < count; ++id) {
+        // One short read section per queue keeps destroy() from deleting it
+        // while its counters are copied.
+        Rcu::ReadSection section;
+        if (TaskQueue* taskQueue = queue(Handle(id))) {
+            result.push_back(taskQueue->stats());
+        }
+    }
+    return result;
+}
+
+bool TaskQueueManager::hasQueue(std::string_view name)
+{
+    return queue(name) != nullptr;
+}
+
+TaskQueue* TaskQueueManager::queue(std::string_view name)
+{
+    const uint32_t id = find(name);
+    return id != Handle::kInvalidId ? queue(Handle(id)) : nullptr;
+}
+
+TaskQueue* TaskQueueManager::queue(Handle handle)
+{
+    if (!handle.valid()) {
+        return nullptr;
+    }
+    return slot(handle.id_)->load(std::memory_order_acquire);
 }
 
 }
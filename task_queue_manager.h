@@ -1,31 +1,159 @@
 #pragma once
 
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
 #include <memory>
 #include <vector>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <mutex>
+#include "location.h"
+#include "rcu.h"
+#include "task_queue.h"
+#include "task_queue_options.h"
+#include "task_queue_stats.h"
 
 namespace vi {
 
-class TaskQueue;
-
+// Registry of named task queues.
+//
+// Lookups never take a lock. queue(name) searches an immutable snapshot of
+// the name table under an Rcu::ReadSection; adding a name publishes a
+// modified copy and frees the old one once no reader can see it anymore.
+// Hot paths should resolve a Handle once and use it from then on: a Handle
+// is an interned queue name, and resolving it is a plain array load.
+//
+// destroy() unregisters the queues first and deletes them only after every
+// read section that could have found them has ended, and every post to a
+// bounded queue that one of them pinned is done. postTask(Handle, ...) is
+// therefore safe against a concurrent destroy(). A TaskQueue* returned by
+// queue() is only valid as long as the caller knows that the queue is not
+// destroyed.
 class TaskQueueManager {
 public:
+    // Interned queue name. A Handle stays valid for the lifetime of the
+    // manager and always refers to the queue that currently has its name, so
+    // it may be taken before the queue is created and survives destroying
+    // and re-creating the queue.
+    class Handle {
+    public:
+        Handle() = default;
+
+        bool valid() const { return id_ != kInvalidId; }
+
+    private:
+        friend class TaskQueueManager;
+
+        static constexpr uint32_t kInvalidId = UINT32_MAX;
+
+        explicit Handle(uint32_t id) : id_(id) {}
+
+        uint32_t id_ {kInvalidId};
+    };
+
     static std::unique_ptr<TaskQueueManager>& instance();
 
     ~TaskQueueManager();
 
-    void create(const std::vector<std::string>& nameList);
+    // Creates the queues in |nameList| that do not exist yet, all configured
+    // with |options|. Each thread is named after its own queue unless
+    // |options.thread_placement_.name_| is set, which then names the threads
+    // of every queue in the batch; create them one by one to tell them apart.
+    void create(const std::vector<std::string>& nameList, const TaskQueueOptions& options = TaskQueueOptions());
+
+    // Simulated-time mode: while a clock is set, create() makes kSimulated
+    // queues on |clock| whatever the options ask for, so that code which
+    // creates its own queues runs on virtual time too. Queues that exist
+    // keep their type; create the queues after setting the clock. nullptr
+    // leaves the mode. The clock must outlive the queues created on it.
+    void setSimulatedClock(SimulatedClock* clock);
+
+    SimulatedClock* simulatedClock();
+
+    // Deletes the queues in |nameList| that exist. Must not be called from a
+    // task running on one of them.
+    void destroy(const std::vector<std::string>& nameList);
+
+    // Returns the handle for |name|, interning the name if needed. The queue
+    // does not have to exist.
+    Handle handle(std::string_view name);
+
+    TaskQueue* queue(std::string_view name);
+
+    TaskQueue* queue(Handle handle);
+
+    bool hasQueue(std::string_view name);
+
+    // Snapshot of the counters of every queue, in the order the names were
+    // interned. Meant for monitoring; sort by TaskQueueStats::pending_ or a
+    // percentile of queueing_delay_ to find overloaded queues.
+    std::vector<TaskQueueStats> stats();
+
+    // Posts |closure| to the queue of |handle|, returning false if there is no
+    // such queue at the moment. |from| is the post site TraceLog records,
+    // see TaskQueue.
+    template <class Closure>
+    bool postTask(Handle handle, Closure&& closure, const Location& from = Location::current()) {
+        return postTask(handle, std::forward<Closure>(closure), TaskPriority::kNormal, from);
+    }
+
+    template <class Closure>
+    bool postTask(Handle handle, Closure&& closure, TaskPriority priority, const Location& from = Location::current()) {
+        PostResult result;
+        return tryPostTask(handle, std::forward<Closure>(closure), priority, result, from);
+    }
+
+    // Like postTask(), and stores what a bounded queue did with the task in
+    // |result|, see TaskQueue::tryPostTask(). |result| is left alone if
+    // there is no queue.
+    //
+    // A bounded queue may block the post or destroy the task it turns away,
+    // and neither may happen inside the read section: the destructor of a
+    // closure, or the consumer a blocked producer waits for, may call
+    // create() or destroy(), which wait for the section to end. Such posts
+    // pin the queue and run after the section instead.
+    template <class Closure>
+    bool tryPostTask(Handle handle, Closure&& closure, TaskPriority priority, PostResult& result, const Location& from = Location::current()) {
+        TaskQueue* taskQueue = nullptr;
+        {
+            Rcu::ReadSection section;
+            taskQueue = queue(handle);
+            if (!taskQueue) {
+                return false;
+            }
+            if (!taskQueue->bounded()) {
+                result = taskQueue->tryPostTask(std::forward<Closure>(closure), priority, from);
+                return true;
+            }
+            taskQueue->manager_pins_.fetch_add(1, std::memory_order_relaxed);
+        }
+        result = taskQueue->tryPostTask(std::forward<Closure>(closure), priority, from);
+        taskQueue->manager_pins_.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    using NameTable = std::map<std::string, uint32_t, std::less<>>;
 
-    TaskQueue* queue(const std::string& name);
+    static constexpr size_t kSlotsPerChunk = 256;
 
-    bool hasQueue(const std::string& name);
+    static constexpr size_t kMaxSlotChunks = 1024;
 
-private:
     void clear();
 
-    bool exist(const std::string& name);
+    // Looks |name| up in the current name table, kInvalidId if missing.
+    uint32_t find(std::string_view name) const;
+
+    // Adds the names of |nameList| that are missing to the name table. Must
+    // be called with |m_mutex| held.
+    void internLocked(const std::vector<std::string_view>& nameList);
+
+    std::atomic<TaskQueue*>* slot(uint32_t id) const;
+
+    // Deletes |queues| once no reader can reach them anymore.
+    void retire(std::vector<TaskQueue*> queues);
 
 private:
     TaskQueueManager();
@@ -37,9 +165,22 @@ private:
     TaskQueueManager& operator=(const TaskQueueManager&) = delete;
 
 private:
+    // Serializes create(), destroy() and interning. Readers never take it.
     std::mutex m_mutex;
 
-    std::unordered_map<std::string, std::unique_ptr<TaskQueue>> m_queueMap;
+    // Name to handle id, replaced as a whole whenever a name is added.
+    std::atomic<const NameTable*> m_names;
+
+    // Queue of each handle id, nullptr while there is none. Chunks are added
+    // as names get interned and are only freed with the manager, so readers
+    // may index them without protection.
+    std::atomic<std::atomic<TaskQueue*>*> m_slots[kMaxSlotChunks] = {};
+
+    // Number of ids handed out. Guarded by |m_mutex|.
+    uint32_t m_nextId {0};
+
+    // See setSimulatedClock(). Guarded by |m_mutex|.
+    SimulatedClock* m_simulatedClock {nullptr};
 
 };
 
@@ -47,4 +188,6 @@ private:
 
 #define TQMgr vi::TaskQueueManager::instance()
 
+// Convenient, but looks the name up on every use. Resolve a
+// TaskQueueManager::Handle once where posting is frequent.
 #define TQ(name) TQMgr->queue(name)
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include "thread_placement.h"
+
+namespace vi {
+
+class SimulatedClock;
+class ThreadPool;
+
+// How the tasks of a queue are run.
+enum class TaskQueueType {
+    // TaskQueueSTD: the queue owns a thread. Lowest latency, but every queue
+    // costs a thread even while idle.
+    kDedicatedThread,
+    // TaskQueuePooled: the queue is a strand multiplexed with other queues
+    // onto the worker threads of a ThreadPool. Use it for many mostly idle
+    // queues.
+    kPooled,
+    // TaskQueueIO: like kDedicatedThread, but the thread waits in epoll, so
+    // that file descriptor callbacks registered with TaskQueue::watchFd()
+    // run on the queue without a hop from a separate I/O thread. Linux
+    // only; elsewhere a kDedicatedThread queue is created instead.
+    kIO,
+    // TaskQueueSimulated: the queue has no thread and runs on virtual time.
+    // Its tasks run when a SimulatedClock is driven, which jumps straight to
+    // the next deadline, so that long timer schedules finish at CPU speed.
+    kSimulated,
+};
+
+// Storage used for the delayed tasks of a queue.
+enum class DelayedQueueType {
+    // std::map keyed by (fire time, order): O(log n) insert, one allocation
+    // per delayed task.
+    kOrderedMap,
+    // Hierarchical timing wheel: O(1) insert and cancel and no allocation in
+    // steady state. Expired entries pass through a heap of the due ones,
+    // O(log n) in the number of tasks due at once. Prefer it for queues
+    // with many timeouts in flight.
+    kTimingWheel,
+};
+
+// What a bounded queue does with a post that does not fit, see
+// TaskQueueOptions::max_pending_tasks_. Dropped and rejected tasks are
+// destroyed without running, which runs the cleanup of a
+// ClosureTaskWithCleanup and releases whatever a closure captured.
+enum class OverflowPolicy {
+    // The producer waits until the queue has room. A task of the queue that
+    // posts to its own queue is never blocked, it exceeds the limit instead.
+    // Posts from tasks of other queues do block, and a task of a kPooled
+    // queue blocks its pool worker: enough of them tie up every worker of
+    // the ThreadPool, including the ones the full queue needs to drain.
+    kBlock,
+    // The post is rejected, see PostResult::kRejected.
+    kFail,
+    // Pending tasks are dropped, oldest first, to make room. Only tasks of
+    // the priority of the new task or lower are dropped, the lowest priority
+    // lane first; if that does not make room the new task is dropped.
+    kDropOldest,
+    // The new task is dropped, see PostResult::kDropped.
+    kDropNewest,
+};
+
+// What the thread of a queue does when it runs out of tasks, see
+// TaskQueueOptions::idle_policy_ and the idle counters of TaskQueueStats.
+enum class IdlePolicy {
+    // The thread parks right away. Idle queues cost no CPU, but a post to
+    // one pays for the wakeup: a syscall on the posting thread and a
+    // context switch before the task runs.
+    kBlock,
+    // The thread polls for new tasks for up to
+    // TaskQueueOptions::idle_spin_budget_ before it parks. Posts that arrive
+    // meanwhile are picked up without a syscall on either side.
+    kSpinThenPark,
+    // The thread never parks and keeps its core busy for as long as the
+    // queue lives. Meant for a queue pinned to a core of its own, see
+    // ThreadPlacement.
+    kBusyPoll,
+};
+
+// Outcome of TaskQueue::tryPostTask() and postCoalescedTask().
+enum class PostResult {
+    kPosted,
+    // The queue was full and its policy is OverflowPolicy::kFail.
+    kRejected,
+    // The queue was full and the new task was dropped.
+    kDropped,
+    // The task took the place of a pending task with the same key, see
+    // TaskQueue::postCoalescedTask().
+    kReplaced,
+};
+
+// Per-queue configuration accepted by TaskQueue::create() and
+// TaskQueueManager::create(). A default constructed instance reproduces the
+// classic behaviour of a TaskQueueSTD.
+struct TaskQueueOptions {
+    TaskQueueType type_ {TaskQueueType::kDedicatedThread};
+
+    // Pool that runs a kPooled queue, nullptr for ThreadPool::shared(). The
+    // pool must outlive the queue.
+    ThreadPool* thread_pool_ {nullptr};
+
+    // Clock of a kSimulated queue, nullptr for SimulatedClock::shared().
+    // The clock must outlive the queue.
+    SimulatedClock* simulated_clock_ {nullptr};
+
+    // When true, postTask() appends to a lock-free multi-producer/single-consumer
+    // queue instead of taking the queue mutex. Worth enabling for queues that
+    // many threads post into at the same time. Delayed tasks are unaffected.
+    bool lock_free_submission_ {false};
+
+    DelayedQueueType delayed_queue_type_ {DelayedQueueType::kOrderedMap};
+
+    // Every that many tasks, rounded up to a power of two, the queueing delay
+    // and run time are recorded into the histograms of TaskQueueStats. Each
+    // sample costs three clock reads. 0 turns the histograms off; task counts
+    // are kept either way.
+    uint32_t metrics_sample_interval_ {16};
+
+    // A pending low priority task runs after at most that many tasks of
+    // higher priority were picked ahead of it, so that a steady stream of
+    // high and normal priority tasks cannot starve it. 0 gives the higher
+    // lanes strict precedence.
+    uint32_t low_priority_starvation_limit_ {16};
+
+    // CPUs, NUMA node, scheduling and name of the queue's thread. Only used
+    // by kDedicatedThread and kIO queues; pooled queues run wherever the
+    // workers of their pool were placed, see ThreadPool::ThreadPool(). An
+    // empty ThreadPlacement::name_ names the thread after the queue, also
+    // when TaskQueueManager::create() applies the options to several.
+    ThreadPlacement thread_placement_;
+
+    // What the thread of a kDedicatedThread queue does while there is
+    // nothing to run. Other queue types always block.
+    IdlePolicy idle_policy_ {IdlePolicy::kBlock};
+
+    // How long IdlePolicy::kSpinThenPark polls before parking.
+    std::chrono::microseconds idle_spin_budget_ {50};
+
+    // Limits of the tasks waiting to run, 0 for no limit. Only tasks posted
+    // to run right away count; delayed tasks are bounded by their posters.
+    // Bytes are estimated as a fixed cost per task plus the closure storage
+    // that did not fit into the Task, see Task::heapSize(). An empty queue
+    // accepts a post of any size.
+    size_t max_pending_tasks_ {0};
+
+    size_t max_pending_bytes_ {0};
+
+    // What happens to posts beyond the limits.
+    OverflowPolicy overflow_policy_ {OverflowPolicy::kBlock};
+};
+
+}
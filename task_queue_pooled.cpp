@@ -0,0 +1,234 @@
+#include "task_queue_pooled.h"
+#include <assert.h>
+#include <condition_variable>
+#include <mutex>
+
+namespace vi {
+
+namespace {
+
+// deleteThis() waits here for a strand that is running on another worker.
+// Process wide and never destroyed, so that run() does not touch the queue
+// after it announced that it stopped.
+std::mutex& stopMutex() {
+    static std::mutex* mutex = new std::mutex();
+    return *mutex;
+}
+
+std::condition_variable& stopCondition() {
+    static std::condition_variable* condition = new std::condition_variable();
+    return *condition;
+}
+
+}  // namespace
+
+TaskQueuePooled::TaskQueuePooled(std::string_view queueName, const TaskQueueOptions& options)
+    : pool_(options.thread_pool_ ? options.thread_pool_ : ThreadPool::shared())
+    , core_(options)
+    , name_(queueName) {
+}
+
+void TaskQueuePooled::deleteThis() {
+    //RTC_DCHECK(!isCurrent());
+    assert(isCurrent() == false);
+
+    // Claiming |kScheduled| keeps posts from scheduling the queue again.
+    const uint32_t state = state_.fetch_or(kScheduled | kQuit, std::memory_order_acq_rel);
+    if (!(state & kScheduled)) {
+        destroy();
+        return;
+    }
+
+    if (!(state & kRunning)) {
+        // Waiting for a worker, which will find |kQuit| and delete the queue
+        // without running any task.
+        return;
+    }
+
+    // A task is running on another thread; run() stops after it.
+    {
+        std::unique_lock<std::mutex> lock(stopMutex());
+        stopCondition().wait(lock, [this]{
+            return (state_.load(std::memory_order_acquire) & kStopped) != 0;
+        });
+    }
+    destroy();
+}
+
+void TaskQueuePooled::postTask(std::unique_ptr<QueuedTask> task) {
+    postTask(Task(std::move(task)));
+}
+
+void TaskQueuePooled::postTask(Task task) {
+    tryPostTask(std::move(task), TaskPriority::kNormal);
+}
+
+void TaskQueuePooled::postTask(Task task, TaskPriority priority) {
+    tryPostTask(std::move(task), priority);
+}
+
+PostResult TaskQueuePooled::tryPostTask(Task task, TaskPriority priority) {
+    const PostResult result = core_.push(std::move(task), priority, !isCurrent());
+    if (result == PostResult::kPosted) {
+        notifyWake();
+    }
+    return result;
+}
+
+PostResult TaskQueuePooled::postCoalescedTask(uint64_t key, Task task, std::chrono::microseconds delay) {
+    const PostResult result = core_.pushCoalesced(key, std::move(task), delay, !isCurrent());
+    if (result == PostResult::kPosted) {
+        notifyWake();
+    }
+    return result;
+}
+
+DelayedTaskHandle TaskQueuePooled::postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t ms) {
+    return postDelayedTask(Task(std::move(task)), std::chrono::milliseconds(ms));
+}
+
+DelayedTaskHandle TaskQueuePooled::postDelayedTask(std::unique_ptr<QueuedTask> task, std::chrono::microseconds duration) {
+    return postDelayedTask(Task(std::move(task)), duration);
+}
+
+DelayedTaskHandle TaskQueuePooled::postDelayedTask(Task task, std::chrono::microseconds duration) {
+    auto handle = core_.pushDelayed(std::move(task), duration);
+
+    notifyWake();
+    return handle;
+}
+
+RepeatingTaskHandle TaskQueuePooled::postRepeatingTask(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay) {
+    auto handle = core_.pushRepeating(std::move(task), std::move(state), delay);
+
+    notifyWake();
+    return handle;
+}
+
+void TaskQueuePooled::postTasks(std::vector<Task> tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    if (core_.pushBatch(std::move(tasks), !isCurrent()) == PostResult::kPosted) {
+        notifyWake();
+    }
+}
+
+void TaskQueuePooled::postDelayedTasks(std::vector<std::pair<Task, std::chrono::microseconds>> tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    core_.pushDelayedBatch(std::move(tasks));
+
+    notifyWake();
+}
+
+void TaskQueuePooled::notifyWake() {
+    // The read-modify-write either happens before run() clears |kNotified|,
+    // which makes the new task visible to it, or after, in which case run()
+    // fails to go idle and looks again.
+    const uint32_t state = state_.fetch_or(kScheduled | kNotified, std::memory_order_acq_rel);
+    if (!(state & kScheduled)) {
+        pool_->schedule(this);
+    }
+}
+
+void TaskQueuePooled::wake() {
+    notifyWake();
+}
+
+void TaskQueuePooled::run() {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    while (!state_.compare_exchange_weak(state, (state | kRunning) & ~kNotified, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+    }
+
+    if (state & kQuit) {
+        // deleteThis() found the queue waiting for a worker.
+        destroy();
+        return;
+    }
+
+    if (runTasks()) {
+        return;
+    }
+
+    // deleteThis() is waiting for this worker. The queue may be gone as soon
+    // as |kStopped| is visible, so nothing but the process wide condition is
+    // touched afterwards.
+    {
+        std::unique_lock<std::mutex> lock(stopMutex());
+        state_.fetch_or(kStopped, std::memory_order_release);
+    }
+    stopCondition().notify_all();
+}
+
+bool TaskQueuePooled::runTasks() {
+    CurrentTaskQueueSetter setCurrent(this);
+
+    int ran = 0;
+    while (true) {
+        uint32_t state = state_.load(std::memory_order_acquire);
+        if (state & kQuit) {
+            return false;
+        }
+
+        if (ran == kMaxTasksPerSlice) {
+            // Give up the worker but stay scheduled.
+            if (state_.compare_exchange_strong(state, state & ~kRunning, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                pool_->yield(this);
+                return true;
+            }
+            continue;
+        }
+
+        int64_t sleepUntilUs = 0;
+        Task task = core_.next(TaskQueueCore::microseconds(), sleepUntilUs);
+        if (task) {
+            core_.run(std::move(task));
+            ++ran;
+            continue;
+        }
+
+        if (sleepUntilUs != 0) {
+            pool_->wakeAt(this, sleepUntilUs);
+        }
+
+        uint32_t expected = kScheduled | kRunning;
+        if (state_.compare_exchange_strong(expected, 0, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            return true;
+        }
+        if (expected & kQuit) {
+            return false;
+        }
+        // New tasks arrived while looking, take them.
+        state_.fetch_and(~kNotified, std::memory_order_acq_rel);
+    }
+}
+
+void TaskQueuePooled::destroy() {
+    pool_->cancelWake(this);
+    delete this;
+}
+
+BlockPool* TaskQueuePooled::closurePool() {
+    return core_.closurePool();
+}
+
+bool TaskQueuePooled::bounded() const {
+    return core_.bounded();
+}
+
+TaskQueueStats TaskQueuePooled::stats() const {
+    TaskQueueStats result;
+    result.name_ = name_;
+    core_.stats(result);
+    return result;
+}
+
+const std::string& TaskQueuePooled::name() const {
+    return name_;
+}
+
+}
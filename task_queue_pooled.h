@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "queued_task.h"
+#include "task_queue_base.h"
+#include "task_queue_core.h"
+#include "task_queue_options.h"
+#include "thread_pool.h"
+
+namespace vi {
+
+// Task queue without a thread of its own. The queue is a strand on a
+// ThreadPool: whenever it has tasks it is scheduled as a job, and the worker
+// that picks it up runs its tasks one after another. Since the queue is never
+// scheduled twice at the same time, tasks keep running in FIFO order and
+// never overlap, although consecutive tasks may run on different threads.
+// TaskQueueBase::current() returns the queue while one of its tasks runs.
+//
+// A strand runs at most |kMaxTasksPerSlice| tasks before it lets the other
+// queues of the pool have the worker, so a busy queue cannot starve the rest.
+class TaskQueuePooled final : public TaskQueueBase, private ThreadPool::Job {
+public:
+    TaskQueuePooled(std::string_view queueName, const TaskQueueOptions& options = TaskQueueOptions());
+    ~TaskQueuePooled() override = default;
+
+    void deleteThis() override;
+
+    void postTask(std::unique_ptr<QueuedTask> task) override;
+
+    DelayedTaskHandle postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t milliseconds) override;
+
+    DelayedTaskHandle postDelayedTask(std::unique_ptr<QueuedTask> task, std::chrono::microseconds delay) override;
+
+    void postTask(Task task) override;
+
+    DelayedTaskHandle postDelayedTask(Task task, std::chrono::microseconds delay) override;
+
+    RepeatingTaskHandle postRepeatingTask(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay) override;
+
+    void postTask(Task task, TaskPriority priority) override;
+
+    PostResult tryPostTask(Task task, TaskPriority priority) override;
+
+    PostResult postCoalescedTask(uint64_t key, Task task, std::chrono::microseconds delay) override;
+
+    void postTasks(std::vector<Task> tasks) override;
+
+    void postDelayedTasks(std::vector<std::pair<Task, std::chrono::microseconds>> tasks) override;
+
+    BlockPool* closurePool() override;
+
+    bool bounded() const override;
+
+    TaskQueueStats stats() const override;
+
+    const std::string& name() const override;
+
+private:
+    static const int kMaxTasksPerSlice = 64;
+
+    // Bits of |state_|.
+    enum : uint32_t {
+        // Owned by the pool: queued as a job or running.
+        kScheduled = 1 << 0,
+        // A worker is inside run().
+        kRunning = 1 << 1,
+        // Tasks were added since run() last looked at the queue.
+        kNotified = 1 << 2,
+        // deleteThis() was called.
+        kQuit = 1 << 3,
+        // run() has left for good after seeing |kQuit|.
+        kStopped = 1 << 4,
+    };
+
+    // ThreadPool::Job implementation.
+    void run() override;
+
+    void wake() override;
+
+    // Makes sure the queue will look at its tasks, scheduling it on the pool
+    // unless it is scheduled already.
+    void notifyWake();
+
+    // Runs tasks until there are none left or the slice is used up. Returns
+    // false when |kQuit| was seen.
+    bool runTasks();
+
+    // Deletes the queue once nothing can run it anymore.
+    void destroy();
+
+private:
+    ThreadPool* const pool_;
+
+    std::atomic<uint32_t> state_ {0};
+
+    // Pending and delayed tasks, see TaskQueueCore.
+    TaskQueueCore core_;
+
+    std::string name_;
+};
+
+}
@@ -0,0 +1,121 @@
+#include "task_queue_simulated.h"
+#include <assert.h>
+
+namespace vi {
+
+namespace {
+
+// |options| with the clock the core measures delays on.
+TaskQueueOptions simulatedOptions(TaskQueueOptions options, SimulatedClock* clock) {
+    options.type_ = TaskQueueType::kSimulated;
+    options.simulated_clock_ = clock;
+    return options;
+}
+
+}  // namespace
+
+TaskQueueSimulated::TaskQueueSimulated(std::string_view queueName, const TaskQueueOptions& options)
+    : clock_(options.simulated_clock_ ? options.simulated_clock_ : SimulatedClock::shared())
+    , core_(simulatedOptions(options, clock_))
+    , name_(queueName) {
+    clock_->add(this);
+}
+
+void TaskQueueSimulated::deleteThis() {
+    assert(isCurrent() == false);
+
+    // Pending tasks are destroyed with the core, without running.
+    clock_->remove(this);
+    delete this;
+}
+
+void TaskQueueSimulated::postTask(std::unique_ptr<QueuedTask> task) {
+    postTask(Task(std::move(task)));
+}
+
+void TaskQueueSimulated::postTask(Task task) {
+    tryPostTask(std::move(task), TaskPriority::kNormal);
+}
+
+void TaskQueueSimulated::postTask(Task task, TaskPriority priority) {
+    tryPostTask(std::move(task), priority);
+}
+
+PostResult TaskQueueSimulated::tryPostTask(Task task, TaskPriority priority) {
+    // Nothing to wake: the driver looks at every queue before time moves.
+    // Posts never block, since only the driver, which may well be the
+    // posting thread, makes room.
+    return core_.push(std::move(task), priority, false);
+}
+
+PostResult TaskQueueSimulated::postCoalescedTask(uint64_t key, Task task, std::chrono::microseconds delay) {
+    return core_.pushCoalesced(key, std::move(task), delay, false);
+}
+
+DelayedTaskHandle TaskQueueSimulated::postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t ms) {
+    return postDelayedTask(Task(std::move(task)), std::chrono::milliseconds(ms));
+}
+
+DelayedTaskHandle TaskQueueSimulated::postDelayedTask(std::unique_ptr<QueuedTask> task, std::chrono::microseconds duration) {
+    return postDelayedTask(Task(std::move(task)), duration);
+}
+
+DelayedTaskHandle TaskQueueSimulated::postDelayedTask(Task task, std::chrono::microseconds duration) {
+    return core_.pushDelayed(std::move(task), duration);
+}
+
+RepeatingTaskHandle TaskQueueSimulated::postRepeatingTask(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay) {
+    return core_.pushRepeating(std::move(task), std::move(state), delay);
+}
+
+void TaskQueueSimulated::postTasks(std::vector<Task> tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    core_.pushBatch(std::move(tasks), false);
+}
+
+void TaskQueueSimulated::postDelayedTasks(std::vector<std::pair<Task, std::chrono::microseconds>> tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    core_.pushDelayedBatch(std::move(tasks));
+}
+
+int TaskQueueSimulated::runTasks(int64_t now, int64_t& sleepUntilUs) {
+    CurrentTaskQueueSetter setCurrent(this);
+
+    int ran = 0;
+    while (ran < kMaxTasksPerSlice) {
+        Task task = core_.next(now, sleepUntilUs);
+        if (!task) {
+            break;
+        }
+        core_.run(std::move(task));
+        ++ran;
+    }
+    return ran;
+}
+
+BlockPool* TaskQueueSimulated::closurePool() {
+    return core_.closurePool();
+}
+
+bool TaskQueueSimulated::bounded() const {
+    return core_.bounded();
+}
+
+TaskQueueStats TaskQueueSimulated::stats() const {
+    TaskQueueStats result;
+    result.name_ = name_;
+    core_.stats(result);
+    return result;
+}
+
+const std::string& TaskQueueSimulated::name() const {
+    return name_;
+}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "queued_task.h"
+#include "simulated_clock.h"
+#include "task_queue_base.h"
+#include "task_queue_core.h"
+#include "task_queue_options.h"
+
+namespace vi {
+
+// Task queue without a thread that runs on virtual time. Its tasks run on
+// whichever thread drives its SimulatedClock, and its delays are measured
+// on that clock, which jumps to the next deadline instead of sleeping.
+// Tasks keep the order and the rules of TaskPriority of the other queues.
+// TaskQueueBase::current() returns the queue while one of its tasks runs.
+//
+// Posts never block: with OverflowPolicy::kBlock a full queue takes the
+// task anyway, as it does for posts from its own tasks.
+class TaskQueueSimulated final : public TaskQueueBase {
+public:
+    TaskQueueSimulated(std::string_view queueName, const TaskQueueOptions& options = TaskQueueOptions());
+    ~TaskQueueSimulated() override = default;
+
+    void deleteThis() override;
+
+    void postTask(std::unique_ptr<QueuedTask> task) override;
+
+    DelayedTaskHandle postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t milliseconds) override;
+
+    DelayedTaskHandle postDelayedTask(std::unique_ptr<QueuedTask> task, std::chrono::microseconds delay) override;
+
+    void postTask(Task task) override;
+
+    DelayedTaskHandle postDelayedTask(Task task, std::chrono::microseconds delay) override;
+
+    RepeatingTaskHandle postRepeatingTask(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay) override;
+
+    void postTask(Task task, TaskPriority priority) override;
+
+    PostResult tryPostTask(Task task, TaskPriority priority) override;
+
+    PostResult postCoalescedTask(uint64_t key, Task task, std::chrono::microseconds delay) override;
+
+    void postTasks(std::vector<Task> tasks) override;
+
+    void postDelayedTasks(std::vector<std::pair<Task, std::chrono::microseconds>> tasks) override;
+
+    BlockPool* closurePool() override;
+
+    bool bounded() const override;
+
+    TaskQueueStats stats() const override;
+
+    const std::string& name() const override;
+
+private:
+    friend class SimulatedClock;
+
+    static const int kMaxTasksPerSlice = 64;
+
+    // Runs up to |kMaxTasksPerSlice| tasks due at |now| for the clock and
+    // returns how many ran. |sleepUntilUs| receives the next deadline once
+    // no task is due, see TaskQueueCore::next().
+    int runTasks(int64_t now, int64_t& sleepUntilUs);
+
+private:
+    SimulatedClock* const clock_;
+
+    // Pending and delayed tasks, see TaskQueueCore.
+    TaskQueueCore core_;
+
+    std::string name_;
+};
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include "latency_histogram.h"
+
+namespace vi {
+
+// Snapshot of the counters of one task queue, see TaskQueueBase::stats()
+// and TaskQueueManager::stats(). The fields are read one by one without
+// stopping the queue, so they may be off by the tasks posted or run while
+// the snapshot was taken.
+struct TaskQueueStats {
+    std::string name_;
+
+    // Tasks posted so far, delayed ones included.
+    uint64_t posted_ {0};
+
+    // Tasks taken off the queue to run.
+    uint64_t run_ {0};
+
+    // Delayed tasks removed through their DelayedTaskHandle.
+    uint64_t cancelled_ {0};
+
+    // Pending tasks dropped by OverflowPolicy::kDropOldest.
+    uint64_t dropped_ {0};
+
+    // Posts that replaced a pending task with the same key instead of
+    // queueing another one, see TaskQueue::postCoalescedTask(). These are
+    // not counted in |posted_|.
+    uint64_t coalesced_ {0};
+
+    // Posts turned away by a full queue, see PostResult. These are not
+    // counted in |posted_|.
+    uint64_t rejected_ {0};
+
+    // Tasks posted but neither run, cancelled nor dropped yet, delayed ones
+    // included.
+    uint64_t pending_ {0};
+
+    // Delayed tasks among |pending_|, whether due or not.
+    uint64_t delayed_ {0};
+
+    // Estimated bytes held by the pending tasks that are not delayed. Only
+    // tracked for queues with a limit, see TaskQueueOptions.
+    uint64_t pending_bytes_ {0};
+
+    // Highest |pending_| seen when picking a task.
+    uint64_t max_pending_ {0};
+
+    // Time the thread of the queue spent without a task to run, and the
+    // part of it spent polling instead of parked, see IdlePolicy. Only
+    // tracked by kDedicatedThread queues.
+    uint64_t idle_us_ {0};
+
+    uint64_t spin_us_ {0};
+
+    // Times the thread returned from parking, woken by a post or by a
+    // delayed task coming due.
+    uint64_t wakeups_ {0};
+
+    // Times polling found a task before the thread parked, each sparing a
+    // wakeup.
+    uint64_t spin_hits_ {0};
+
+    // Time from postTask() to the start of run(); for delayed tasks from the
+    // fire time, measured on the clock of the deadline, which is virtual for
+    // kSimulated queues. Sampled, see
+    // TaskQueueOptions::metrics_sample_interval_; empty if sampling is off.
+    HistogramSnapshot queueing_delay_;
+
+    // Duration of run(), sampled like |queueing_delay_|.
+    HistogramSnapshot run_time_;
+};
+
+}
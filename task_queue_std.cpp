@@ -3,13 +3,17 @@
 
 namespace vi {
 
-TaskQueueSTD::TaskQueueSTD(std::string_view queueName)
+TaskQueueSTD::TaskQueueSTD(std::string_view queueName, const TaskQueueOptions& options)
     : started_(/*manual_reset=*/false, /*initially_signaled=*/false)
     , stopped_(/*manual_reset=*/false, /*initially_signaled=*/false)
     , flag_notify_(/*manual_reset=*/false, /*initially_signaled=*/false)
+    , idle_policy_(options.idle_policy_)
+    , idle_spin_budget_ns_(std::chrono::duration_cast<std::chrono::nanoseconds>(options.idle_spin_budget_).count())
+    , core_(options)
     , name_(queueName) {
 
-    thread_ = std::thread([this]{
+    thread_ = std::thread([this, placement = options.thread_placement_]{
+        applyThreadPlacement(placement, name_);
         CurrentTaskQueueSetter setCurrent(this);
         this->processTasks();
     });
@@ -22,10 +26,7 @@ void TaskQueueSTD::deleteThis() {
     //RTC_DCHECK(!isCurrent());
     assert(isCurrent() == false);
 
-    {
-        std::unique_lock<std::mutex> lock(pending_mutex_);
-        thread_should_quit_ = true;
-    }
+    thread_should_quit_.store(true, std::memory_order_release);
 
     notifyWake();
 
@@ -38,79 +39,95 @@ void TaskQueueSTD::deleteThis() {
 }
 
 void TaskQueueSTD::postTask(std::unique_ptr<QueuedTask> task) {
-    {
-        std::unique_lock<std::mutex> lock(pending_mutex_);
-        OrderId order = thread_posting_order_++;
+    postTask(Task(std::move(task)));
+}
+
+void TaskQueueSTD::postTask(Task task) {
+    tryPostTask(std::move(task), TaskPriority::kNormal);
+}
 
-        pending_queue_.push(std::pair<OrderId, std::unique_ptr<QueuedTask>>(order, std::move(task)));
+void TaskQueueSTD::postTask(Task task, TaskPriority priority) {
+    tryPostTask(std::move(task), priority);
+}
+
+PostResult TaskQueueSTD::tryPostTask(Task task, TaskPriority priority) {
+    const PostResult result = core_.push(std::move(task), priority, !isCurrent());
+    if (result == PostResult::kPosted) {
+        notifyWake();
     }
+    return result;
+}
 
-    notifyWake();
+PostResult TaskQueueSTD::postCoalescedTask(uint64_t key, Task task, std::chrono::microseconds delay) {
+    const PostResult result = core_.pushCoalesced(key, std::move(task), delay, !isCurrent());
+    if (result == PostResult::kPosted) {
+        notifyWake();
+    }
+    return result;
 }
 
-void TaskQueueSTD::postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t ms) {
-    auto fire_at = milliseconds() + ms;
+DelayedTaskHandle TaskQueueSTD::postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t ms) {
+    return postDelayedTask(Task(std::move(task)), std::chrono::milliseconds(ms));
+}
 
-    DelayedEntryTimeout delay;
-    delay.next_fire_at_ms_ = fire_at;
+DelayedTaskHandle TaskQueueSTD::postDelayedTask(std::unique_ptr<QueuedTask> task, std::chrono::microseconds duration) {
+    return postDelayedTask(Task(std::move(task)), duration);
+}
 
-    {
-        std::unique_lock<std::mutex> lock(pending_mutex_);
-        delay.order_ = ++thread_posting_order_;
-        delayed_queue_[delay] = std::move(task);
-    }
+DelayedTaskHandle TaskQueueSTD::postDelayedTask(Task task, std::chrono::microseconds duration) {
+    auto handle = core_.pushDelayed(std::move(task), duration);
 
     notifyWake();
+    return handle;
 }
 
-TaskQueueSTD::NextTask TaskQueueSTD::getNextTask() {
-    NextTask result{};
+RepeatingTaskHandle TaskQueueSTD::postRepeatingTask(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay) {
+    auto handle = core_.pushRepeating(std::move(task), std::move(state), delay);
 
-    auto tick = milliseconds();
+    notifyWake();
+    return handle;
+}
 
-    std::unique_lock<std::mutex> lock(pending_mutex_);
+void TaskQueueSTD::postTasks(std::vector<Task> tasks) {
+    if (tasks.empty()) {
+        return;
+    }
 
-    if (thread_should_quit_) {
-        result.final_task_ = true;
-        return result;
+    if (core_.pushBatch(std::move(tasks), !isCurrent()) == PostResult::kPosted) {
+        notifyWake();
     }
+}
 
-    if (delayed_queue_.size() > 0) {
-        auto delayed_entry = delayed_queue_.begin();
-        const auto& delay_info = delayed_entry->first;
-        auto& delay_run = delayed_entry->second;
-        if (tick >= delay_info.next_fire_at_ms_) {
-            if (pending_queue_.size() > 0) {
-                auto& entry = pending_queue_.front();
-                auto& entry_order = entry.first;
-                auto& entry_run = entry.second;
-                if (entry_order < delay_info.order_) {
-                    result.run_task_ = std::move(entry_run);
-                    pending_queue_.pop();
-                    return result;
-                }
-            }
+void TaskQueueSTD::postDelayedTasks(std::vector<std::pair<Task, std::chrono::microseconds>> tasks) {
+    if (tasks.empty()) {
+        return;
+    }
 
-            result.run_task_ = std::move(delay_run);
-            delayed_queue_.erase(delayed_entry);
-            return result;
-        }
+    core_.pushDelayedBatch(std::move(tasks));
 
-        result.sleep_time_ms_ = delay_info.next_fire_at_ms_ - tick;
-    }
+    notifyWake();
+}
 
-    if (pending_queue_.size() > 0) {
-        auto& entry = pending_queue_.front();
-        result.run_task_ = std::move(entry.second);
-        pending_queue_.pop();
+TaskQueueSTD::NextTask TaskQueueSTD::getNextTask() {
+    NextTask result{};
+
+    if (thread_should_quit_.load(std::memory_order_acquire)) {
+        result.final_task_ = true;
+        return result;
     }
 
+    result.run_task_ = core_.next(TaskQueueCore::microseconds(), result.sleep_until_us_);
     return result;
 }
 
 void TaskQueueSTD::processTasks() {
     started_.set();
 
+    // Start of the current idle period.
+    int64_t idleSinceNs = 0;
+    // End of polling in the current idle period.
+    int64_t spinUntilNs = 0;
+
     while (true) {
         auto task = getNextTask();
 
@@ -118,27 +135,85 @@ void TaskQueueSTD::processTasks() {
             break;
         }
 
+        const WorkerState state = worker_state_.load(std::memory_order_relaxed);
         if (task.run_task_) {
-            // process entry immediately then try again
-            QueuedTask* release_ptr = task.run_task_.release();
-            if (release_ptr->run()) {
-                delete release_ptr;
+            if (state != kRunning) {
+                worker_state_.store(kRunning, std::memory_order_relaxed);
+                idle_ns_.fetch_add(TaskQueueCore::nanoseconds() - idleSinceNs, std::memory_order_relaxed);
+                if (state == kPolling) {
+                    spin_hits_.fetch_add(1, std::memory_order_relaxed);
+                }
             }
+            // process entry immediately then try again; run() releases the
+            // task unless it is a QueuedTask that took back ownership.
+            core_.run(std::move(task.run_task_));
             // attempt to sleep again
             continue;
         }
 
-        if (0 == task.sleep_time_ms_) {
+        if (state == kRunning) {
+            // Producers skip signaling flag_notify_ while the worker is busy.
+            // Announce that we are about to poll or sleep and look for work
+            // once more, so a post that raced with the announcement is not
+            // missed.
+            idleSinceNs = TaskQueueCore::nanoseconds();
+            if (idle_policy_ == IdlePolicy::kBlock) {
+                worker_state_.store(kParking, std::memory_order_relaxed);
+            }
+            else {
+                spinUntilNs = idle_policy_ == IdlePolicy::kBusyPoll ? INT64_MAX : idleSinceNs + idle_spin_budget_ns_;
+                worker_state_.store(kPolling, std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            continue;
+        }
+
+        if (state == kPolling) {
+            if (!poll(task.sleep_until_us_, spinUntilNs)) {
+                // Out of budget, announce parking the same way.
+                worker_state_.store(kParking, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+            continue;
+        }
+
+        if (0 == task.sleep_until_us_) {
             flag_notify_.wait(vi::Event::kForever);
         }
         else {
-            flag_notify_.wait(task.sleep_time_ms_);
+            flag_notify_.waitUntil(std::chrono::steady_clock::time_point(std::chrono::microseconds(task.sleep_until_us_)));
         }
+        wakeups_.fetch_add(1, std::memory_order_relaxed);
     }
 
     stopped_.set();
 }
 
+bool TaskQueueSTD::poll(int64_t sleepUntilUs, int64_t spinUntilNs) {
+    const int64_t startNs = TaskQueueCore::nanoseconds();
+    int64_t nowNs = startNs;
+    bool woken = true;
+    for (uint32_t i = 1;; ++i) {
+        if (work_posted_.load(std::memory_order_relaxed) && work_posted_.exchange(false, std::memory_order_acquire)) {
+            break;
+        }
+        cpuRelax();
+        // Only every so many pauses is the clock worth reading.
+        if (i % 16 == 0) {
+            nowNs = TaskQueueCore::nanoseconds();
+            if (sleepUntilUs != 0 && nowNs / 1000 >= sleepUntilUs) {
+                break;
+            }
+            if (nowNs >= spinUntilNs) {
+                woken = false;
+                break;
+            }
+        }
+    }
+    spin_ns_.fetch_add(TaskQueueCore::nanoseconds() - startNs, std::memory_order_relaxed);
+    return woken;
+}
+
 void TaskQueueSTD::notifyWake() {
     // The queue holds pending tasks to complete. Either tasks are to be
     // executed immediately or tasks are to be run at some future delayed time.
@@ -164,11 +239,42 @@ void TaskQueueSTD::notifyWake() {
     // thread is notified to wake up but the task queue's thread finds nothing to
     // do so it waits once again to be signaled where such a signal may never
     // happen.
-    flag_notify_.set();
+    //
+    // While the worker is busy it will look at the queues again before it
+    // sleeps, so the wakeup (and with it every syscall) is skipped. A polling
+    // worker only needs a flag to look again. The fence pairs with the ones
+    // in processTasks(): either the worker sees the task that was just
+    // added, or we see that it announced polling or going to sleep.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    switch (worker_state_.load(std::memory_order_relaxed)) {
+    case kPolling:
+        work_posted_.store(true, std::memory_order_release);
+        break;
+    case kParking:
+        flag_notify_.set();
+        break;
+    case kRunning:
+        break;
+    }
+}
+
+BlockPool* TaskQueueSTD::closurePool() {
+    return core_.closurePool();
 }
 
-int64_t TaskQueueSTD::milliseconds() {
-    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+bool TaskQueueSTD::bounded() const {
+    return core_.bounded();
+}
+
+TaskQueueStats TaskQueueSTD::stats() const {
+    TaskQueueStats result;
+    result.name_ = name_;
+    core_.stats(result);
+    result.idle_us_ = idle_ns_.load(std::memory_order_relaxed) / 1000;
+    result.spin_us_ = spin_ns_.load(std::memory_order_relaxed) / 1000;
+    result.wakeups_ = wakeups_.load(std::memory_order_relaxed);
+    result.spin_hits_ = spin_hits_.load(std::memory_order_relaxed);
+    return result;
 }
 
 const std::string& TaskQueueSTD::name() const {
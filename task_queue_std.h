@@ -1,57 +1,83 @@
 #pragma once
 
 #include <string.h>
-#include <algorithm>
-#include <map>
+#include <atomic>
 #include <memory>
-#include <queue>
 #include <utility>
 #include <thread>
 #include <string_view>
 #include "queued_task.h"
 #include "event.h"
 #include "task_queue_base.h"
+#include "task_queue_core.h"
+#include "task_queue_options.h"
 
 namespace vi {
 
 class TaskQueueSTD final : public TaskQueueBase {
 public:
-    TaskQueueSTD(std::string_view queueName);
+    TaskQueueSTD(std::string_view queueName, const TaskQueueOptions& options = TaskQueueOptions());
     ~TaskQueueSTD() override = default;
 
     void deleteThis() override;
 
     void postTask(std::unique_ptr<QueuedTask> task) override;
 
-    void postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t milliseconds) override;
+    DelayedTaskHandle postDelayedTask(std::unique_ptr<QueuedTask> task, uint32_t milliseconds) override;
 
-    const std::string& name() const override;
+    DelayedTaskHandle postDelayedTask(std::unique_ptr<QueuedTask> task, std::chrono::microseconds delay) override;
 
-private:
-    using OrderId = uint64_t;
+    void postTask(Task task) override;
 
-    struct DelayedEntryTimeout {
-        int64_t next_fire_at_ms_{};
-        OrderId order_{};
+    DelayedTaskHandle postDelayedTask(Task task, std::chrono::microseconds delay) override;
 
-        bool operator<(const DelayedEntryTimeout& o) const {
-            return std::tie(next_fire_at_ms_, order_) < std::tie(o.next_fire_at_ms_, o.order_);
-        }
-    };
+    RepeatingTaskHandle postRepeatingTask(Task task, std::shared_ptr<RepeatingTaskState> state, std::chrono::microseconds delay) override;
+
+    void postTask(Task task, TaskPriority priority) override;
+
+    PostResult tryPostTask(Task task, TaskPriority priority) override;
+
+    PostResult postCoalescedTask(uint64_t key, Task task, std::chrono::microseconds delay) override;
+
+    void postTasks(std::vector<Task> tasks) override;
+
+    void postDelayedTasks(std::vector<std::pair<Task, std::chrono::microseconds>> tasks) override;
+
+    BlockPool* closurePool() override;
+
+    bool bounded() const override;
+
+    TaskQueueStats stats() const override;
+
+    const std::string& name() const override;
 
+private:
     struct NextTask {
         bool final_task_{false};
-        std::unique_ptr<QueuedTask> run_task_;
-        int64_t sleep_time_ms_{};
+        Task run_task_;
+        // Monotonic time to sleep until, 0 to sleep until signaled.
+        int64_t sleep_until_us_{};
     };
 
     NextTask getNextTask();
 
     void processTasks();
 
+    // Polls until a post announces work, the delayed task due at
+    // |sleepUntilUs| (if not 0) comes due or |spinUntilNs| passes. Returns
+    // false in the last case.
+    bool poll(int64_t sleepUntilUs, int64_t spinUntilNs);
+
     void notifyWake();
 
-    static int64_t milliseconds();
+    // What the worker thread is doing, see notifyWake().
+    enum WorkerState : uint8_t {
+        kRunning,
+        // Polling for work, see IdlePolicy.
+        kPolling,
+        // Waits, or is about to wait, on |flag_notify_|.
+        kParking,
+    };
 
 private:
     // Indicates if the thread has started.
@@ -63,30 +89,33 @@ private:
     // Signaled whenever a new task is pending.
     vi::Event flag_notify_;
 
+    std::atomic<WorkerState> worker_state_ {kRunning};
+
+    // Set by notifyWake() for a polling worker.
+    std::atomic<bool> work_posted_ {false};
+
+    const IdlePolicy idle_policy_;
+
+    const int64_t idle_spin_budget_ns_;
+
+    // Idle counters, see TaskQueueStats. Only written by the worker thread.
+    std::atomic<uint64_t> idle_ns_ {0};
+
+    std::atomic<uint64_t> spin_ns_ {0};
+
+    std::atomic<uint64_t> wakeups_ {0};
+
+    std::atomic<uint64_t> spin_hits_ {0};
+
     // Contains the active worker thread assigned to processing
     // tasks (including delayed tasks).
     std::thread thread_;
 
-    std::mutex pending_mutex_;
-
     // Indicates if the worker thread needs to shutdown now.
-    bool thread_should_quit_ {false};
-
-    // Holds the next order to use for the next task to be
-    // put into one of the pending queues.
-    OrderId thread_posting_order_ {};
-
-    // The list of all pending tasks that need to be processed in the
-    // FIFO queue ordering on the worker thread.
-    std::queue<std::pair<OrderId, std::unique_ptr<QueuedTask>>> pending_queue_;
-
-    // The list of all pending tasks that need to be processed at a future
-    // time based upon a delay. On the off change the delayed task should
-    // happen at exactly the same time interval as another task then the
-    // task is processed based on FIFO ordering. std::priority_queue was
-    // considered but rejected due to its inability to extract the
-    // std::unique_ptr out of the queue without the presence of a hack.
-    std::map<DelayedEntryTimeout, std::unique_ptr<QueuedTask>> delayed_queue_;
+    std::atomic<bool> thread_should_quit_ {false};
+
+    // Pending and delayed tasks, see TaskQueueCore.
+    TaskQueueCore core_;
 
     std::string name_;
 
@@ -0,0 +1,146 @@
+#include "thread_placement.h"
+#include <stdio.h>
+#include <algorithm>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fstream>
+#endif
+
+namespace vi {
+
+namespace {
+
+#if defined(__linux__)
+
+// CPUs of NUMA node |node| from sysfs, e.g. "0-3,8-11".
+std::vector<int> nodeCpus(int node) {
+    std::vector<int> cpus;
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!std::getline(file, list)) {
+        return cpus;
+    }
+    int first = -1;
+    int last = -1;
+    const char* text = list.c_str();
+    int consumed = 0;
+    while (sscanf(text, "%d%n", &first, &consumed) == 1) {
+        text += consumed;
+        last = first;
+        if (*text == '-' && sscanf(text + 1, "%d%n", &last, &consumed) == 1) {
+            text += 1 + consumed;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        if (*text != ',') {
+            break;
+        }
+        ++text;
+    }
+    return cpus;
+}
+
+bool setAffinity(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+bool preferNode(int node) {
+    const unsigned long kBits = sizeof(unsigned long) * 8;
+    unsigned long mask[4] = {};
+    if (node < 0 || node >= int(sizeof(mask) * 8)) {
+        return false;
+    }
+    mask[node / kBits] = 1UL << (node % kBits);
+    return syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) == 0;
+}
+
+bool setScheduling(const ThreadPlacement& placement) {
+    int policy = SCHED_OTHER;
+    switch (placement.policy_) {
+    case SchedulingPolicy::kInherit:
+        return placement.nice_ == 0 || setpriority(PRIO_PROCESS, 0, placement.nice_) == 0;
+    case SchedulingPolicy::kNormal: policy = SCHED_OTHER; break;
+    case SchedulingPolicy::kBatch: policy = SCHED_BATCH; break;
+    case SchedulingPolicy::kIdle: policy = SCHED_IDLE; break;
+    case SchedulingPolicy::kFifo: policy = SCHED_FIFO; break;
+    case SchedulingPolicy::kRoundRobin: policy = SCHED_RR; break;
+    }
+    sched_param param{};
+    if (policy == SCHED_FIFO || policy == SCHED_RR) {
+        param.sched_priority = placement.priority_;
+    }
+    if (pthread_setschedparam(pthread_self(), policy, &param) != 0) {
+        return false;
+    }
+    // Nice values are per thread on Linux, which setpriority() addresses by
+    // thread id with 0 for the caller.
+    if ((policy == SCHED_OTHER || policy == SCHED_BATCH) && placement.nice_ != 0) {
+        return setpriority(PRIO_PROCESS, 0, placement.nice_) == 0;
+    }
+    return true;
+}
+
+#endif
+
+bool setName(std::string_view name) {
+#if defined(__linux__) || defined(__APPLE__)
+    // Linux limits names to 16 bytes including the terminator. The cut backs
+    // off to the start of a UTF-8 character rather than split one.
+    size_t length = std::min<size_t>(name.size(), 15);
+    if (length < name.size()) {
+        while (length > 0 && (static_cast<unsigned char>(name[length]) & 0xC0) == 0x80) {
+            --length;
+        }
+    }
+    const std::string truncated(name.substr(0, length));
+#if defined(__APPLE__)
+    return pthread_setname_np(truncated.c_str()) == 0;
+#else
+    return pthread_setname_np(pthread_self(), truncated.c_str()) == 0;
+#endif
+#else
+    (void)name;
+    return false;
+#endif
+}
+
+}  // namespace
+
+bool applyThreadPlacement(const ThreadPlacement& placement, std::string_view defaultName) {
+    bool applied = setName(placement.name_.empty() ? defaultName : std::string_view(placement.name_));
+#if defined(__linux__)
+    if (!placement.cpus_.empty()) {
+        applied = setAffinity(placement.cpus_) && applied;
+    }
+    if (placement.numa_node_ >= 0) {
+        if (placement.cpus_.empty()) {
+            applied = setAffinity(nodeCpus(placement.numa_node_)) && applied;
+        }
+        applied = preferNode(placement.numa_node_) && applied;
+    }
+    applied = setScheduling(placement) && applied;
+#else
+    applied = applied && placement.cpus_.empty() && placement.numa_node_ < 0
+            && placement.policy_ == SchedulingPolicy::kInherit && placement.nice_ == 0;
+#endif
+    return applied;
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vi {
+
+// Scheduling policy of a thread, see sched(7).
+enum class SchedulingPolicy {
+    // Keep what the thread inherited from its creator.
+    kInherit,
+    // SCHED_OTHER, the normal time sharing policy. ThreadPlacement::nice_
+    // applies.
+    kNormal,
+    // SCHED_BATCH: time sharing for throughput work that should not preempt
+    // interactive threads. ThreadPlacement::nice_ applies.
+    kBatch,
+    // SCHED_IDLE: only runs when nothing else wants the CPU.
+    kIdle,
+    // SCHED_FIFO and SCHED_RR: real time with ThreadPlacement::priority_.
+    // Usually needs CAP_SYS_NICE or an RLIMIT_RTPRIO allowance.
+    kFifo,
+    kRoundRobin,
+};
+
+// Where and how the thread of a task queue runs. A default constructed
+// instance leaves everything to the OS, except for the thread name.
+//
+// Placement is best effort: settings the OS refuses, e.g. a real time policy
+// without the privilege or a CPU that is offline, are skipped and the thread
+// runs anyway. The name is set on Linux and macOS, everything else only on
+// Linux.
+struct ThreadPlacement {
+    // CPUs the thread may run on, all of them if empty.
+    std::vector<int> cpus_;
+
+    // NUMA node to run on, -1 for none. The thread prefers memory of the
+    // node for everything it allocates, and unless |cpus_| is given it is
+    // also restricted to the node's CPUs. Memory is placed where it is first
+    // touched, so closure blocks and queue storage that producers on other
+    // nodes fill first may still end up remote.
+    int numa_node_ {-1};
+
+    SchedulingPolicy policy_ {SchedulingPolicy::kInherit};
+
+    // Real time priority for kFifo and kRoundRobin, 1 to 99.
+    int priority_ {1};
+
+    // Nice value for kInherit, kNormal and kBatch, from -20 to 19. 0 keeps
+    // the inherited value.
+    int nice_ {0};
+
+    // Name shown by top, perf and debuggers. The queue's name when empty.
+    // Linux cuts it to 15 bytes, at the start of a UTF-8 character.
+    std::string name_;
+};
+
+// Applies |placement| to the calling thread, using |defaultName| if
+// |placement.name_| is empty. Returns false if any setting was refused.
+bool applyThreadPlacement(const ThreadPlacement& placement, std::string_view defaultName);
+
+}
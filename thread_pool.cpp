@@ -0,0 +1,454 @@
+#include "thread_pool.h"
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+
+namespace vi {
+
+namespace {
+
+// A worker that keeps finding jobs in its own deque still looks at the
+// injection queue every that many jobs, so that jobs scheduled from outside
+// the pool and jobs that yielded are not starved.
+const uint32_t kInjectQueueInterval = 61;
+
+int64_t monotonicMicroseconds() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ThreadPoolScaling normalized(ThreadPoolScaling scaling) {
+    scaling.min_threads_ = std::max<size_t>(scaling.min_threads_, 1);
+    scaling.max_threads_ = std::max(scaling.max_threads_, scaling.min_threads_);
+    return scaling;
+}
+
+ThreadPlacement withDefaultName(ThreadPlacement placement) {
+    if (placement.name_.empty()) {
+        placement.name_ = "pool";
+    }
+    return placement;
+}
+
+}  // namespace
+
+thread_local ThreadPool::Worker* ThreadPool::current_worker_ = nullptr;
+
+thread_local const ThreadPool* ThreadPool::timer_pool_ = nullptr;
+
+ThreadPool* ThreadPool::shared() {
+    // Leaked on purpose: pooled queues may still be deleted during static
+    // destruction.
+    static ThreadPool* pool = new ThreadPool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+ThreadPool::ThreadPool(size_t threads, const ThreadPlacement& placement)
+    : ThreadPool(ThreadPoolScaling{threads, threads}, placement, false) {}
+
+ThreadPool::ThreadPool(const ThreadPoolScaling& scaling, const ThreadPlacement& placement)
+    : ThreadPool(scaling, placement, true) {}
+
+ThreadPool::ThreadPool(const ThreadPoolScaling& scaling, const ThreadPlacement& placement, bool elastic)
+    : scaling_(normalized(scaling)),
+      elastic_(elastic && scaling_.max_threads_ > scaling_.min_threads_),
+      placement_(withDefaultName(placement)) {
+    for (size_t i = 0; i < scaling_.max_threads_; ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->pool_ = this;
+        worker->index_ = i;
+        workers_.push_back(std::move(worker));
+    }
+    // Start the threads once |workers_| is complete, they steal from each
+    // other.
+    {
+        std::lock_guard<std::mutex> lock(scale_mutex_);
+        for (size_t i = 0; i < scaling_.min_threads_; ++i) {
+            startWorker(workers_[i].get());
+        }
+    }
+    active_threads_.store(scaling_.min_threads_, std::memory_order_relaxed);
+    peak_threads_.store(scaling_.min_threads_, std::memory_order_relaxed);
+    timer_thread_ = std::thread([this, timerName = placement_.name_ + "-timer"]{
+        applyThreadPlacement(ThreadPlacement(), timerName);
+        timerLoop();
+    });
+}
+
+ThreadPool::~ThreadPool() {
+    assert(current_worker_ == nullptr || current_worker_->pool_ != this);
+
+    stopping_.store(true, std::memory_order_seq_cst);
+
+    // Waits for a worker being started; none is started after this.
+    {
+        std::lock_guard<std::mutex> lock(scale_mutex_);
+    }
+    for (auto& worker : workers_) {
+        worker->wake_.set();
+    }
+    for (auto& worker : workers_) {
+        if (worker->thread_.joinable()) {
+            worker->thread_.join();
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(timer_mutex_);
+    }
+    timer_cond_.notify_one();
+    timer_thread_.join();
+
+    // Whatever is still queued belongs to queues that were deleted while they
+    // waited for a worker; their run() finishes the deletion.
+    while (true) {
+        Job* job = popInjected();
+        for (size_t i = 0; !job && i < workers_.size(); ++i) {
+            job = workers_[i]->local_.pop();
+        }
+        if (!job) {
+            break;
+        }
+        job->run();
+    }
+}
+
+void ThreadPool::startWorker(Worker* worker) {
+    // A previous thread of the slot has cleared |running_|, it is exiting.
+    if (worker->thread_.joinable()) {
+        worker->thread_.join();
+    }
+    worker->running_.store(true, std::memory_order_relaxed);
+    ThreadPlacement workerPlacement = placement_;
+    workerPlacement.name_ += "-" + std::to_string(worker->index_);
+    worker->thread_ = std::thread([this, worker, workerPlacement]{
+        applyThreadPlacement(workerPlacement, {});
+        workerLoop(worker);
+    });
+}
+
+ThreadPoolStats ThreadPool::stats() const {
+    ThreadPoolStats stats;
+    stats.threads_ = active_threads_.load(std::memory_order_relaxed);
+    stats.min_threads_ = scaling_.min_threads_;
+    stats.max_threads_ = scaling_.max_threads_;
+    stats.peak_threads_ = peak_threads_.load(std::memory_order_relaxed);
+    stats.grown_ = grown_.load(std::memory_order_relaxed);
+    stats.shrunk_ = shrunk_.load(std::memory_order_relaxed);
+    stats.last_scaled_at_us_ = last_scaled_at_us_.load(std::memory_order_relaxed);
+
+    int64_t oldestUs = 0;
+    {
+        std::unique_lock<std::mutex> lock(inject_mutex_);
+        stats.backlog_ = inject_queue_.size();
+        if (!inject_queue_.empty()) {
+            oldestUs = inject_queue_.front().at_us_;
+        }
+    }
+    if (oldestUs > 0) {
+        stats.oldest_wait_us_ = uint64_t(std::max<int64_t>(monotonicMicroseconds() - oldestUs, 0));
+    }
+    return stats;
+}
+
+void ThreadPool::schedule(Job* job) {
+    Worker* worker = current_worker_;
+    if (!worker || worker->pool_ != this || !worker->local_.push(job)) {
+        inject(job);
+    }
+    notifyOne();
+}
+
+void ThreadPool::yield(Job* job) {
+    inject(job);
+    notifyOne();
+}
+
+void ThreadPool::inject(Job* job) {
+    // Only elastic pools look at the queueing delay.
+    const int64_t nowUs = elastic_ ? monotonicMicroseconds() : 0;
+    std::unique_lock<std::mutex> lock(inject_mutex_);
+    inject_queue_.push(Injected{job, nowUs});
+    inject_size_.store(inject_queue_.size(), std::memory_order_relaxed);
+}
+
+ThreadPool::Job* ThreadPool::popInjected() {
+    if (inject_size_.load(std::memory_order_relaxed) == 0) {
+        return nullptr;
+    }
+
+    std::unique_lock<std::mutex> lock(inject_mutex_);
+    if (inject_queue_.empty()) {
+        return nullptr;
+    }
+    Job* job = inject_queue_.front().job_;
+    inject_queue_.pop();
+    inject_size_.store(inject_queue_.size(), std::memory_order_relaxed);
+    return job;
+}
+
+void ThreadPool::workerLoop(Worker* worker) {
+    current_worker_ = worker;
+
+    while (true) {
+        if (Job* job = findJob(worker)) {
+            job->run();
+            continue;
+        }
+
+        if (stopping_.load(std::memory_order_acquire)) {
+            break;
+        }
+
+        if (!park(worker)) {
+            break;
+        }
+    }
+
+    current_worker_ = nullptr;
+    // The slot may be given a new thread from here on.
+    worker->running_.store(false, std::memory_order_release);
+}
+
+ThreadPool::Job* ThreadPool::findJob(Worker* worker) {
+    if (++worker->ticks_ % kInjectQueueInterval == 0) {
+        if (Job* job = popInjected()) {
+            return job;
+        }
+    }
+
+    if (Job* job = worker->local_.pop()) {
+        return job;
+    }
+
+    if (Job* job = popInjected()) {
+        return job;
+    }
+
+    // Steal, starting with the next worker so that thieves spread out. A
+    // steal that lost a race is not retried here; park() sees the work and
+    // comes back.
+    const size_t count = workers_.size();
+    for (size_t i = 1; i < count; ++i) {
+        if (Job* job = workers_[(worker->index_ + i) % count]->local_.steal()) {
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+bool ThreadPool::hasWork() const {
+    if (inject_size_.load(std::memory_order_relaxed) > 0) {
+        return true;
+    }
+    for (const auto& worker : workers_) {
+        if (!worker->local_.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::park(Worker* worker) {
+    // Announce the worker before looking for work a last time. This pairs
+    // with the fence in notifyOne(): either the scheduler sees the parked
+    // worker, or the worker sees the job it scheduled.
+    worker->parked_.store(true, std::memory_order_relaxed);
+    parked_workers_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (hasWork() || stopping_.load(std::memory_order_relaxed)) {
+        if (worker->parked_.exchange(false, std::memory_order_acq_rel)) {
+            parked_workers_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        // notifyOne() picked this worker in the meantime and is about to
+        // signal |wake_|, so the wait below returns right away.
+    }
+
+    if (!elastic_ || active_threads_.load(std::memory_order_relaxed) <= scaling_.min_threads_) {
+        worker->wake_.wait(vi::Event::kForever);
+        return true;
+    }
+
+    if (worker->wake_.waitUntil(std::chrono::steady_clock::now() + scaling_.idle_timeout_)) {
+        return true;
+    }
+    if (!worker->parked_.exchange(false, std::memory_order_acq_rel)) {
+        // Picked by notifyOne() just as the wait timed out.
+        worker->wake_.wait(vi::Event::kForever);
+        return true;
+    }
+    parked_workers_.fetch_sub(1, std::memory_order_relaxed);
+
+    // Pairs with the fence in notifyOne() like the one above: a job
+    // scheduled while this worker still looked parked is seen here, or the
+    // scheduler sees that no worker is parked.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (hasWork() || stopping_.load(std::memory_order_relaxed) || !tryRetire()) {
+        return true;
+    }
+    shrunk_.fetch_add(1, std::memory_order_relaxed);
+    last_scaled_at_us_.store(monotonicMicroseconds(), std::memory_order_relaxed);
+    return false;
+}
+
+bool ThreadPool::tryRetire() {
+    size_t threads = active_threads_.load(std::memory_order_relaxed);
+    while (threads > scaling_.min_threads_) {
+        if (active_threads_.compare_exchange_weak(threads, threads - 1, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::notifyOne() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked_workers_.load(std::memory_order_relaxed) == 0) {
+        if (elastic_) {
+            requestScaleCheck();
+        }
+        return;
+    }
+
+    for (auto& worker : workers_) {
+        if (worker->parked_.load(std::memory_order_relaxed) && worker->parked_.exchange(false, std::memory_order_acq_rel)) {
+            parked_workers_.fetch_sub(1, std::memory_order_relaxed);
+            worker->wake_.set();
+            return;
+        }
+    }
+}
+
+void ThreadPool::requestScaleCheck() {
+    if (scale_check_.load(std::memory_order_relaxed) || scale_check_.exchange(true, std::memory_order_relaxed)) {
+        return;
+    }
+    // The timer thread looks at the flag before it waits again, and may get
+    // here from wake() with |timer_mutex_| held.
+    if (timer_pool_ != this) {
+        std::unique_lock<std::mutex> lock(timer_mutex_);
+        timer_cond_.notify_one();
+    }
+}
+
+bool ThreadPool::checkScaling() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked_workers_.load(std::memory_order_relaxed) > 0 || !hasWork()) {
+        scale_check_.store(false, std::memory_order_relaxed);
+        // Pairs with notifyOne(): a job scheduled since the check above
+        // either finds the flag cleared and asks again, or is seen here.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return parked_workers_.load(std::memory_order_relaxed) == 0 && hasWork();
+    }
+
+    size_t backlog = 0;
+    int64_t oldestUs = 0;
+    {
+        std::unique_lock<std::mutex> lock(inject_mutex_);
+        backlog = inject_queue_.size();
+        if (!inject_queue_.empty()) {
+            oldestUs = inject_queue_.front().at_us_;
+        }
+    }
+    const int64_t nowUs = monotonicMicroseconds();
+    const bool exceeded = backlog > scaling_.backlog_threshold_
+            || (backlog > 0 && nowUs - oldestUs > scaling_.delay_threshold_.count());
+    if (!exceeded || active_threads_.load(std::memory_order_relaxed) >= scaling_.max_threads_) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(scale_mutex_);
+    if (stopping_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    // A slot whose worker retired may still be running the last lines of
+    // workerLoop(); it is picked on a later check.
+    for (auto& worker : workers_) {
+        if (!worker->running_.load(std::memory_order_acquire)) {
+            const size_t threads = active_threads_.fetch_add(1, std::memory_order_relaxed) + 1;
+            startWorker(worker.get());
+            if (threads > peak_threads_.load(std::memory_order_relaxed)) {
+                peak_threads_.store(threads, std::memory_order_relaxed);
+            }
+            grown_.fetch_add(1, std::memory_order_relaxed);
+            last_scaled_at_us_.store(nowUs, std::memory_order_relaxed);
+            break;
+        }
+    }
+    return true;
+}
+
+void ThreadPool::wakeAt(Job* job, int64_t fireAtUs) {
+    std::unique_lock<std::mutex> lock(timer_mutex_);
+    if (job->timer_armed_) {
+        if (job->timer_->first <= fireAtUs) {
+            return;
+        }
+        timers_.erase(job->timer_);
+    }
+    job->timer_ = timers_.emplace(fireAtUs, job);
+    job->timer_armed_ = true;
+
+    if (job->timer_ == timers_.begin()) {
+        timer_cond_.notify_one();
+    }
+}
+
+void ThreadPool::cancelWake(Job* job) {
+    std::unique_lock<std::mutex> lock(timer_mutex_);
+    if (job->timer_armed_) {
+        timers_.erase(job->timer_);
+        job->timer_armed_ = false;
+    }
+}
+
+void ThreadPool::timerLoop() {
+    timer_pool_ = this;
+
+    // Next check of the scaling thresholds, 0 while the pool has idle
+    // workers.
+    int64_t checkAtUs = 0;
+
+    std::unique_lock<std::mutex> lock(timer_mutex_);
+    while (!stopping_.load(std::memory_order_acquire)) {
+        const int64_t now = monotonicMicroseconds();
+        while (!timers_.empty() && timers_.begin()->first <= now) {
+            Job* job = timers_.begin()->second;
+            job->timer_armed_ = false;
+            timers_.erase(timers_.begin());
+            // Called with |timer_mutex_| held, which is what makes
+            // cancelWake() wait for a wake() in progress.
+            job->wake();
+        }
+
+        if (elastic_) {
+            if (checkAtUs == 0 && scale_check_.load(std::memory_order_relaxed)) {
+                // Give the workers one interval to catch up before counting
+                // the pool as overloaded.
+                checkAtUs = now + scaling_.check_interval_.count();
+            }
+            else if (checkAtUs != 0 && checkAtUs <= now) {
+                lock.unlock();
+                const bool watch = checkScaling();
+                lock.lock();
+                checkAtUs = watch ? monotonicMicroseconds() + scaling_.check_interval_.count() : 0;
+                continue;
+            }
+        }
+
+        int64_t wakeUpUs = timers_.empty() ? 0 : timers_.begin()->first;
+        if (checkAtUs != 0 && (wakeUpUs == 0 || checkAtUs < wakeUpUs)) {
+            wakeUpUs = checkAtUs;
+        }
+        if (wakeUpUs == 0) {
+            timer_cond_.wait(lock);
+        }
+        else {
+            timer_cond_.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::microseconds(wakeUpUs)));
+        }
+    }
+}
+
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "event.h"
+#include "ring_buffer.h"
+#include "thread_placement.h"
+#include "work_stealing_deque.h"
+
+namespace vi {
+
+// Bounds and thresholds of an elastic ThreadPool.
+struct ThreadPoolScaling {
+    // Workers kept even when idle, started with the pool.
+    size_t min_threads_ {1};
+
+    // Workers the pool grows to at most.
+    size_t max_threads_ {1};
+
+    // While no worker is idle, a worker is added once more than that many
+    // jobs wait in the injection queue...
+    size_t backlog_threshold_ {4};
+
+    // ...or the oldest of them waited longer than that.
+    std::chrono::microseconds delay_threshold_ {2000};
+
+    // How often a busy pool is checked against the thresholds; at most one
+    // worker is added per check.
+    std::chrono::microseconds check_interval_ {1000};
+
+    // A worker beyond |min_threads_| that found nothing to run for that long
+    // exits.
+    std::chrono::milliseconds idle_timeout_ {5000};
+};
+
+// Snapshot of the workers of a ThreadPool and of its scaling decisions.
+struct ThreadPoolStats {
+    // Running workers.
+    size_t threads_ {0};
+
+    size_t min_threads_ {0};
+
+    size_t max_threads_ {0};
+
+    // Highest |threads_| so far.
+    size_t peak_threads_ {0};
+
+    // Workers started because a threshold was exceeded.
+    uint64_t grown_ {0};
+
+    // Workers that exited after |idle_timeout_|.
+    uint64_t shrunk_ {0};
+
+    // Jobs waiting in the injection queue, and how long the oldest of them
+    // has been waiting; only elastic pools time their jobs. Jobs in the
+    // deques of busy workers are not counted.
+    size_t backlog_ {0};
+
+    uint64_t oldest_wait_us_ {0};
+
+    // Monotonic time of the last worker started or stopped by scaling, 0 if
+    // there was none.
+    int64_t last_scaled_at_us_ {0};
+};
+
+// Set of worker threads that run Jobs, used to multiplex many pooled
+// task queues (see TaskQueuePooled) onto few threads.
+//
+// Every worker owns a work-stealing deque. A job scheduled from a worker goes
+// to that worker's deque and is usually run next by the same thread, which
+// keeps a chain of posts between queues on one core. Jobs scheduled from
+// other threads, jobs that yield, and overflow go to a shared FIFO injection
+// queue. Idle workers steal from each other before they park, and parked
+// workers are only woken when there is work that nobody else will pick up.
+//
+// A dedicated timer thread turns wakeAt() deadlines into wake() calls.
+//
+// A pool created with a ThreadPoolScaling is elastic: the timer thread adds
+// workers while all of them are busy and jobs pile up, and workers beyond
+// the minimum exit after an idle timeout. Queues keep their sequencing
+// since a pooled queue runs on at most one worker at a time whatever the
+// number of workers.
+//
+//   static vi::ThreadPool pool(vi::ThreadPoolScaling{2, 32});
+//   vi::TaskQueueOptions options;
+//   options.type_ = vi::TaskQueueType::kPooled;
+//   options.thread_pool_ = &pool;
+//   TQMgr->create({"ingest", "parse", "store"}, options);
+class ThreadPool {
+public:
+    class Job {
+    public:
+        // Called on a worker once per schedule() or yield().
+        virtual void run() = 0;
+
+        // Called on the timer thread when a deadline set with wakeAt() is
+        // reached.
+        virtual void wake() = 0;
+
+    protected:
+        virtual ~Job() = default;
+
+    private:
+        friend class ThreadPool;
+
+        // Pending timer entry, valid while |timer_armed_| is set. Guarded by
+        // the pool's |timer_mutex_|.
+        std::multimap<int64_t, Job*>::iterator timer_;
+
+        bool timer_armed_ {false};
+    };
+
+    // Process wide pool with one worker per core, created on first use and
+    // never destroyed.
+    static ThreadPool* shared();
+
+    // Workers are placed according to |placement| and named after its name
+    // with the worker index appended.
+    explicit ThreadPool(size_t threads, const ThreadPlacement& placement = ThreadPlacement());
+
+    // Elastic pool between |scaling.min_threads_| and |scaling.max_threads_|
+    // workers.
+    explicit ThreadPool(const ThreadPoolScaling& scaling, const ThreadPlacement& placement = ThreadPlacement());
+
+    // Stops the workers. Every job that uses the pool must be gone, and the
+    // destructor must not run on one of the pool's threads.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queues |job| for one call of run(). Jobs are not reference counted: the
+    // caller guarantees that |job| is alive and not queued already.
+    void schedule(Job* job);
+
+    // Like schedule(), but always queues |job| behind the jobs scheduled so
+    // far, so that a job that gives up its worker voluntarily lets the others
+    // run first.
+    void yield(Job* job);
+
+    // Calls job->wake() once the monotonic clock reaches |fireAtUs|. A job has
+    // at most one deadline; an earlier one replaces a later one, a later one
+    // is ignored while an earlier one is pending.
+    void wakeAt(Job* job, int64_t fireAtUs);
+
+    // Drops the deadline of |job|. Once this returns, wake() is neither
+    // running nor going to be called for it.
+    void cancelWake(Job* job);
+
+    // Running workers. Changes over time for an elastic pool.
+    size_t threads() const { return active_threads_.load(std::memory_order_relaxed); }
+
+    ThreadPoolStats stats() const;
+
+private:
+    struct Worker {
+        WorkStealingDeque<Job> local_;
+
+        // Set while the worker is parked on |wake_|, or about to park.
+        std::atomic<bool> parked_ {false};
+
+        vi::Event wake_;
+
+        ThreadPool* pool_ {nullptr};
+
+        size_t index_ {0};
+
+        // Jobs run so far, used to look at the injection queue regularly.
+        uint32_t ticks_ {0};
+
+        // Set while the slot has a thread that has not decided to exit.
+        // Cleared by the thread itself as the last thing it does.
+        std::atomic<bool> running_ {false};
+
+        std::thread thread_;
+    };
+
+    // Fixed pools have |min_threads_| == |max_threads_|.
+    ThreadPool(const ThreadPoolScaling& scaling, const ThreadPlacement& placement, bool elastic);
+
+    // Starts the thread of the idle slot |worker|. Called with
+    // |scale_mutex_| held.
+    void startWorker(Worker* worker);
+
+    void workerLoop(Worker* worker);
+
+    Job* findJob(Worker* worker);
+
+    Job* popInjected();
+
+    void inject(Job* job);
+
+    // Parks |worker| until notifyOne() picks it or the pool stops. Returns
+    // false if the worker timed out and is to exit instead.
+    bool park(Worker* worker);
+
+    // Leaves the worker count alone unless it may drop below the minimum.
+    bool tryRetire();
+
+    bool hasWork() const;
+
+    // Wakes one parked worker, if any.
+    void notifyOne();
+
+    // Has the timer thread watch the thresholds of an elastic pool.
+    void requestScaleCheck();
+
+    // Adds a worker if all are busy and the thresholds are exceeded.
+    // Returns whether the pool is still to be watched.
+    bool checkScaling();
+
+    void timerLoop();
+
+    struct Injected {
+        Job* job_;
+
+        // Monotonic time the job was queued, 0 unless the pool is elastic.
+        int64_t at_us_;
+    };
+
+private:
+    static thread_local Worker* current_worker_;
+
+    static thread_local const ThreadPool* timer_pool_;
+
+    // One slot per possible worker, so that the vector never changes while
+    // workers steal from each other.
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    const ThreadPoolScaling scaling_;
+
+    const bool elastic_;
+
+    const ThreadPlacement placement_;
+
+    std::atomic<size_t> active_threads_ {0};
+
+    std::atomic<bool> stopping_ {false};
+
+    std::atomic<uint32_t> parked_workers_ {0};
+
+    mutable std::mutex inject_mutex_;
+
+    RingBuffer<Injected> inject_queue_;
+
+    // Size of |inject_queue_|, readable without the lock.
+    std::atomic<size_t> inject_size_ {0};
+
+    std::mutex timer_mutex_;
+
+    std::condition_variable timer_cond_;
+
+    std::multimap<int64_t, Job*> timers_;
+
+    std::thread timer_thread_;
+
+    // Set when a job was scheduled while no worker was parked, so the timer
+    // thread checks the thresholds. Only used by elastic pools.
+    std::atomic<bool> scale_check_ {false};
+
+    // Serializes starting threads with the destructor.
+    std::mutex scale_mutex_;
+
+    std::atomic<size_t> peak_threads_ {0};
+
+    std::atomic<uint64_t> grown_ {0};
+
+    std::atomic<uint64_t> shrunk_ {0};
+
+    std::atomic<int64_t> last_scaled_at_us_ {0};
+};
+
+}
@@ -0,0 +1,248 @@
+#include "timing_wheel.h"
+#include <assert.h>
+#include <algorithm>
+#include "bit_ops.h"
+
+namespace vi {
+
+TimingWheel::TimingWheel(int64_t tickDuration)
+    : tick_duration_(tickDuration > 0 ? tickDuration : 1) {
+}
+
+TimingWheel::~TimingWheel() = default;
+
+uint64_t TimingWheel::tickOf(int64_t time) const {
+    return time > 0 ? static_cast<uint64_t>(time / tick_duration_) : 0;
+}
+
+uint64_t TimingWheel::push(const DelayedEntryTimeout& timeout, Task task) {
+    Timer* timer = allocateTimer();
+    timer->timeout_ = timeout;
+    timer->task_ = std::move(task);
+    ++size_;
+    place(timer);
+    return timer->id_;
+}
+
+Task TimingWheel::erase(const DelayedEntryTimeout& timeout, uint64_t id) {
+    if (id >= chunks_.size() * kTimersPerChunk) {
+        return Task();
+    }
+    Timer* timer = &chunks_[id / kTimersPerChunk][id % kTimersPerChunk];
+    if (timer->timeout_.order_ != timeout.order_) {
+        return Task();
+    }
+
+    switch (timer->location_) {
+    case Location::kSlot:
+        if (timer->prev_) {
+            timer->prev_->next_ = timer->next_;
+        }
+        else {
+            slots_[timer->level_][timer->index_] = timer->next_;
+            if (!timer->next_) {
+                occupied_[timer->level_] &= ~(uint64_t(1) << timer->index_);
+            }
+        }
+        if (timer->next_) {
+            timer->next_->prev_ = timer->prev_;
+        }
+        break;
+    case Location::kReady:
+        // Removing from the middle of the heap is not O(1); the entry stays
+        // until it reaches the top.
+        timer->location_ = Location::kErased;
+        break;
+    case Location::kFree:
+    case Location::kErased:
+        return Task();
+    }
+
+    auto task = std::move(timer->task_);
+    if (timer->location_ == Location::kSlot) {
+        freeTimer(timer);
+    }
+    --size_;
+    return task;
+}
+
+void TimingWheel::place(Timer* timer) {
+    const uint64_t tick = tickOf(timer->timeout_.next_fire_at_us_);
+    if (tick < current_tick_) {
+        pushReady(timer);
+        return;
+    }
+
+    // The lowest level on which |tick| and |current_tick_| fall into
+    // different slots.
+    const uint64_t diff = tick ^ current_tick_;
+    const int level = diff == 0 ? 0 : (63 - countLeadingZeros(diff)) / kSlotBits;
+    const int index = static_cast<int>((tick >> (level * kSlotBits)) & (kSlotsPerLevel - 1));
+
+    Timer*& head = slots_[level][index];
+    timer->location_ = Location::kSlot;
+    timer->level_ = static_cast<uint8_t>(level);
+    timer->index_ = static_cast<uint8_t>(index);
+    timer->prev_ = nullptr;
+    timer->next_ = head;
+    if (head) {
+        head->prev_ = timer;
+    }
+    head = timer;
+    occupied_[level] |= uint64_t(1) << index;
+}
+
+TimingWheel::Timer* TimingWheel::takeSlot(int level, int index) {
+    Timer* list = slots_[level][index];
+    slots_[level][index] = nullptr;
+    occupied_[level] &= ~(uint64_t(1) << index);
+    return list;
+}
+
+void TimingWheel::expire(uint64_t tick) {
+    for (int level = kLevels - 1; level >= 1; --level) {
+        const uint64_t mask = (uint64_t(1) << (level * kSlotBits)) - 1;
+        if ((tick & mask) != 0) {
+            continue;
+        }
+        const int index = static_cast<int>((tick >> (level * kSlotBits)) & (kSlotsPerLevel - 1));
+        if ((occupied_[level] & (uint64_t(1) << index)) == 0) {
+            continue;
+        }
+        Timer* timer = takeSlot(level, index);
+        while (timer) {
+            Timer* next = timer->next_;
+            place(timer);
+            timer = next;
+        }
+    }
+
+    Timer* timer = takeSlot(0, static_cast<int>(tick & (kSlotsPerLevel - 1)));
+    while (timer) {
+        Timer* next = timer->next_;
+        pushReady(timer);
+        timer = next;
+    }
+}
+
+void TimingWheel::advance(int64_t now) {
+    const uint64_t target = tickOf(now);
+    uint64_t tick;
+    while (nextEventTick(&tick) && tick <= target) {
+        current_tick_ = tick;
+        expire(tick);
+        current_tick_ = tick + 1;
+    }
+    if (current_tick_ <= target) {
+        current_tick_ = target + 1;
+    }
+}
+
+bool TimingWheel::nextEventTick(uint64_t* tick) const {
+    // Usually the lowest occupied level holds the next event, except when
+    // |current_tick_| sits exactly on the start of a higher level slot that
+    // has not been cascaded yet, so every level is looked at.
+    bool found = false;
+    for (int level = 0; level < kLevels; ++level) {
+        if (occupied_[level] == 0) {
+            continue;
+        }
+        const int shift = level * kSlotBits;
+        const int current = static_cast<int>((current_tick_ >> shift) & (kSlotsPerLevel - 1));
+        const uint64_t pending = occupied_[level] & (~uint64_t(0) << current);
+        assert(pending == occupied_[level]);
+        if (pending == 0) {
+            continue;
+        }
+        const int upper = shift + kSlotBits;
+        const uint64_t base = upper >= 64 ? 0 : (current_tick_ >> upper) << upper;
+        const uint64_t start = std::max(base | (uint64_t(countTrailingZeros(pending)) << shift), current_tick_);
+        if (!found || start < *tick) {
+            *tick = start;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void TimingWheel::pushReady(Timer* timer) {
+    timer->location_ = Location::kReady;
+    ready_.push_back(timer);
+    std::push_heap(ready_.begin(), ready_.end(), ReadyOrder());
+}
+
+void TimingWheel::dropErased() {
+    while (!ready_.empty() && ready_.front()->location_ == Location::kErased) {
+        std::pop_heap(ready_.begin(), ready_.end(), ReadyOrder());
+        freeTimer(ready_.back());
+        ready_.pop_back();
+    }
+}
+
+const DelayedEntryTimeout* TimingWheel::front(int64_t now) {
+    if (size_ == 0) {
+        return nullptr;
+    }
+    advance(now);
+    dropErased();
+    if (ready_.empty()) {
+        return nullptr;
+    }
+    const auto& timeout = ready_.front()->timeout_;
+    return now >= timeout.next_fire_at_us_ ? &timeout : nullptr;
+}
+
+Task TimingWheel::pop() {
+    assert(!ready_.empty());
+    std::pop_heap(ready_.begin(), ready_.end(), ReadyOrder());
+    Timer* timer = ready_.back();
+    ready_.pop_back();
+    auto task = std::move(timer->task_);
+    freeTimer(timer);
+    --size_;
+    return task;
+}
+
+int64_t TimingWheel::nextFireTime() {
+    assert(size_ > 0);
+    dropErased();
+    if (!ready_.empty()) {
+        return ready_.front()->timeout_.next_fire_at_us_;
+    }
+    uint64_t tick = current_tick_;
+    nextEventTick(&tick);
+    return static_cast<int64_t>(tick) * tick_duration_;
+}
+
+bool TimingWheel::empty() const {
+    return size_ == 0;
+}
+
+size_t TimingWheel::size() const {
+    return size_;
+}
+
+TimingWheel::Timer* TimingWheel::allocateTimer() {
+    if (!free_timers_) {
+        chunks_.emplace_back(new Timer[kTimersPerChunk]);
+        Timer* chunk = chunks_.back().get();
+        for (size_t i = 0; i < kTimersPerChunk; ++i) {
+            chunk[i].id_ = static_cast<uint32_t>((chunks_.size() - 1) * kTimersPerChunk + i);
+            chunk[i].next_ = free_timers_;
+            free_timers_ = &chunk[i];
+        }
+    }
+    Timer* timer = free_timers_;
+    free_timers_ = timer->next_;
+    return timer;
+}
+
+void TimingWheel::freeTimer(Timer* timer) {
+    timer->location_ = Location::kFree;
+    timer->timeout_.order_ = 0;
+    timer->prev_ = nullptr;
+    timer->next_ = free_timers_;
+    free_timers_ = timer;
+}
+
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "delayed_task_queue.h"
+
+namespace vi {
+
+// Hierarchical timing wheel backend for delayed tasks.
+//
+// Time is split into ticks of |tickDuration|. Level 0 has one slot per tick,
+// every higher level has slots that are 64 times wider than the level below.
+// An entry is linked into the lowest level whose slot range does not contain
+// the current tick, which makes push() O(1). When the current tick reaches
+// the start of a higher level slot, the slot is cascaded into the lower
+// levels, and once a level 0 slot expires its entries move to a small ready
+// heap that hands them out in (fire time, order) order. Per level occupancy
+// bitmaps let advancing skip over empty slots, so idle periods cost nothing.
+//
+// Entries are recycled through a free list, so in steady state push() does
+// not allocate. The id returned by push() is the index of the entry, which
+// makes erase() O(1): a linked entry is unlinked right away, while one that
+// already sits in the ready heap gives up its task and is dropped once it
+// reaches the top.
+class TimingWheel final : public DelayedTaskQueue {
+public:
+    // |tickDuration| is the width of a level 0 slot in microseconds. Fire
+    // times keep their full precision, the tick only bounds how early
+    // nextFireTime() may report an entry.
+    explicit TimingWheel(int64_t tickDuration = 1000);
+    ~TimingWheel() override;
+
+    uint64_t push(const DelayedEntryTimeout& timeout, Task task) override;
+
+    Task erase(const DelayedEntryTimeout& timeout, uint64_t id) override;
+
+    const DelayedEntryTimeout* front(int64_t now) override;
+
+    Task pop() override;
+
+    int64_t nextFireTime() override;
+
+    bool empty() const override;
+
+    size_t size() const override;
+
+private:
+    static constexpr int kSlotBits = 6;
+    static constexpr int kSlotsPerLevel = 1 << kSlotBits;
+    // 11 levels of 6 bits cover every non-negative 64 bit tick.
+    static constexpr int kLevels = 11;
+    static constexpr size_t kTimersPerChunk = 256;
+
+    enum class Location : uint8_t {
+        kFree,
+        // Linked into |slots_[level_][index_]|.
+        kSlot,
+        kReady,
+        // In the ready heap after erase().
+        kErased,
+    };
+
+    struct Timer {
+        Timer* prev_{nullptr};
+        Timer* next_{nullptr};
+        DelayedEntryTimeout timeout_;
+        Task task_;
+        // Index among all timers, see push().
+        uint32_t id_{0};
+        Location location_{Location::kFree};
+        uint8_t level_{0};
+        uint8_t index_{0};
+    };
+
+    struct ReadyOrder {
+        bool operator()(const Timer* a, const Timer* b) const {
+            return b->timeout_ < a->timeout_;
+        }
+    };
+
+    uint64_t tickOf(int64_t time) const;
+
+    // Links |timer| into the wheel relative to |current_tick_|, or into the
+    // ready heap if its tick already passed.
+    void place(Timer* timer);
+
+    // Unlinks and returns the whole list of a slot.
+    Timer* takeSlot(int level, int index);
+
+    // Processes tick |tick|: cascades the higher level slots starting at it
+    // and moves the level 0 slot to the ready heap.
+    void expire(uint64_t tick);
+
+    // Moves every entry due at |now| to the ready heap.
+    void advance(int64_t now);
+
+    // Finds the first tick >= |current_tick_| at which something is linked in
+    // the wheel. Returns false if the wheel (not counting the ready heap) is
+    // empty.
+    bool nextEventTick(uint64_t* tick) const;
+
+    void pushReady(Timer* timer);
+
+    // Frees erased entries at the top of the ready heap.
+    void dropErased();
+
+    Timer* allocateTimer();
+
+    void freeTimer(Timer* timer);
+
+private:
+    const int64_t tick_duration_;
+
+    // All ticks before this one have been expired.
+    uint64_t current_tick_{0};
+
+    Timer* slots_[kLevels][kSlotsPerLevel] = {};
+
+    uint64_t occupied_[kLevels] = {};
+
+    // Min-heap of expired entries, ordered by (fire time, order).
+    std::vector<Timer*> ready_;
+
+    size_t size_{0};
+
+    std::vector<std::unique_ptr<Timer[]>> chunks_;
+
+    Timer* free_timers_{nullptr};
+};
+
+}
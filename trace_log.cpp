@@ -0,0 +1,310 @@
+#include "trace_log.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+namespace vi {
+
+namespace {
+
+struct TraceEvent {
+    enum Type : uint8_t {
+        kPost,
+        kRun,
+    };
+
+    Type type_ {kPost};
+
+    // Post time, or start of the run.
+    int64_t ts_ns_ {0};
+
+    int64_t dur_ns_ {0};
+
+    uint64_t flow_ {0};
+
+    // Interned, see TraceLog::intern().
+    const char* queue_ {nullptr};
+
+    Location from_;
+};
+
+// Events of one thread. The ring is only written by its thread and read by
+// the exporter, so |mutex_| is hardly ever contended.
+struct ThreadBuffer {
+    void record(const TraceEvent& event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (events_.empty()) {
+            return;
+        }
+        events_[recorded_ % events_.size()] = event;
+        ++recorded_;
+    }
+
+    std::mutex mutex_;
+
+    std::vector<TraceEvent> events_;
+
+    // Events recorded since the last reset, of which the ring holds the
+    // latest |events_.size()|.
+    uint64_t recorded_ {0};
+
+    uint32_t tid_ {0};
+
+    std::string name_;
+
+    // The thread has exited; clear() drops the buffer.
+    std::atomic<bool> retired_ {false};
+};
+
+struct Registry {
+    std::mutex mutex_;
+
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+
+    size_t events_per_thread_ {TraceLog::kDefaultEventsPerThread};
+
+    uint32_t next_tid_ {1};
+
+    std::mutex names_mutex_;
+
+    // Node based, so the strings never move.
+    std::unordered_set<std::string> names_;
+};
+
+// Never destroyed, so that threads exiting late still find it.
+Registry& registry() {
+    static Registry* registry = new Registry();
+    return *registry;
+}
+
+std::atomic<uint64_t> _nextFlow {1};
+
+std::string currentThreadName(uint32_t tid) {
+    char name[64] = {};
+#if defined(__linux__) || defined(__APPLE__)
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+#endif
+    if (name[0] == '\0') {
+        snprintf(name, sizeof(name), "thread %u", tid);
+    }
+    return name;
+}
+
+struct ThreadSlot {
+    ~ThreadSlot() {
+        if (buffer_) {
+            buffer_->retired_.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    ThreadBuffer& get() {
+        if (!buffer_) {
+            auto buffer = std::make_shared<ThreadBuffer>();
+            Registry& shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex_);
+            buffer->tid_ = shared.next_tid_++;
+            buffer->name_ = currentThreadName(buffer->tid_);
+            buffer->events_.resize(shared.events_per_thread_);
+            shared.buffers_.push_back(buffer);
+            buffer_ = std::move(buffer);
+        }
+        return *buffer_;
+    }
+
+    std::shared_ptr<ThreadBuffer> buffer_;
+};
+
+thread_local ThreadSlot _threadSlot;
+
+void appendEscaped(std::string& out, const char* text) {
+    out += '"';
+    for (const char* c = text ? text : ""; *c; ++c) {
+        switch (*c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(*c) < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+                out += escaped;
+            }
+            else {
+                out += *c;
+            }
+        }
+    }
+    out += '"';
+}
+
+// Microseconds with nanosecond digits, the unit of the trace-event format.
+void appendMicroseconds(std::string& out, int64_t ns) {
+    char number[32];
+    snprintf(number, sizeof(number), "%" PRId64 ".%03d", ns / 1000, int(ns % 1000));
+    out += number;
+}
+
+void appendEvent(std::string& out, const TraceEvent& event, uint32_t tid) {
+    out += "{\"ph\":\"X\",\"cat\":\"task_queue\",\"name\":";
+    if (event.type_ == TraceEvent::kPost) {
+        appendEscaped(out, (std::string("post to ") + (event.queue_ ? event.queue_ : "")).c_str());
+    }
+    else {
+        appendEscaped(out, event.queue_);
+    }
+    out += ",\"ts\":";
+    appendMicroseconds(out, event.ts_ns_);
+    out += ",\"dur\":";
+    appendMicroseconds(out, event.dur_ns_);
+    out += ",\"pid\":1,\"tid\":" + std::to_string(tid);
+    if (event.flow_ != 0) {
+        char id[32];
+        snprintf(id, sizeof(id), "0x%" PRIx64, event.flow_);
+        out += ",\"bind_id\":\"";
+        out += id;
+        out += event.type_ == TraceEvent::kPost ? "\",\"flow_out\":true" : "\",\"flow_in\":true";
+    }
+    out += ",\"args\":{\"from\":";
+    const Location& from = event.from_;
+    if (from.file()) {
+        appendEscaped(out, (std::string(from.file()) + ":" + std::to_string(from.line())).c_str());
+    }
+    else {
+        out += "\"unknown\"";
+    }
+    if (from.function()) {
+        out += ",\"function\":";
+        appendEscaped(out, from.function());
+    }
+    out += "}}";
+}
+
+}  // namespace
+
+std::atomic<bool> TraceLog::enabled_ {false};
+
+void TraceLog::start(size_t eventsPerThread) {
+    Registry& shared = registry();
+    {
+        std::lock_guard<std::mutex> lock(shared.mutex_);
+        if (eventsPerThread != shared.events_per_thread_) {
+            shared.events_per_thread_ = eventsPerThread;
+            for (auto& buffer : shared.buffers_) {
+                std::lock_guard<std::mutex> bufferLock(buffer->mutex_);
+                buffer->events_.assign(eventsPerThread, TraceEvent());
+                buffer->recorded_ = 0;
+            }
+        }
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void TraceLog::stop() {
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+void TraceLog::clear() {
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex_);
+    std::vector<std::shared_ptr<ThreadBuffer>> live;
+    for (auto& buffer : shared.buffers_) {
+        if (buffer->retired_.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex_);
+        buffer->recorded_ = 0;
+        live.push_back(buffer);
+    }
+    shared.buffers_.swap(live);
+}
+
+std::string TraceLog::toJson() {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex_);
+        buffers = shared.buffers_;
+    }
+
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (auto& buffer : buffers) {
+        std::lock_guard<std::mutex> lock(buffer->mutex_);
+        const uint64_t size = buffer->events_.size();
+        if (buffer->recorded_ == 0 || size == 0) {
+            continue;
+        }
+        out += first ? "\n" : ",\n";
+        first = false;
+        out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" + std::to_string(buffer->tid_) + ",\"args\":{\"name\":";
+        appendEscaped(out, buffer->name_.c_str());
+        out += "}}";
+
+        const uint64_t begin = buffer->recorded_ > size ? buffer->recorded_ - size : 0;
+        for (uint64_t i = begin; i < buffer->recorded_; ++i) {
+            out += ",\n";
+            appendEvent(out, buffer->events_[i % size], buffer->tid_);
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool TraceLog::writeJson(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    const std::string json = toJson();
+    const bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+    return fclose(file) == 0 && written;
+}
+
+uint64_t TraceLog::post(const char* queue, const Location& from) {
+    if (!enabled()) {
+        return 0;
+    }
+    TraceEvent event;
+    event.type_ = TraceEvent::kPost;
+    event.ts_ns_ = nanoseconds();
+    event.flow_ = _nextFlow.fetch_add(1, std::memory_order_relaxed);
+    event.queue_ = queue;
+    event.from_ = from;
+    _threadSlot.get().record(event);
+    return event.flow_;
+}
+
+void TraceLog::run(const char* queue, uint64_t flow, const Location& from, int64_t startNs) {
+    if (!enabled()) {
+        return;
+    }
+    TraceEvent event;
+    event.type_ = TraceEvent::kRun;
+    event.ts_ns_ = startNs;
+    event.dur_ns_ = nanoseconds() - startNs;
+    event.flow_ = flow;
+    event.queue_ = queue;
+    event.from_ = from;
+    _threadSlot.get().record(event);
+}
+
+const char* TraceLog::intern(std::string_view name) {
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.names_mutex_);
+    return shared.names_.emplace(name).first->c_str();
+}
+
+int64_t TraceLog::nanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include "location.h"
+
+namespace vi {
+
+// Process wide recorder of task queue trace events, exported as Chrome
+// trace-event JSON for chrome://tracing and Perfetto.
+//
+// While tracing is on, TaskQueue records a post event on the posting thread
+// and a run event, with start and duration, on the thread that runs the
+// task. Both carry the Location of the post and a flow id, which the viewer
+// draws as an arrow from the post to the run, also across queues. Repeating
+// tasks and fd callbacks record their runs without a flow.
+//
+// Every thread records into a ring buffer of its own that keeps the latest
+// events, guarded by a mutex nobody but the exporter contends for. While
+// tracing is off a post costs a relaxed load.
+class TraceLog {
+public:
+    static const size_t kDefaultEventsPerThread = 16384;
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // Starts recording with room for the latest |eventsPerThread| events of
+    // every thread. Events recorded before are kept unless clear() is
+    // called.
+    static void start(size_t eventsPerThread = kDefaultEventsPerThread);
+
+    // Stops recording. Runs that end afterwards are not recorded either, so
+    // call it once the work of interest finished.
+    static void stop();
+
+    // Drops the recorded events.
+    static void clear();
+
+    // The recorded events as a Chrome trace-event JSON object.
+    static std::string toJson();
+
+    // Writes toJson() to |path|. Returns false on failure.
+    static bool writeJson(const std::string& path);
+
+    // Records a post to |queue| from |from| and returns the flow id for
+    // its run, 0 if tracing is off.
+    static uint64_t post(const char* queue, const Location& from);
+
+    // Records the run of a task posted to |queue| from |from| that started
+    // at |startNs| and just ended. |flow| is the id post() returned, 0 for
+    // none.
+    static void run(const char* queue, uint64_t flow, const Location& from, int64_t startNs);
+
+    // Returns a copy of |name| that lives until the process ends, for queue
+    // names in events that outlive their queue. Equal names share a copy.
+    static const char* intern(std::string_view name);
+
+    static int64_t nanoseconds();
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+}